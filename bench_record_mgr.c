@@ -0,0 +1,356 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "dberror.h"
+#include "record_mgr.h"
+#include "tables.h"
+
+// Micro-benchmark for the record manager hot paths, linked against an -O2
+// build of the library (see the Makefile). Reports time and heap
+// allocations per operation; allocations are counted by linking with
+// -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc, which only sees calls
+// made from our own objects. Allocations inside libc (fopen's FILE and
+// buffer, qsort's scratch space, pthread stacks) are not counted.
+
+#define BENCH_TABLE "bench_table"
+#define BENCH_OPS 100000
+#define BENCH_POOL_SIZE 64
+#define BENCH_MAX_THREADS 8
+#define BENCH_BATCH_SIZE 256
+
+static long numAllocs = 0;
+
+void *__real_malloc (size_t size);
+void *__real_calloc (size_t count, size_t size);
+void *__real_realloc (void *ptr, size_t size);
+
+void *
+__wrap_malloc (size_t size)
+{
+	__atomic_add_fetch(&numAllocs, 1, __ATOMIC_RELAXED);
+	return __real_malloc(size);
+}
+
+void *
+__wrap_calloc (size_t count, size_t size)
+{
+	__atomic_add_fetch(&numAllocs, 1, __ATOMIC_RELAXED);
+	return __real_calloc(count, size);
+}
+
+void *
+__wrap_realloc (void *ptr, size_t size)
+{
+	__atomic_add_fetch(&numAllocs, 1, __ATOMIC_RELAXED);
+	return __real_realloc(ptr, size);
+}
+
+static RC
+countRow (Record *record, int worker, void *data)
+{
+	(void) record;
+	__atomic_add_fetch(&((int *) data)[worker], 1, __ATOMIC_RELAXED);
+	return RC_OK;
+}
+
+typedef struct BenchMark {
+	struct timespec start;
+	long allocs;
+} BenchMark;
+
+static void benchPredicates (void);
+
+static void
+benchStart (BenchMark *mark)
+{
+	mark->allocs = numAllocs;
+	clock_gettime(CLOCK_MONOTONIC, &mark->start);
+}
+
+static void
+benchReport (BenchMark *mark, const char *name, int ops)
+{
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double ns = (end.tv_sec - mark->start.tv_sec) * 1e9 + (end.tv_nsec - mark->start.tv_nsec);
+	printf("%-14s %8d %10.1f %10.3f\n", name, ops, ns / ops, (double) (numAllocs - mark->allocs) / ops);
+}
+
+static Schema *
+benchSchema (void)
+{
+	char *names[] = { "a", "b", "c" };
+	DataType dt[] = { DT_INT, DT_STRING, DT_INT };
+	int sizes[] = { 0, 16, 0 };
+	char **cpNames = (char **) malloc(sizeof(char*) * 3);
+	DataType *cpDt = (DataType *) malloc(sizeof(DataType) * 3);
+	int *cpSizes = (int *) malloc(sizeof(int) * 3);
+	int *cpKeys = (int *) malloc(sizeof(int));
+	int i;
+
+	for(i = 0; i < 3; i++)
+	{
+		cpNames[i] = (char *) malloc(2);
+		strcpy(cpNames[i], names[i]);
+	}
+	memcpy(cpDt, dt, sizeof(DataType) * 3);
+	memcpy(cpSizes, sizes, sizeof(int) * 3);
+	cpKeys[0] = 0;
+	return createSchema(3, cpNames, cpDt, cpSizes, 1, cpKeys);
+}
+
+// usage: bench_record_mgr [fixed|slotted|pax] [btree]
+int
+main (int argc, char **argv)
+{
+	RM_TableData table;
+	RM_ScanHandle scan;
+	RecordBatch *batch;
+	RM_RecordView view;
+	Record *projected;
+	int projection[] = { 0 };
+	RM_Config config = { BENCH_POOL_SIZE, RS_LRU, NULL, 0, RM_WRITE_BACK };
+	Schema *schema = benchSchema();
+	RID *rids = (RID *) malloc(sizeof(RID) * BENCH_OPS);
+	Record *r;
+	BenchMark mark;
+	Value *v;
+	int i, rc, found = 0, threads, perWorker[BENCH_MAX_THREADS], key;
+	long sum = 0;
+	char name[32];
+	RM_PageFormat format = RM_PAGE_FIXED;
+	Expr *cond, *left, *right;
+
+	CHECK(initRecordManager(&config));
+	if (argc > 1 && strcmp(argv[1], "slotted") == 0)
+		format = RM_PAGE_SLOTTED;
+	else if (argc > 1 && strcmp(argv[1], "pax") == 0)
+		format = RM_PAGE_PAX;
+	CHECK(createTableWithIndex(BENCH_TABLE, schema, format,
+			argc > 2 && strcmp(argv[2], "btree") == 0 ? RM_INDEX_BTREE : RM_INDEX_NONE));
+	CHECK(openTable(&table, BENCH_TABLE));
+	CHECK(createRecord(&r, schema));
+	v = stringToValue("sbenchmark");
+	CHECK(setAttr(r, schema, 1, v));
+	freeVal(v);
+
+	printf("%-14s %8s %10s %10s\n", "operation", "ops", "ns/op", "allocs/op");
+
+	benchStart(&mark);
+	for(i = 0; i < BENCH_OPS; i++)
+	{
+		*(int *) r->data = i;
+		CHECK(insertRecord(&table, r));
+		rids[i] = r->id;
+	}
+	benchReport(&mark, "insertRecord", BENCH_OPS);
+
+	benchStart(&mark);
+	for(i = 0; i < BENCH_OPS; i++)
+		CHECK(getRecord(&table, rids[(i * 7919) % BENCH_OPS], r));
+	benchReport(&mark, "getRecord", BENCH_OPS);
+
+	benchStart(&mark);
+	for(i = 0; i < BENCH_OPS; i++)
+	{
+		CHECK(getRecordView(&table, rids[(i * 7919) % BENCH_OPS], &view));
+		CHECK(releaseRecordView(&view));
+	}
+	benchReport(&mark, "getRecordView", BENCH_OPS);
+
+	benchStart(&mark);
+	for(i = 0; i < BENCH_OPS; i++)
+	{
+		CHECK(getAttr(r, schema, 0, &v));
+		sum += v->v.intV;
+		freeVal(v);
+	}
+	benchReport(&mark, "getAttr", BENCH_OPS);
+
+	benchStart(&mark);
+	for(i = 0; i < BENCH_OPS; i++)
+	{
+		CHECK(getIntAttr(r, schema, 0, &key));
+		sum -= key;
+	}
+	benchReport(&mark, "getIntAttr", BENCH_OPS);
+
+	benchStart(&mark);
+	for(i = 0; i < BENCH_OPS; i++)
+	{
+		r->id = rids[i];
+		*(int *) r->data = -i;
+		CHECK(updateRecord(&table, r));
+	}
+	benchReport(&mark, "updateRecord", BENCH_OPS);
+
+	CHECK(startScan(&table, &scan, NULL));
+	benchStart(&mark);
+	while((rc = next(&scan, r)) == RC_OK)
+		found++;
+	benchReport(&mark, "next", found);
+	if (rc != RC_RM_NO_MORE_TUPLES) CHECK(rc);
+	CHECK(closeScan(&scan));
+
+	CHECK(startScan(&table, &scan, NULL));
+	found = 0;
+	benchStart(&mark);
+	while((rc = nextView(&scan, &view)) == RC_OK)
+	{
+		found++;
+		CHECK(releaseRecordView(&view));
+	}
+	benchReport(&mark, "nextView", found);
+	if (rc != RC_RM_NO_MORE_TUPLES) CHECK(rc);
+	CHECK(closeScan(&scan));
+
+	CHECK(startScanWithProjection(&table, &scan, NULL, projection, 1));
+	CHECK(createRecord(&projected, getScanSchema(&scan)));
+	found = 0;
+	benchStart(&mark);
+	while((rc = next(&scan, projected)) == RC_OK)
+		found++;
+	benchReport(&mark, "next (a only)", found);
+	if (rc != RC_RM_NO_MORE_TUPLES) CHECK(rc);
+	freeRecord(projected);
+	CHECK(closeScan(&scan));
+
+	CHECK(createRecordBatch(&batch, schema, BENCH_BATCH_SIZE));
+	CHECK(startScan(&table, &scan, NULL));
+	found = 0;
+	benchStart(&mark);
+	while((rc = nextBatch(&scan, batch, BENCH_BATCH_SIZE)) == RC_OK)
+		found += batch->numRecords;
+	benchReport(&mark, "nextBatch", found);
+	if (rc != RC_RM_NO_MORE_TUPLES) CHECK(rc);
+	CHECK(closeScan(&scan));
+	CHECK(freeRecordBatch(batch));
+
+	// selective scan: every row is tested, one matches
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i-5"));
+	MAKE_BINOP_EXPR(cond, left, right, OP_COMP_EQUAL);
+	CHECK(startScan(&table, &scan, cond));
+	benchStart(&mark);
+	while((rc = next(&scan, r)) == RC_OK)
+		;
+	benchReport(&mark, "next (a = -5)", found);
+	if (rc != RC_RM_NO_MORE_TUPLES) CHECK(rc);
+	CHECK(closeScan(&scan));
+	freeExpr(cond);
+
+	// every row matches; the zone maps cannot rule out a page
+	MAKE_ATTRREF(left, 1);
+	MAKE_CONS(right, stringToValue("sbenchmark"));
+	MAKE_BINOP_EXPR(cond, left, right, OP_COMP_EQUAL);
+	for(threads = 1; threads <= BENCH_MAX_THREADS; threads *= 2)
+	{
+		memset(perWorker, 0, sizeof(perWorker));
+		sprintf(name, "parallel x%d", threads);
+		benchStart(&mark);
+		CHECK(parallelScan(&table, cond, threads, countRow, perWorker));
+		benchReport(&mark, name, BENCH_OPS);
+	}
+	freeExpr(cond);
+
+	benchStart(&mark);
+	for(i = 0; i < BENCH_OPS; i++)
+		CHECK(deleteRecord(&table, rids[i]));
+	benchReport(&mark, "deleteRecord", BENCH_OPS);
+
+	CHECK(closeTable(&table));
+	CHECK(deleteTable(BENCH_TABLE));
+	CHECK(shutdownRecordManager());
+	freeRecord(r);
+	freeSchema(schema);
+	free(rids);
+
+	benchPredicates();
+	return 0;
+}
+
+// Conditions from testScans evaluated on in-memory rows of its schema
+// (a INT, b STRING(4), c INT): the expression tree, the compiled predicate
+// one row at a time, and the compiled predicate on batches of rows
+static void
+benchPredicates (void)
+{
+	char *names[] = { "a", "b", "c" };
+	DataType dt[] = { DT_INT, DT_STRING, DT_INT };
+	int sizes[] = { 0, 4, 0 };
+	int keys[] = { 0 };
+	int cs[] = { 3, 2, 1, 3, 5, 1, 3, 3, 2, 5 };
+	char *conds[][2] = { { "c=1", "i1" }, { "b=ffff", "sffff" } };
+	int attrs[] = { 2, 1 };
+	Schema *schema = createSchema(3, names, dt, sizes, 1, keys);
+	int size = getRecordSize(schema), i, k, counts[3];
+	char *rows = (char *) malloc((size_t) BENCH_OPS * size);
+	uint64_t *selection = (uint64_t *) malloc((BENCH_BATCH_SIZE / 64) * sizeof(uint64_t));
+	char name[32], str[5];
+	Predicate *pred;
+	BenchMark mark;
+	Record rec;
+	Expr *cond, *left, *right;
+	Value *v;
+
+	for(i = 0; i < BENCH_OPS; i++)
+	{
+		int a = i % 10 + 1;
+		rec.data = rows + (size_t) i * size;
+		memset(str, 'a' + i % 10, 4);
+		CHECK(setAttrRaw(&rec, schema, 0, &a, 0));
+		CHECK(setAttrRaw(&rec, schema, 1, str, 4));
+		CHECK(setAttrRaw(&rec, schema, 2, &cs[i % 10], 0));
+	}
+
+	for(k = 0; k < 2; k++)
+	{
+		MAKE_ATTRREF(left, attrs[k]);
+		MAKE_CONS(right, stringToValue(conds[k][1]));
+		MAKE_BINOP_EXPR(cond, left, right, OP_COMP_EQUAL);
+		CHECK(compilePredicate(cond, schema, &pred));
+		memset(counts, 0, sizeof(counts));
+
+		benchStart(&mark);
+		for(i = 0; i < BENCH_OPS; i++)
+		{
+			rec.data = rows + (size_t) i * size;
+			CHECK(evalExpr(&rec, schema, cond, &v));
+			counts[0] += v->v.boolV;
+			freeVal(v);
+		}
+		sprintf(name, "expr %s", conds[k][0]);
+		benchReport(&mark, name, BENCH_OPS);
+
+		benchStart(&mark);
+		for(i = 0; i < BENCH_OPS; i++)
+		{
+			rec.data = rows + (size_t) i * size;
+			counts[1] += evalPredicate(pred, &rec);
+		}
+		sprintf(name, "pred %s", conds[k][0]);
+		benchReport(&mark, name, BENCH_OPS);
+
+		benchStart(&mark);
+		for(i = 0; i < BENCH_OPS; i += BENCH_BATCH_SIZE)
+		{
+			int n = BENCH_OPS - i < BENCH_BATCH_SIZE ? BENCH_OPS - i : BENCH_BATCH_SIZE;
+			evalPredicateBatch(pred, rows + (size_t) i * size, size, n, selection);
+			for(int w = 0; w < (n + 63) / 64; w++)
+				counts[2] += __builtin_popcountll(selection[w]);
+		}
+		sprintf(name, "batch %s", conds[k][0]);
+		benchReport(&mark, name, BENCH_OPS);
+
+		if (counts[0] != counts[1] || counts[0] != counts[2])
+			printf("%s: evaluators disagree (%d, %d, %d rows)\n", conds[k][0], counts[0], counts[1], counts[2]);
+		freePredicate(pred);
+		freeExpr(cond);
+	}
+
+	free(selection);
+	free(rows);
+	freeSchema(schema);
+}
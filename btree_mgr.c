@@ -0,0 +1,856 @@
+#include "btree_mgr.h"
+#include "buffer_mgr.h"
+#include "storage_mgr.h"
+#include "dberror.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Disk-based B+-tree. Page 0 holds the tree info; every other page is a node
+// or sits on the free list. Leaves hold (key, RID) entries and are chained
+// left to right; internal nodes hold n keys and n + 1 child pages. A node
+// has room for one entry more than its maximum, so a full node takes the
+// insert before it is split.
+
+#define INFO_PAGE 0
+#define BTREE_MAGIC 0x42545245
+#define BTREE_POOL_SIZE 16
+#define FREE_NODE -1
+
+typedef struct BTreeInfo {
+	int magic;
+	DataType keyType;
+	int keyLength;
+	int maxKeys;
+	int duplicates;
+	int root;
+	int numNodes;
+	int numEntries;
+	int numPages;
+	int freePage;
+} BTreeInfo;
+
+typedef struct NodeHeader {
+	int isLeaf;     // FREE_NODE on the free list
+	int numKeys;
+	int next;       // right sibling of a leaf, next free page, or -1
+	int reserved;
+} NodeHeader;
+
+typedef struct BTreeManager {
+	BM_BufferPool *bm;
+	BTreeInfo info;
+	int entrySize;
+	char *separator;   // scratch entry passed up by splits
+} BTreeManager;
+
+typedef struct TreeScan {
+	int page;
+	int pos;
+	bool bounded;
+	char high[];       // upper bound entry when bounded
+} TreeScan;
+
+static int keySize(DataType keyType, int keyLength);
+static int maxKeysPerNode(int entrySize);
+static RC encodeEntry(BTreeManager *bt, Value *key, RID rid, char *entry);
+static int compareKeys(BTreeManager *bt, const char *a, const char *b);
+static int compareEntries(BTreeManager *bt, const char *a, const char *b);
+static NodeHeader *nodeHeader(char *node);
+static int *nodeChildren(char *node);
+static char *nodeEntry(BTreeManager *bt, char *node, int i);
+static RID entryRID(BTreeManager *bt, const char *entry);
+static int lowerBound(BTreeManager *bt, char *node, const char *entry);
+static int upperBound(BTreeManager *bt, char *node, const char *entry);
+static RC allocNode(BTreeManager *bt, BM_PageHandle *ph, bool isLeaf);
+static RC freeNode(BTreeManager *bt, int page);
+static RC insertInto(BTreeManager *bt, int page, const char *entry, int *newPage);
+static int minKeys(BTreeManager *bt, bool isLeaf);
+static RC deleteFrom(BTreeManager *bt, int page, const char *entry, bool *underflow);
+static RC rebalance(BTreeManager *bt, BM_PageHandle *parent, int idx);
+static RC seekLeaf(BTreeManager *bt, const char *entry, int *page, int *pos);
+static RC lookupEntry(BTreeManager *bt, Value *key, char *entry);
+static RC openScan(BTreeHandle *tree, Value *low, Value *high, BT_ScanHandle **handle);
+static void appendText(char **buf, int *length, int *capacity, const char *text);
+static void appendKey(BTreeManager *bt, const char *entry, char **buf, int *length, int *capacity);
+static int numberNodes(BTreeManager *bt, int page, int *positions, int next);
+static void printNode(BTreeManager *bt, int page, int *positions, char **buf, int *length, int *capacity);
+
+RC initIndexManager(void *mgmtData) {
+	(void)mgmtData;
+	return RC_OK;
+}
+
+RC shutdownIndexManager() {
+	return RC_OK;
+}
+
+RC createBtree(char *idxId, DataType keyType, int n) {
+	return createBtreeWithOptions(idxId, keyType, 0, n, false);
+}
+
+RC createBtreeWithOptions(char *idxId, DataType keyType, int keyLength, int n, bool duplicates) {
+	BM_BufferPool bm;
+	BM_PageHandle ph;
+	RC rc;
+
+	if (!idxId || (keyType == DT_STRING && keyLength <= 0))
+		THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	int entrySize = keySize(keyType, keyLength) + sizeof(RID);
+	int maxKeys = maxKeysPerNode(entrySize);
+	if (n > maxKeys || maxKeys < 2) THROW(RC_IM_N_TO_LAGE, "Too many keys per node");
+	if (n == 1) THROW(RC_FILE_HANDLE_NOT_INIT, "Nodes need room for two keys");
+
+	rc = createPageFile(idxId);
+	if (rc != RC_OK) return rc;
+	rc = initBufferPool(&bm, idxId, 3, RS_FIFO, NULL);
+	if (rc != RC_OK) return rc;
+
+	// the root starts out as an empty leaf
+	BTreeInfo info = { BTREE_MAGIC, keyType, keyLength, n > 0 ? n : maxKeys, duplicates, 1, 1, 0, 2, -1 };
+	rc = ensurePoolCapacity(&bm, 2);
+	if (rc == RC_OK) rc = pinPage(&bm, &ph, 1);
+	if (rc == RC_OK) {
+		NodeHeader *header = nodeHeader(ph.data);
+		header->isLeaf = 1;
+		header->numKeys = 0;
+		header->next = -1;
+		markDirty(&bm, &ph);
+		unpinPage(&bm, &ph);
+		rc = pinPage(&bm, &ph, INFO_PAGE);
+	}
+	if (rc == RC_OK) {
+		memcpy(ph.data, &info, sizeof(BTreeInfo));
+		markDirty(&bm, &ph);
+		unpinPage(&bm, &ph);
+	}
+	shutdownBufferPool(&bm);
+	return rc;
+}
+
+RC openBtree(BTreeHandle **tree, char *idxId) {
+	BM_PageHandle ph;
+	if (!tree || !idxId) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+
+	BTreeManager *bt = (BTreeManager *)malloc(sizeof(BTreeManager));
+	bt->bm = (BM_BufferPool *)malloc(sizeof(BM_BufferPool));
+	RC rc = initBufferPool(bt->bm, idxId, BTREE_POOL_SIZE, RS_LRU, NULL);
+	if (rc == RC_OK) {
+		rc = pinPage(bt->bm, &ph, INFO_PAGE);
+		if (rc == RC_OK) {
+			memcpy(&bt->info, ph.data, sizeof(BTreeInfo));
+			unpinPage(bt->bm, &ph);
+			if (bt->info.magic != BTREE_MAGIC) {
+				RC_message = "Unsupported index format";
+				rc = RC_IM_UNSUPPORTED_INDEX_FORMAT;
+			}
+		}
+		if (rc != RC_OK) shutdownBufferPool(bt->bm);
+	}
+	if (rc != RC_OK) {
+		free(bt->bm);
+		free(bt);
+		return rc;
+	}
+
+	bt->entrySize = keySize(bt->info.keyType, bt->info.keyLength) + sizeof(RID);
+	bt->separator = (char *)malloc(bt->entrySize);
+	BTreeHandle *handle = (BTreeHandle *)malloc(sizeof(BTreeHandle));
+	handle->keyType = bt->info.keyType;
+	handle->idxId = (char *)malloc(strlen(idxId) + 1);
+	strcpy(handle->idxId, idxId);
+	handle->mgmtData = bt;
+	*tree = handle;
+	return RC_OK;
+}
+
+RC closeBtree(BTreeHandle *tree) {
+	BM_PageHandle ph;
+	if (!tree || !tree->mgmtData) THROW(RC_FILE_HANDLE_NOT_INIT, "Index not initialized");
+	BTreeManager *bt = (BTreeManager *)tree->mgmtData;
+
+	RC rc = pinPage(bt->bm, &ph, INFO_PAGE);
+	if (rc == RC_OK) {
+		beginPageWrite(bt->bm, &ph);
+		memcpy(ph.data, &bt->info, sizeof(BTreeInfo));
+		markDirty(bt->bm, &ph);
+		unpinPage(bt->bm, &ph);
+	}
+	forceFlushPool(bt->bm);
+	shutdownBufferPool(bt->bm);
+	free(bt->bm);
+	free(bt->separator);
+	free(bt);
+	free(tree->idxId);
+	free(tree);
+	return rc;
+}
+
+RC deleteBtree(char *idxId) {
+	if (!idxId) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	discardWorkingSet(idxId);
+	return destroyPageFile(idxId);
+}
+
+RC getNumNodes(BTreeHandle *tree, int *result) {
+	if (!tree || !tree->mgmtData || !result) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	*result = ((BTreeManager *)tree->mgmtData)->info.numNodes;
+	return RC_OK;
+}
+
+RC getNumEntries(BTreeHandle *tree, int *result) {
+	if (!tree || !tree->mgmtData || !result) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	*result = ((BTreeManager *)tree->mgmtData)->info.numEntries;
+	return RC_OK;
+}
+
+RC getKeyType(BTreeHandle *tree, DataType *result) {
+	if (!tree || !result) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	*result = tree->keyType;
+	return RC_OK;
+}
+
+RC findKey(BTreeHandle *tree, Value *key, RID *result) {
+	if (!tree || !tree->mgmtData || !key || !result) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	BTreeManager *bt = (BTreeManager *)tree->mgmtData;
+	char entry[PAGE_SIZE];
+	RC rc = lookupEntry(bt, key, entry);
+	if (rc == RC_OK) *result = entryRID(bt, entry);
+	return rc;
+}
+
+RC insertKey(BTreeHandle *tree, Value *key, RID rid) {
+	if (!tree || !tree->mgmtData || !key) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	BTreeManager *bt = (BTreeManager *)tree->mgmtData;
+	BM_PageHandle ph;
+	char entry[PAGE_SIZE];
+	int newPage;
+
+	RC rc = encodeEntry(bt, key, rid, entry);
+	if (rc != RC_OK) return rc;
+	rc = insertInto(bt, bt->info.root, entry, &newPage);
+	if (rc != RC_OK) return rc;
+
+	if (newPage >= 0) {
+		// the root split: grow the tree by one level
+		rc = allocNode(bt, &ph, false);
+		if (rc != RC_OK) return rc;
+		nodeHeader(ph.data)->numKeys = 1;
+		nodeChildren(ph.data)[0] = bt->info.root;
+		nodeChildren(ph.data)[1] = newPage;
+		memcpy(nodeEntry(bt, ph.data, 0), bt->separator, bt->entrySize);
+		bt->info.root = ph.pageNum;
+		markDirty(bt->bm, &ph);
+		unpinPage(bt->bm, &ph);
+	}
+	bt->info.numEntries++;
+	return RC_OK;
+}
+
+RC deleteKey(BTreeHandle *tree, Value *key) {
+	if (!tree || !tree->mgmtData || !key) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	BTreeManager *bt = (BTreeManager *)tree->mgmtData;
+	char entry[PAGE_SIZE];
+	RC rc = lookupEntry(bt, key, entry);
+	if (rc != RC_OK) return rc;
+	return deleteKeyEntry(tree, key, entryRID(bt, entry));
+}
+
+RC deleteKeyEntry(BTreeHandle *tree, Value *key, RID rid) {
+	if (!tree || !tree->mgmtData || !key) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	BTreeManager *bt = (BTreeManager *)tree->mgmtData;
+	BM_PageHandle ph;
+	char entry[PAGE_SIZE];
+	bool underflow;
+
+	RC rc = encodeEntry(bt, key, rid, entry);
+	if (rc != RC_OK) return rc;
+	rc = deleteFrom(bt, bt->info.root, entry, &underflow);
+	if (rc != RC_OK) return rc;
+	bt->info.numEntries--;
+
+	// an internal root left with a single child hands the root to it
+	rc = pinPage(bt->bm, &ph, bt->info.root);
+	if (rc != RC_OK) return rc;
+	NodeHeader *header = nodeHeader(ph.data);
+	if (header->isLeaf || header->numKeys > 0) return unpinPage(bt->bm, &ph);
+	int oldRoot = bt->info.root;
+	bt->info.root = nodeChildren(ph.data)[0];
+	unpinPage(bt->bm, &ph);
+	return freeNode(bt, oldRoot);
+}
+
+RC openTreeScan(BTreeHandle *tree, BT_ScanHandle **handle) {
+	return openScan(tree, NULL, NULL, handle);
+}
+
+RC openTreeRangeScan(BTreeHandle *tree, Value *low, Value *high, BT_ScanHandle **handle) {
+	return openScan(tree, low, high, handle);
+}
+
+RC nextEntry(BT_ScanHandle *handle, RID *result) {
+	if (!handle || !handle->mgmtData || !result) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	BTreeManager *bt = (BTreeManager *)handle->tree->mgmtData;
+	TreeScan *scan = (TreeScan *)handle->mgmtData;
+	BM_PageHandle ph;
+
+	while (scan->page >= 0) {
+		RC rc = pinPage(bt->bm, &ph, scan->page);
+		if (rc != RC_OK) return rc;
+		NodeHeader *header = nodeHeader(ph.data);
+		if (scan->pos >= header->numKeys) {
+			scan->page = header->next;
+			scan->pos = 0;
+			unpinPage(bt->bm, &ph);
+			continue;
+		}
+		char *entry = nodeEntry(bt, ph.data, scan->pos++);
+		if (scan->bounded && compareKeys(bt, entry, scan->high) > 0) {
+			scan->page = -1;
+			unpinPage(bt->bm, &ph);
+			break;
+		}
+		*result = entryRID(bt, entry);
+		return unpinPage(bt->bm, &ph);
+	}
+
+	THROW(RC_IM_NO_MORE_ENTRIES, "No more entries");
+}
+
+RC closeTreeScan(BT_ScanHandle *handle) {
+	if (!handle) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	free(handle->mgmtData);
+	free(handle);
+	return RC_OK;
+}
+
+// One line per node in depth-first order: "(pos)[...]". Internal nodes list
+// child positions and keys; leaves list RID,key pairs and end with the
+// position of the next leaf.
+char *printTree(BTreeHandle *tree) {
+	if (!tree || !tree->mgmtData) return NULL;
+	BTreeManager *bt = (BTreeManager *)tree->mgmtData;
+	int *positions = (int *)malloc(bt->info.numPages * sizeof(int));
+	int length = 0, capacity = 256;
+	char *buf = (char *)malloc(capacity);
+
+	buf[0] = '\0';
+	memset(positions, -1, bt->info.numPages * sizeof(int));
+	numberNodes(bt, bt->info.root, positions, 0);
+	printNode(bt, bt->info.root, positions, &buf, &length, &capacity);
+	free(positions);
+	return buf;
+}
+
+static int keySize(DataType keyType, int keyLength) {
+	switch (keyType) {
+	case DT_INT: return sizeof(int);
+	case DT_FLOAT: return sizeof(float);
+	case DT_BOOL: return sizeof(bool);
+	case DT_STRING: return keyLength;
+	}
+	return 0;
+}
+
+static int maxKeysPerNode(int entrySize) {
+	// an internal node with one extra key and child still has to fit
+	return (PAGE_SIZE - (int)sizeof(NodeHeader) - 2 * (int)sizeof(int) - entrySize) / (entrySize + (int)sizeof(int));
+}
+
+static RC encodeEntry(BTreeManager *bt, Value *key, RID rid, char *entry) {
+	if (key->dt != bt->info.keyType)
+		THROW(RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE, "Key type mismatch");
+	switch (key->dt) {
+	case DT_INT: memcpy(entry, &key->v.intV, sizeof(int)); break;
+	case DT_FLOAT: memcpy(entry, &key->v.floatV, sizeof(float)); break;
+	case DT_BOOL: memcpy(entry, &key->v.boolV, sizeof(bool)); break;
+	case DT_STRING: strncpy(entry, key->v.stringV, bt->info.keyLength); break;
+	}
+	memcpy(entry + bt->entrySize - sizeof(RID), &rid, sizeof(RID));
+	return RC_OK;
+}
+
+static int compareKeys(BTreeManager *bt, const char *a, const char *b) {
+	switch (bt->info.keyType) {
+	case DT_INT: {
+		int x, y;
+		memcpy(&x, a, sizeof(int));
+		memcpy(&y, b, sizeof(int));
+		return (x > y) - (x < y);
+	}
+	case DT_FLOAT: {
+		float x, y;
+		memcpy(&x, a, sizeof(float));
+		memcpy(&y, b, sizeof(float));
+		return (x > y) - (x < y);
+	}
+	case DT_BOOL: return (int)*(const bool *)a - (int)*(const bool *)b;
+	case DT_STRING: return memcmp(a, b, bt->info.keyLength);
+	}
+	return 0;
+}
+
+// Unique trees order entries by key alone; duplicate-key trees break ties
+// by RID, so every entry has a distinct position
+static int compareEntries(BTreeManager *bt, const char *a, const char *b) {
+	int cmp = compareKeys(bt, a, b);
+	if (cmp != 0 || !bt->info.duplicates) return cmp;
+	RID x = entryRID(bt, a), y = entryRID(bt, b);
+	if (x.page != y.page) return (x.page > y.page) - (x.page < y.page);
+	return (x.slot > y.slot) - (x.slot < y.slot);
+}
+
+static NodeHeader *nodeHeader(char *node) {
+	return (NodeHeader *)node;
+}
+
+static int *nodeChildren(char *node) {
+	return (int *)(node + sizeof(NodeHeader));
+}
+
+static char *nodeEntry(BTreeManager *bt, char *node, int i) {
+	int offset = sizeof(NodeHeader);
+	if (!nodeHeader(node)->isLeaf) offset += (bt->info.maxKeys + 2) * sizeof(int);
+	return node + offset + i * bt->entrySize;
+}
+
+static RID entryRID(BTreeManager *bt, const char *entry) {
+	RID rid;
+	memcpy(&rid, entry + bt->entrySize - sizeof(RID), sizeof(RID));
+	return rid;
+}
+
+// First entry >= entry
+static int lowerBound(BTreeManager *bt, char *node, const char *entry) {
+	int low = 0, high = nodeHeader(node)->numKeys;
+	while (low < high) {
+		int mid = (low + high) / 2;
+		if (compareEntries(bt, nodeEntry(bt, node, mid), entry) < 0) low = mid + 1;
+		else high = mid;
+	}
+	return low;
+}
+
+// First entry > entry; in an internal node, the child to descend into
+static int upperBound(BTreeManager *bt, char *node, const char *entry) {
+	int low = 0, high = nodeHeader(node)->numKeys;
+	while (low < high) {
+		int mid = (low + high) / 2;
+		if (compareEntries(bt, nodeEntry(bt, node, mid), entry) <= 0) low = mid + 1;
+		else high = mid;
+	}
+	return low;
+}
+
+// Pins a fresh node, reusing a page from the free list if there is one
+static RC allocNode(BTreeManager *bt, BM_PageHandle *ph, bool isLeaf) {
+	int page = bt->info.freePage;
+	RC rc;
+	if (page >= 0) {
+		rc = pinPage(bt->bm, ph, page);
+		if (rc != RC_OK) return rc;
+		bt->info.freePage = nodeHeader(ph->data)->next;
+	} else {
+		page = bt->info.numPages;
+		rc = ensurePoolCapacity(bt->bm, page + 1);
+		if (rc != RC_OK) return rc;
+		rc = pinPage(bt->bm, ph, page);
+		if (rc != RC_OK) return rc;
+		bt->info.numPages++;
+	}
+	beginPageWrite(bt->bm, ph);
+	NodeHeader *header = nodeHeader(ph->data);
+	header->isLeaf = isLeaf;
+	header->numKeys = 0;
+	header->next = -1;
+	bt->info.numNodes++;
+	return RC_OK;
+}
+
+static RC freeNode(BTreeManager *bt, int page) {
+	BM_PageHandle ph;
+	RC rc = pinPage(bt->bm, &ph, page);
+	if (rc != RC_OK) return rc;
+	beginPageWrite(bt->bm, &ph);
+	nodeHeader(ph.data)->isLeaf = FREE_NODE;
+	nodeHeader(ph.data)->numKeys = 0;
+	nodeHeader(ph.data)->next = bt->info.freePage;
+	bt->info.freePage = page;
+	bt->info.numNodes--;
+	markDirty(bt->bm, &ph);
+	return unpinPage(bt->bm, &ph);
+}
+
+// Inserts entry into the subtree at page. If the node splits, *newPage is
+// the new right node and bt->separator its first key; otherwise -1. Nodes
+// are unpinned while their children are worked on, so the pool only needs
+// room for a node and its new sibling.
+static RC insertInto(BTreeManager *bt, int page, const char *entry, int *newPage) {
+	BM_PageHandle ph, rightPh;
+	int maxKeys = bt->info.maxKeys;
+	RC rc;
+
+	*newPage = -1;
+	rc = pinPage(bt->bm, &ph, page);
+	if (rc != RC_OK) return rc;
+	NodeHeader *header = nodeHeader(ph.data);
+	int pos;
+
+	if (header->isLeaf) {
+		pos = lowerBound(bt, ph.data, entry);
+		if (pos < header->numKeys && compareEntries(bt, nodeEntry(bt, ph.data, pos), entry) == 0) {
+			unpinPage(bt->bm, &ph);
+			THROW(RC_IM_KEY_ALREADY_EXISTS, "Key already exists");
+		}
+		beginPageWrite(bt->bm, &ph);
+		memmove(nodeEntry(bt, ph.data, pos + 1), nodeEntry(bt, ph.data, pos), (header->numKeys - pos) * bt->entrySize);
+		memcpy(nodeEntry(bt, ph.data, pos), entry, bt->entrySize);
+		header->numKeys++;
+	} else {
+		int childNew;
+		pos = upperBound(bt, ph.data, entry);
+		int child = nodeChildren(ph.data)[pos];
+		unpinPage(bt->bm, &ph);
+		rc = insertInto(bt, child, entry, &childNew);
+		if (rc != RC_OK || childNew < 0) return rc;
+
+		rc = pinPage(bt->bm, &ph, page);
+		if (rc != RC_OK) return rc;
+		header = nodeHeader(ph.data);
+		int *children = nodeChildren(ph.data);
+		beginPageWrite(bt->bm, &ph);
+		memmove(nodeEntry(bt, ph.data, pos + 1), nodeEntry(bt, ph.data, pos), (header->numKeys - pos) * bt->entrySize);
+		memcpy(nodeEntry(bt, ph.data, pos), bt->separator, bt->entrySize);
+		memmove(children + pos + 2, children + pos + 1, (header->numKeys - pos) * sizeof(int));
+		children[pos + 1] = childNew;
+		header->numKeys++;
+	}
+
+	if (header->numKeys > maxKeys) {
+		rc = allocNode(bt, &rightPh, header->isLeaf);
+		if (rc != RC_OK) {
+			markDirty(bt->bm, &ph);
+			unpinPage(bt->bm, &ph);
+			return rc;
+		}
+		NodeHeader *right = nodeHeader(rightPh.data);
+		int total = header->numKeys;
+		if (header->isLeaf) {
+			int keep = (total + 1) / 2;
+			right->numKeys = total - keep;
+			memcpy(nodeEntry(bt, rightPh.data, 0), nodeEntry(bt, ph.data, keep), right->numKeys * bt->entrySize);
+			memcpy(bt->separator, nodeEntry(bt, rightPh.data, 0), bt->entrySize);
+			right->next = header->next;
+			header->next = rightPh.pageNum;
+			header->numKeys = keep;
+		} else {
+			// the middle key moves up rather than being copied
+			int mid = total / 2;
+			right->numKeys = total - mid - 1;
+			memcpy(nodeEntry(bt, rightPh.data, 0), nodeEntry(bt, ph.data, mid + 1), right->numKeys * bt->entrySize);
+			memcpy(nodeChildren(rightPh.data), nodeChildren(ph.data) + mid + 1, (right->numKeys + 1) * sizeof(int));
+			memcpy(bt->separator, nodeEntry(bt, ph.data, mid), bt->entrySize);
+			header->numKeys = mid;
+		}
+		*newPage = rightPh.pageNum;
+		markDirty(bt->bm, &rightPh);
+		unpinPage(bt->bm, &rightPh);
+	}
+
+	markDirty(bt->bm, &ph);
+	return unpinPage(bt->bm, &ph);
+}
+
+static int minKeys(BTreeManager *bt, bool isLeaf) {
+	return isLeaf ? (bt->info.maxKeys + 1) / 2 : bt->info.maxKeys / 2;
+}
+
+// Removes entry from the subtree at page; *underflow tells the parent that
+// the node dropped below its minimum fill
+static RC deleteFrom(BTreeManager *bt, int page, const char *entry, bool *underflow) {
+	BM_PageHandle ph;
+	RC rc = pinPage(bt->bm, &ph, page);
+	if (rc != RC_OK) return rc;
+	NodeHeader *header = nodeHeader(ph.data);
+
+	*underflow = false;
+	if (header->isLeaf) {
+		int pos = lowerBound(bt, ph.data, entry);
+		if (pos >= header->numKeys || compareEntries(bt, nodeEntry(bt, ph.data, pos), entry) != 0) {
+			unpinPage(bt->bm, &ph);
+			THROW(RC_IM_KEY_NOT_FOUND, "Key not found");
+		}
+		beginPageWrite(bt->bm, &ph);
+		memmove(nodeEntry(bt, ph.data, pos), nodeEntry(bt, ph.data, pos + 1), (header->numKeys - pos - 1) * bt->entrySize);
+		header->numKeys--;
+		*underflow = header->numKeys < minKeys(bt, true);
+		markDirty(bt->bm, &ph);
+		return unpinPage(bt->bm, &ph);
+	}
+
+	bool childUnderflow;
+	int idx = upperBound(bt, ph.data, entry);
+	int child = nodeChildren(ph.data)[idx];
+	unpinPage(bt->bm, &ph);
+	rc = deleteFrom(bt, child, entry, &childUnderflow);
+	if (rc != RC_OK || !childUnderflow) return rc;
+
+	rc = pinPage(bt->bm, &ph, page);
+	if (rc != RC_OK) return rc;
+	rc = rebalance(bt, &ph, idx);
+	*underflow = nodeHeader(ph.data)->numKeys < minKeys(bt, false);
+	markDirty(bt->bm, &ph);
+	unpinPage(bt->bm, &ph);
+	return rc;
+}
+
+// Refills the underfull child idx of parent from a sibling, or merges the
+// two when the sibling has nothing to spare
+static RC rebalance(BTreeManager *bt, BM_PageHandle *parent, int idx) {
+	BM_PageHandle leftPh, rightPh;
+	int *parentChildren = nodeChildren(parent->data);
+	NodeHeader *parentHeader = nodeHeader(parent->data);
+	int sepIdx = idx > 0 ? idx - 1 : 0;
+	bool childIsLeft = idx == 0;
+	RC rc;
+
+	rc = pinPage(bt->bm, &leftPh, parentChildren[sepIdx]);
+	if (rc != RC_OK) return rc;
+	rc = pinPage(bt->bm, &rightPh, parentChildren[sepIdx + 1]);
+	if (rc != RC_OK) {
+		unpinPage(bt->bm, &leftPh);
+		return rc;
+	}
+	NodeHeader *left = nodeHeader(leftPh.data);
+	NodeHeader *right = nodeHeader(rightPh.data);
+	char *separator = nodeEntry(bt, parent->data, sepIdx);
+	int entrySize = bt->entrySize;
+	bool merge;
+
+	beginPageWrite(bt->bm, parent);
+	beginPageWrite(bt->bm, &leftPh);
+	beginPageWrite(bt->bm, &rightPh);
+
+	if (left->isLeaf) {
+		merge = left->numKeys + right->numKeys <= bt->info.maxKeys;
+		if (merge) {
+			memcpy(nodeEntry(bt, leftPh.data, left->numKeys), nodeEntry(bt, rightPh.data, 0), right->numKeys * entrySize);
+			left->numKeys += right->numKeys;
+			left->next = right->next;
+		} else if (childIsLeft) {
+			memcpy(nodeEntry(bt, leftPh.data, left->numKeys), nodeEntry(bt, rightPh.data, 0), entrySize);
+			memmove(nodeEntry(bt, rightPh.data, 0), nodeEntry(bt, rightPh.data, 1), (right->numKeys - 1) * entrySize);
+			left->numKeys++;
+			right->numKeys--;
+			memcpy(separator, nodeEntry(bt, rightPh.data, 0), entrySize);
+		} else {
+			memmove(nodeEntry(bt, rightPh.data, 1), nodeEntry(bt, rightPh.data, 0), right->numKeys * entrySize);
+			memcpy(nodeEntry(bt, rightPh.data, 0), nodeEntry(bt, leftPh.data, left->numKeys - 1), entrySize);
+			left->numKeys--;
+			right->numKeys++;
+			memcpy(separator, nodeEntry(bt, rightPh.data, 0), entrySize);
+		}
+	} else {
+		int *leftChildren = nodeChildren(leftPh.data);
+		int *rightChildren = nodeChildren(rightPh.data);
+		merge = left->numKeys + right->numKeys + 1 <= bt->info.maxKeys;
+		if (merge) {
+			// the separator comes down between the two halves
+			memcpy(nodeEntry(bt, leftPh.data, left->numKeys), separator, entrySize);
+			memcpy(nodeEntry(bt, leftPh.data, left->numKeys + 1), nodeEntry(bt, rightPh.data, 0), right->numKeys * entrySize);
+			memcpy(leftChildren + left->numKeys + 1, rightChildren, (right->numKeys + 1) * sizeof(int));
+			left->numKeys += right->numKeys + 1;
+		} else if (childIsLeft) {
+			memcpy(nodeEntry(bt, leftPh.data, left->numKeys), separator, entrySize);
+			leftChildren[left->numKeys + 1] = rightChildren[0];
+			left->numKeys++;
+			memcpy(separator, nodeEntry(bt, rightPh.data, 0), entrySize);
+			memmove(nodeEntry(bt, rightPh.data, 0), nodeEntry(bt, rightPh.data, 1), (right->numKeys - 1) * entrySize);
+			memmove(rightChildren, rightChildren + 1, right->numKeys * sizeof(int));
+			right->numKeys--;
+		} else {
+			memmove(nodeEntry(bt, rightPh.data, 1), nodeEntry(bt, rightPh.data, 0), right->numKeys * entrySize);
+			memmove(rightChildren + 1, rightChildren, (right->numKeys + 1) * sizeof(int));
+			memcpy(nodeEntry(bt, rightPh.data, 0), separator, entrySize);
+			rightChildren[0] = leftChildren[left->numKeys];
+			right->numKeys++;
+			memcpy(separator, nodeEntry(bt, leftPh.data, left->numKeys - 1), entrySize);
+			left->numKeys--;
+		}
+	}
+
+	if (merge) {
+		memmove(separator, separator + entrySize, (parentHeader->numKeys - sepIdx - 1) * entrySize);
+		memmove(parentChildren + sepIdx + 1, parentChildren + sepIdx + 2, (parentHeader->numKeys - sepIdx - 1) * sizeof(int));
+		parentHeader->numKeys--;
+	}
+	markDirty(bt->bm, &leftPh);
+	markDirty(bt->bm, &rightPh);
+	unpinPage(bt->bm, &leftPh);
+	unpinPage(bt->bm, &rightPh);
+	return merge ? freeNode(bt, rightPh.pageNum) : RC_OK;
+}
+
+// Leaf page and position of the first entry >= entry
+static RC seekLeaf(BTreeManager *bt, const char *entry, int *page, int *pos) {
+	BM_PageHandle ph;
+	int current = bt->info.root;
+	while (true) {
+		RC rc = pinPage(bt->bm, &ph, current);
+		if (rc != RC_OK) return rc;
+		if (nodeHeader(ph.data)->isLeaf) break;
+		int next = entry ? nodeChildren(ph.data)[upperBound(bt, ph.data, entry)] : nodeChildren(ph.data)[0];
+		unpinPage(bt->bm, &ph);
+		current = next;
+	}
+	*page = current;
+	*pos = entry ? lowerBound(bt, ph.data, entry) : 0;
+	return unpinPage(bt->bm, &ph);
+}
+
+// Copies out the first entry for key (the one with the lowest RID)
+static RC lookupEntry(BTreeManager *bt, Value *key, char *entry) {
+	BM_PageHandle ph;
+	char target[PAGE_SIZE];
+	RID lowest = {INT_MIN, INT_MIN};
+	int page, pos;
+
+	RC rc = encodeEntry(bt, key, lowest, target);
+	if (rc == RC_OK) rc = seekLeaf(bt, target, &page, &pos);
+	while (rc == RC_OK) {
+		rc = pinPage(bt->bm, &ph, page);
+		if (rc != RC_OK) return rc;
+		NodeHeader *header = nodeHeader(ph.data);
+		if (pos < header->numKeys) {
+			bool found = compareKeys(bt, nodeEntry(bt, ph.data, pos), target) == 0;
+			if (found) memcpy(entry, nodeEntry(bt, ph.data, pos), bt->entrySize);
+			unpinPage(bt->bm, &ph);
+			if (!found) break;
+			return RC_OK;
+		}
+		// a separator can outlive the key it was copied from
+		page = header->next;
+		pos = 0;
+		unpinPage(bt->bm, &ph);
+		if (page < 0) break;
+	}
+	if (rc != RC_OK) return rc;
+	THROW(RC_IM_KEY_NOT_FOUND, "Key not found");
+}
+
+static RC openScan(BTreeHandle *tree, Value *low, Value *high, BT_ScanHandle **handle) {
+	if (!tree || !tree->mgmtData || !handle) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	BTreeManager *bt = (BTreeManager *)tree->mgmtData;
+	RID lowest = {INT_MIN, INT_MIN};
+	char target[PAGE_SIZE];
+	RC rc;
+
+	TreeScan *scan = (TreeScan *)malloc(sizeof(TreeScan) + bt->entrySize);
+	scan->bounded = high != NULL;
+	rc = high ? encodeEntry(bt, high, lowest, scan->high) : RC_OK;
+	if (rc == RC_OK && low) rc = encodeEntry(bt, low, lowest, target);
+	if (rc == RC_OK) rc = seekLeaf(bt, low ? target : NULL, &scan->page, &scan->pos);
+	if (rc != RC_OK) {
+		free(scan);
+		return rc;
+	}
+
+	*handle = (BT_ScanHandle *)malloc(sizeof(BT_ScanHandle));
+	(*handle)->tree = tree;
+	(*handle)->mgmtData = scan;
+	return RC_OK;
+}
+
+static void appendText(char **buf, int *length, int *capacity, const char *text) {
+	int textLength = strlen(text);
+	while (*length + textLength + 1 > *capacity) {
+		*capacity *= 2;
+		*buf = (char *)realloc(*buf, *capacity);
+	}
+	memcpy(*buf + *length, text, textLength + 1);
+	*length += textLength;
+}
+
+static void appendKey(BTreeManager *bt, const char *entry, char **buf, int *length, int *capacity) {
+	char text[PAGE_SIZE + 1];
+	int intV;
+	float floatV;
+	switch (bt->info.keyType) {
+	case DT_INT:
+		memcpy(&intV, entry, sizeof(int));
+		sprintf(text, "%d", intV);
+		break;
+	case DT_FLOAT:
+		memcpy(&floatV, entry, sizeof(float));
+		sprintf(text, "%f", floatV);
+		break;
+	case DT_BOOL:
+		strcpy(text, *(const bool *)entry ? "true" : "false");
+		break;
+	case DT_STRING:
+		memcpy(text, entry, bt->info.keyLength);
+		text[bt->info.keyLength] = '\0';
+		break;
+	}
+	appendText(buf, length, capacity, text);
+}
+
+// Assigns depth-first positions to the nodes below page; returns the next
+// free position
+static int numberNodes(BTreeManager *bt, int page, int *positions, int next) {
+	BM_PageHandle ph;
+	int children[PAGE_SIZE / sizeof(int)];
+	int numChildren = 0;
+
+	positions[page] = next++;
+	if (pinPage(bt->bm, &ph, page) != RC_OK) return next;
+	if (!nodeHeader(ph.data)->isLeaf) {
+		numChildren = nodeHeader(ph.data)->numKeys + 1;
+		memcpy(children, nodeChildren(ph.data), numChildren * sizeof(int));
+	}
+	unpinPage(bt->bm, &ph);
+	for (int i = 0; i < numChildren; i++)
+		next = numberNodes(bt, children[i], positions, next);
+	return next;
+}
+
+static void printNode(BTreeManager *bt, int page, int *positions, char **buf, int *length, int *capacity) {
+	BM_PageHandle ph;
+	char text[64];
+	int children[PAGE_SIZE / sizeof(int)];
+	int numChildren = 0;
+
+	if (pinPage(bt->bm, &ph, page) != RC_OK) return;
+	NodeHeader *header = nodeHeader(ph.data);
+	sprintf(text, "(%d)[", positions[page]);
+	appendText(buf, length, capacity, text);
+	for (int i = 0; i < header->numKeys; i++) {
+		char *entry = nodeEntry(bt, ph.data, i);
+		if (header->isLeaf) {
+			RID rid = entryRID(bt, entry);
+			sprintf(text, i > 0 ? ",%d.%d," : "%d.%d,", rid.page, rid.slot);
+		} else {
+			sprintf(text, "%d,", positions[nodeChildren(ph.data)[i]]);
+		}
+		appendText(buf, length, capacity, text);
+		appendKey(bt, entry, buf, length, capacity);
+		if (!header->isLeaf) appendText(buf, length, capacity, ",");
+	}
+	if (header->isLeaf) {
+		if (header->next >= 0) {
+			sprintf(text, ",%d", positions[header->next]);
+			appendText(buf, length, capacity, text);
+		}
+	} else {
+		numChildren = header->numKeys + 1;
+		memcpy(children, nodeChildren(ph.data), numChildren * sizeof(int));
+		sprintf(text, "%d", positions[children[numChildren - 1]]);
+		appendText(buf, length, capacity, text);
+	}
+	appendText(buf, length, capacity, "]\n");
+	unpinPage(bt->bm, &ph);
+
+	for (int i = 0; i < numChildren; i++)
+		printNode(bt, children[i], positions, buf, length, capacity);
+}
@@ -0,0 +1,55 @@
+#ifndef BTREE_MGR_H
+#define BTREE_MGR_H
+
+#include "dberror.h"
+#include "tables.h"
+
+// structure for accessing btrees
+typedef struct BTreeHandle {
+	DataType keyType;
+	char *idxId;
+	void *mgmtData;
+} BTreeHandle;
+
+typedef struct BT_ScanHandle {
+	BTreeHandle *tree;
+	void *mgmtData;
+} BT_ScanHandle;
+
+// init and shutdown index manager
+extern RC initIndexManager (void *mgmtData);
+extern RC shutdownIndexManager ();
+
+// create, destroy, open, and close an btree index. n is the maximum number
+// of keys per node; 0 picks the most that fit a page.
+extern RC createBtree (char *idxId, DataType keyType, int n);
+// keyLength is the width of DT_STRING keys (other types ignore it). With
+// duplicates set, a key may map to several RIDs; entries are kept in
+// (key, RID) order and only an identical (key, RID) pair is rejected.
+extern RC createBtreeWithOptions (char *idxId, DataType keyType, int keyLength, int n, bool duplicates);
+extern RC openBtree (BTreeHandle **tree, char *idxId);
+extern RC closeBtree (BTreeHandle *tree);
+extern RC deleteBtree (char *idxId);
+
+// access information about a b-tree
+extern RC getNumNodes (BTreeHandle *tree, int *result);
+extern RC getNumEntries (BTreeHandle *tree, int *result);
+extern RC getKeyType (BTreeHandle *tree, DataType *result);
+
+// index access
+extern RC findKey (BTreeHandle *tree, Value *key, RID *result);
+extern RC insertKey (BTreeHandle *tree, Value *key, RID rid);
+extern RC deleteKey (BTreeHandle *tree, Value *key);
+// removes the entry for key that points at rid
+extern RC deleteKeyEntry (BTreeHandle *tree, Value *key, RID rid);
+extern RC openTreeScan (BTreeHandle *tree, BT_ScanHandle **handle);
+// scans the entries with low <= key <= high in key order; a NULL bound
+// leaves that end open
+extern RC openTreeRangeScan (BTreeHandle *tree, Value *low, Value *high, BT_ScanHandle **handle);
+extern RC nextEntry (BT_ScanHandle *handle, RID *result);
+extern RC closeTreeScan (BT_ScanHandle *handle);
+
+// debug and test functions
+extern char *printTree (BTreeHandle *tree);
+
+#endif // BTREE_MGR_H
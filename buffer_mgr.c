@@ -5,46 +5,137 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <stdint.h>
 
-typedef struct BM_PageFrame {
-	PageNumber pageNum;
-	char *data;
-	bool dirty;
-	int fixCount;
-	int lastUsed;
-	int accessCount;
-	bool refBit;
-} BM_PageFrame;
+#define BM_WARM_PREFETCH_BATCH 2
+#define BM_OPTIMISTIC_RETRIES 8
 
+// room for a page file name plus the ".warm" suffix
+#define WARM_FILE_NAME_SIZE(name) (strlen(name) + sizeof(".warm"))
+
+// one bit per frame, 64 frames per word
+typedef uint64_t BM_FrameMask;
+#define BM_MASK_BITS 64
+#define MASK_WORD(i) ((i) / BM_MASK_BITS)
+#define MASK_BIT(i) ((BM_FrameMask)1 << ((i) % BM_MASK_BITS))
+
+// Frame metadata is kept as parallel arrays plus packed bitsets, so victim
+// searches only pull the fields they test through the cache
 typedef struct BM_MgmtData {
-	BM_PageFrame *frames;
+	PageNumber *pageNums;
+	char *frameBuffer; // frame i lives at frameBuffer + i * PAGE_SIZE
+	int *fixCounts;
+	int *lastUsed;
+	int *accessCounts;
+	unsigned int *versions; // seqlock: odd while the frame is being loaded or written
+	BM_FrameMask *residentBits;
+	BM_FrameMask *dirtyBits;
+	BM_FrameMask *refBits;
+	BM_FrameMask *pinnedBits;
+	BM_FrameMask *readBits; // frames read optimistically since the last eviction
+	int numMaskWords;
+	int accessClock;        // recency clock behind lastUsed
 	SM_FileHandle *fileHandle;
 	int numReadIO;
 	int numWriteIO;
+	int numOptimisticRetries;
 	int *fifoQueue;
 	int fifoFront;
 	int fifoRear;
 	int clockHand;
+	PageNumber *warmPages;
+	int numWarmPages;
+	int warmPos;
 } BM_MgmtData;
 
+static inline bool testBit(const BM_FrameMask *mask, int frame)
+{
+	return (mask[MASK_WORD(frame)] & MASK_BIT(frame)) != 0;
+}
+
+static inline void setBit(BM_FrameMask *mask, int frame)
+{
+	mask[MASK_WORD(frame)] |= MASK_BIT(frame);
+}
+
+static inline void clearBit(BM_FrameMask *mask, int frame)
+{
+	mask[MASK_WORD(frame)] &= ~MASK_BIT(frame);
+}
+
+// bits of mask word 'word' that correspond to real frames
+static inline BM_FrameMask validFrames(int numPages, int word)
+{
+	int remaining = numPages - word * BM_MASK_BITS;
+	return remaining >= BM_MASK_BITS ? ~(BM_FrameMask)0 : MASK_BIT(remaining) - 1;
+}
+
+static inline char *frameData(BM_MgmtData *mgmtData, int frame)
+{
+	return mgmtData->frameBuffer + (size_t)frame * PAGE_SIZE;
+}
+
 static inline int findFrame(BM_BufferPool *const bm, PageNumber pageNum)
 {
-	BM_MgmtData *mgmtData = (BM_MgmtData *)bm->mgmtData;
-	BM_PageFrame *frames = mgmtData->frames;
+	PageNumber *pageNums = ((BM_MgmtData *)bm->mgmtData)->pageNums;
 	for (int i = 0; i < bm->numPages; i++)
-		if (frames[i].pageNum == pageNum) return i;
+		if (__atomic_load_n(&pageNums[i], __ATOMIC_RELAXED) == pageNum) return i;
 	return -1;
 }
 
 static inline int findFreeFrame(BM_BufferPool *const bm)
 {
 	BM_MgmtData *mgmtData = (BM_MgmtData *)bm->mgmtData;
-	BM_PageFrame *frames = mgmtData->frames;
-	for (int i = 0; i < bm->numPages; i++)
-		if (frames[i].pageNum == NO_PAGE) return i;
+	for (int w = 0; w < mgmtData->numMaskWords; w++)
+	{
+		BM_FrameMask free = ~mgmtData->residentBits[w] & validFrames(bm->numPages, w);
+		if (free) return w * BM_MASK_BITS + __builtin_ctzll(free);
+	}
 	return -1;
 }
 
+static inline void frameWriteBegin(unsigned int *version)
+{
+	if (!(*version & 1))
+		__atomic_store_n(version, *version + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void frameWriteEnd(unsigned int *version)
+{
+	__atomic_store_n(version, (*version | 1) + 1, __ATOMIC_RELEASE);
+}
+
+static void writeBackFrame(BM_MgmtData *mgmtData, int frame)
+{
+	if (!testBit(mgmtData->dirtyBits, frame)) return;
+	writeBlock(mgmtData->pageNums[frame], mgmtData->fileHandle, frameData(mgmtData, frame));
+	clearBit(mgmtData->dirtyBits, frame);
+	mgmtData->numWriteIO++;
+}
+
+static void assignFrame(BM_MgmtData *mgmtData, int frame, PageNumber pageNum, int fixCount, int lastUsed)
+{
+	// optimistic readers look frames up without the pool's lock
+	__atomic_store_n(&mgmtData->pageNums[frame], pageNum, __ATOMIC_RELAXED);
+	mgmtData->fixCounts[frame] = fixCount;
+	mgmtData->lastUsed[frame] = lastUsed;
+	mgmtData->accessCounts[frame] = fixCount;
+	clearBit(mgmtData->dirtyBits, frame);
+	if (pageNum == NO_PAGE) clearBit(mgmtData->residentBits, frame);
+	else setBit(mgmtData->residentBits, frame);
+	if (fixCount > 0)
+	{
+		setBit(mgmtData->pinnedBits, frame);
+		setBit(mgmtData->refBits, frame);
+	}
+	else
+	{
+		clearBit(mgmtData->pinnedBits, frame);
+		clearBit(mgmtData->refBits, frame);
+	}
+}
+
 static int evictFIFO(BM_BufferPool *const bm)
 {
 	BM_MgmtData *mgmtData = (BM_MgmtData *)bm->mgmtData;
@@ -52,15 +143,14 @@ static int evictFIFO(BM_BufferPool *const bm)
 	{
 		int frameIndex = mgmtData->fifoQueue[mgmtData->fifoFront];
 		mgmtData->fifoFront = (mgmtData->fifoFront + 1) % bm->numPages;
-		if (mgmtData->frames[frameIndex].fixCount == 0)
+		if (!testBit(mgmtData->pinnedBits, frameIndex))
 		{
-			if (mgmtData->frames[frameIndex].dirty)
-			{
-				writeBlock(mgmtData->frames[frameIndex].pageNum, mgmtData->fileHandle, mgmtData->frames[frameIndex].data);
-				mgmtData->numWriteIO++;
-			}
+			writeBackFrame(mgmtData, frameIndex);
 			return frameIndex;
 		}
+		// a pinned frame moves to the back of the queue rather than dropping out
+		mgmtData->fifoQueue[mgmtData->fifoRear] = frameIndex;
+		mgmtData->fifoRear = (mgmtData->fifoRear + 1) % bm->numPages;
 	}
 	return -1;
 }
@@ -69,123 +159,269 @@ static int evictLRU(BM_BufferPool *const bm)
 {
 	BM_MgmtData *mgmtData = (BM_MgmtData *)bm->mgmtData;
 	int oldestFrame = -1, oldestTime = INT_MAX;
-	for (int i = 0; i < bm->numPages; i++)
+	for (int w = 0; w < mgmtData->numMaskWords; w++)
 	{
-		if (mgmtData->frames[i].fixCount == 0 && mgmtData->frames[i].pageNum != NO_PAGE)
+		BM_FrameMask candidates = mgmtData->residentBits[w] & ~mgmtData->pinnedBits[w];
+		while (candidates)
 		{
-			if (mgmtData->frames[i].lastUsed < oldestTime)
+			int i = w * BM_MASK_BITS + __builtin_ctzll(candidates);
+			candidates &= candidates - 1;
+			if (mgmtData->lastUsed[i] < oldestTime)
 			{
-				oldestTime = mgmtData->frames[i].lastUsed;
+				oldestTime = mgmtData->lastUsed[i];
 				oldestFrame = i;
 			}
 		}
 	}
-	if (oldestFrame != -1 && mgmtData->frames[oldestFrame].dirty)
-	{
-		writeBlock(mgmtData->frames[oldestFrame].pageNum, mgmtData->fileHandle, mgmtData->frames[oldestFrame].data);
-		mgmtData->numWriteIO++;
-	}
+	if (oldestFrame != -1) writeBackFrame(mgmtData, oldestFrame);
 	return oldestFrame;
 }
 
+// Sweeps one mask word per step: the victim is the first unpinned frame at
+// or after the hand with a clear ref bit, and every unpinned frame passed on
+// the way loses its ref bit, exactly as a frame-by-frame clock would do.
 static int evictCLOCK(BM_BufferPool *const bm)
 {
 	BM_MgmtData *mgmtData = (BM_MgmtData *)bm->mgmtData;
-	for (int attempts = 0; attempts < 2 * bm->numPages; attempts++)
+	int start = mgmtData->clockHand, scanned = 0;
+	while (scanned < 2 * bm->numPages)
 	{
-		int frameIndex = mgmtData->clockHand;
-		if (mgmtData->frames[frameIndex].fixCount == 0)
+		int hand = mgmtData->clockHand;
+		int w = MASK_WORD(hand);
+		BM_FrameMask window = ~(MASK_BIT(hand) - 1) & validFrames(bm->numPages, w);
+		BM_FrameMask unpinned = ~mgmtData->pinnedBits[w] & window;
+		BM_FrameMask victims = unpinned & ~mgmtData->refBits[w];
+		if (victims)
 		{
-			if (!mgmtData->frames[frameIndex].refBit)
-			{
-				if (mgmtData->frames[frameIndex].dirty)
-				{
-					writeBlock(mgmtData->frames[frameIndex].pageNum, mgmtData->fileHandle, mgmtData->frames[frameIndex].data);
-					mgmtData->numWriteIO++;
-				}
-				mgmtData->clockHand = (mgmtData->clockHand + 1) % bm->numPages;
-				return frameIndex;
-			}
-			mgmtData->frames[frameIndex].refBit = false;
+			int frameIndex = w * BM_MASK_BITS + __builtin_ctzll(victims);
+			mgmtData->refBits[w] &= ~(unpinned & (MASK_BIT(frameIndex) - 1));
+			writeBackFrame(mgmtData, frameIndex);
+			mgmtData->clockHand = (frameIndex + 1) % bm->numPages;
+			return frameIndex;
 		}
-		mgmtData->clockHand = (mgmtData->clockHand + 1) % bm->numPages;
+		mgmtData->refBits[w] &= ~unpinned;
+		int next = (w + 1) * BM_MASK_BITS;
+		if (next >= bm->numPages) next = bm->numPages;
+		scanned += next - hand;
+		mgmtData->clockHand = next % bm->numPages;
 	}
+	mgmtData->clockHand = start;
 	return -1;
 }
 
-RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName, const int numPages, ReplacementStrategy strategy, void *stratData)
+static void getWarmFileName(char *dest, size_t size, const char *pageFileName)
 {
-	if (!bm || numPages <= 0)
-		THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid buffer pool parameters");
-	BM_MgmtData *mgmtData = (BM_MgmtData *)malloc(sizeof(BM_MgmtData));
-	if (!mgmtData) THROW(RC_WRITE_FAILED, "Memory allocation failed");
-	mgmtData->frames = (BM_PageFrame *)malloc(numPages * sizeof(BM_PageFrame));
-	if (!mgmtData->frames) { free(mgmtData); THROW(RC_WRITE_FAILED, "Memory allocation failed"); }
-	for (int i = 0; i < numPages; i++)
+	snprintf(dest, size, "%s.warm", pageFileName);
+}
+
+static int comparePageNumbers(const void *a, const void *b)
+{
+	PageNumber l = *(const PageNumber *)a, r = *(const PageNumber *)b;
+	return (l > r) - (l < r);
+}
+
+static RC saveWorkingSet(BM_BufferPool *const bm)
+{
+	BM_MgmtData *mgmtData = (BM_MgmtData *)bm->mgmtData;
+	char fileName[WARM_FILE_NAME_SIZE(bm->pageFile)];
+	int count = 0;
+	PageNumber *pages = (PageNumber *)malloc(bm->numPages * sizeof(PageNumber));
+	if (!pages) THROW(RC_WRITE_FAILED, "Memory allocation failed");
+	for (int i = 0; i < bm->numPages; i++)
+		if (mgmtData->pageNums[i] != NO_PAGE) pages[count++] = mgmtData->pageNums[i];
+	qsort(pages, count, sizeof(PageNumber), comparePageNumbers);
+	getWarmFileName(fileName, sizeof(fileName), bm->pageFile);
+	FILE *file = fopen(fileName, "wb");
+	bool ok = file && fwrite(&count, sizeof(int), 1, file) == 1
+			&& fwrite(pages, sizeof(PageNumber), count, file) == (size_t)count;
+	if (file) fclose(file);
+	free(pages);
+	if (!ok) THROW(RC_WRITE_FAILED, "Cannot write working set file");
+	return RC_OK;
+}
+
+static void loadWorkingSet(BM_MgmtData *mgmtData, const char *pageFileName)
+{
+	char fileName[WARM_FILE_NAME_SIZE(pageFileName)];
+	int count;
+	mgmtData->warmPages = NULL;
+	mgmtData->numWarmPages = 0;
+	mgmtData->warmPos = 0;
+	getWarmFileName(fileName, sizeof(fileName), pageFileName);
+	FILE *file = fopen(fileName, "rb");
+	if (!file) return;
+	if (fread(&count, sizeof(int), 1, file) != 1 || count <= 0 || count > mgmtData->fileHandle->totalNumPages)
+	{
+		fclose(file);
+		return;
+	}
+	PageNumber *pages = (PageNumber *)malloc(count * sizeof(PageNumber));
+	if (!pages || fread(pages, sizeof(PageNumber), count, file) != (size_t)count)
+	{
+		free(pages);
+		fclose(file);
+		return;
+	}
+	fclose(file);
+	int kept = 0;
+	for (int i = 0; i < count; i++)
+		if (pages[i] >= 0 && pages[i] < mgmtData->fileHandle->totalNumPages) pages[kept++] = pages[i];
+	if (kept == 0) { free(pages); return; }
+	mgmtData->warmPages = pages;
+	mgmtData->numWarmPages = kept;
+}
+
+// Optimistic readers only leave a hint in readBits; the next eviction turns
+// it into the recency a pin would have given the frame
+static void applyReadHints(BM_MgmtData *mgmtData)
+{
+	for (int w = 0; w < mgmtData->numMaskWords; w++)
 	{
-		mgmtData->frames[i].pageNum = NO_PAGE;
-		mgmtData->frames[i].data = (char *)malloc(PAGE_SIZE);
-		if (!mgmtData->frames[i].data)
+		if (!__atomic_load_n(&mgmtData->readBits[w], __ATOMIC_RELAXED)) continue;
+		BM_FrameMask read = __atomic_exchange_n(&mgmtData->readBits[w], 0, __ATOMIC_RELAXED);
+		mgmtData->refBits[w] |= read & mgmtData->residentBits[w];
+		while (read)
 		{
-			for (int j = 0; j < i; j++) free(mgmtData->frames[j].data);
-			free(mgmtData->frames);
-			free(mgmtData);
-			THROW(RC_WRITE_FAILED, "Memory allocation failed");
+			int i = w * BM_MASK_BITS + __builtin_ctzll(read);
+			read &= read - 1;
+			mgmtData->lastUsed[i] = ++mgmtData->accessClock;
 		}
-		mgmtData->frames[i].dirty = false;
-		mgmtData->frames[i].fixCount = 0;
-		mgmtData->frames[i].lastUsed = 0;
-		mgmtData->frames[i].accessCount = 0;
-		mgmtData->frames[i].refBit = false;
 	}
+}
+
+static int evictFrame(BM_BufferPool *const bm)
+{
+	applyReadHints((BM_MgmtData *)bm->mgmtData);
+	switch (bm->strategy)
+	{
+	case RS_FIFO: return evictFIFO(bm);
+	case RS_LRU: return evictLRU(bm);
+	case RS_CLOCK: return evictCLOCK(bm);
+	case RS_LFU:
+	case RS_LRU_K: return evictLRU(bm);
+	default: return evictFIFO(bm);
+	}
+}
+
+// Reads pageNum into an unpinned frame, taking a free frame or, if
+// allowEvict is set, an unpinned victim. Returns the frame or -1.
+static int loadUnpinned(BM_BufferPool *const bm, PageNumber pageNum, bool allowEvict, int lastUsed)
+{
+	BM_MgmtData *mgmtData = (BM_MgmtData *)bm->mgmtData;
+	int frameIndex = findFreeFrame(bm);
+	if (frameIndex == -1 && allowEvict) frameIndex = evictFrame(bm);
+	if (frameIndex == -1) return -1;
+	frameWriteBegin(&mgmtData->versions[frameIndex]);
+	if (readBlock(pageNum, mgmtData->fileHandle, frameData(mgmtData, frameIndex)) != RC_OK)
+	{
+		assignFrame(mgmtData, frameIndex, NO_PAGE, 0, 0);
+		frameWriteEnd(&mgmtData->versions[frameIndex]);
+		return -1;
+	}
+	mgmtData->numReadIO++;
+	assignFrame(mgmtData, frameIndex, pageNum, 0, lastUsed);
+	frameWriteEnd(&mgmtData->versions[frameIndex]);
+	if (bm->strategy == RS_FIFO && mgmtData->fifoQueue)
+	{
+		mgmtData->fifoQueue[mgmtData->fifoRear] = frameIndex;
+		mgmtData->fifoRear = (mgmtData->fifoRear + 1) % bm->numPages;
+	}
+	return frameIndex;
+}
+
+static void prefetchWorkingSet(BM_BufferPool *const bm, int maxPages)
+{
+	BM_MgmtData *mgmtData = (BM_MgmtData *)bm->mgmtData;
+	while (maxPages > 0 && mgmtData->warmPos < mgmtData->numWarmPages)
+	{
+		PageNumber pageNum = mgmtData->warmPages[mgmtData->warmPos++];
+		if (findFrame(bm, pageNum) != -1) continue;
+		if (findFreeFrame(bm) == -1)
+		{
+			mgmtData->warmPos = mgmtData->numWarmPages;
+			break;
+		}
+		if (loadUnpinned(bm, pageNum, false, 0) != -1) maxPages--;
+	}
+	if (mgmtData->warmPos >= mgmtData->numWarmPages && mgmtData->warmPages)
+	{
+		free(mgmtData->warmPages);
+		mgmtData->warmPages = NULL;
+		mgmtData->numWarmPages = 0;
+	}
+}
+
+static void freeMgmtData(BM_MgmtData *mgmtData)
+{
+	free(mgmtData->pageNums);
+	free(mgmtData->frameBuffer);
+	free(mgmtData->fixCounts);
+	free(mgmtData->lastUsed);
+	free(mgmtData->accessCounts);
+	free(mgmtData->versions);
+	free(mgmtData->residentBits);
+	free(mgmtData->dirtyBits);
+	free(mgmtData->refBits);
+	free(mgmtData->pinnedBits);
+	free(mgmtData->readBits);
+	free(mgmtData->fileHandle);
+	free(mgmtData->fifoQueue);
+	free(mgmtData->warmPages);
+	free(mgmtData);
+}
+
+RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName, const int numPages, ReplacementStrategy strategy, void *stratData)
+{
+	if (!bm || numPages <= 0)
+		THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid buffer pool parameters");
+	BM_MgmtData *mgmtData = (BM_MgmtData *)calloc(1, sizeof(BM_MgmtData));
+	if (!mgmtData) THROW(RC_WRITE_FAILED, "Memory allocation failed");
+	int numWords = (numPages + BM_MASK_BITS - 1) / BM_MASK_BITS;
+	mgmtData->numMaskWords = numWords;
+	mgmtData->pageNums = (PageNumber *)malloc(numPages * sizeof(PageNumber));
+	mgmtData->frameBuffer = (char *)malloc((size_t)numPages * PAGE_SIZE);
+	mgmtData->fixCounts = (int *)calloc(numPages, sizeof(int));
+	mgmtData->lastUsed = (int *)calloc(numPages, sizeof(int));
+	mgmtData->accessCounts = (int *)calloc(numPages, sizeof(int));
+	mgmtData->versions = (unsigned int *)calloc(numPages, sizeof(unsigned int));
+	mgmtData->residentBits = (BM_FrameMask *)calloc(numWords, sizeof(BM_FrameMask));
+	mgmtData->dirtyBits = (BM_FrameMask *)calloc(numWords, sizeof(BM_FrameMask));
+	mgmtData->refBits = (BM_FrameMask *)calloc(numWords, sizeof(BM_FrameMask));
+	mgmtData->pinnedBits = (BM_FrameMask *)calloc(numWords, sizeof(BM_FrameMask));
+	mgmtData->readBits = (BM_FrameMask *)calloc(numWords, sizeof(BM_FrameMask));
 	mgmtData->fileHandle = (SM_FileHandle *)malloc(sizeof(SM_FileHandle));
-	if (!mgmtData->fileHandle)
+	if (strategy == RS_FIFO)
+		mgmtData->fifoQueue = (int *)malloc(numPages * sizeof(int));
+	bm->pageFile = (char *)malloc(strlen(pageFileName) + 1);
+	if (!mgmtData->pageNums || !mgmtData->frameBuffer || !mgmtData->fixCounts || !mgmtData->lastUsed
+			|| !mgmtData->accessCounts || !mgmtData->versions || !mgmtData->residentBits || !mgmtData->dirtyBits
+			|| !mgmtData->refBits || !mgmtData->pinnedBits || !mgmtData->readBits || !mgmtData->fileHandle
+			|| (strategy == RS_FIFO && !mgmtData->fifoQueue) || !bm->pageFile)
 	{
-		for (int i = 0; i < numPages; i++) free(mgmtData->frames[i].data);
-		free(mgmtData->frames);
-		free(mgmtData);
+		free(bm->pageFile);
+		bm->pageFile = NULL;
+		freeMgmtData(mgmtData);
 		THROW(RC_WRITE_FAILED, "Memory allocation failed");
 	}
-	RC rc = openPageFile(pageFileName, mgmtData->fileHandle);
+	RC rc = openPageFile((char *)pageFileName, mgmtData->fileHandle);
 	if (rc != RC_OK)
 	{
-		for (int i = 0; i < numPages; i++) free(mgmtData->frames[i].data);
-		free(mgmtData->frames);
-		free(mgmtData->fileHandle);
-		free(mgmtData);
+		free(bm->pageFile);
+		bm->pageFile = NULL;
+		freeMgmtData(mgmtData);
 		return rc;
 	}
-	mgmtData->numReadIO = 0;
-	mgmtData->numWriteIO = 0;
-	if (strategy == RS_FIFO)
+	for (int i = 0; i < numPages; i++) mgmtData->pageNums[i] = NO_PAGE;
+	if (mgmtData->fifoQueue)
 	{
-		mgmtData->fifoQueue = (int *)malloc(numPages * sizeof(int));
-		if (!mgmtData->fifoQueue)
-		{
-			closePageFile(mgmtData->fileHandle);
-			for (int i = 0; i < numPages; i++) free(mgmtData->frames[i].data);
-			free(mgmtData->frames);
-			free(mgmtData->fileHandle);
-			free(mgmtData);
-			THROW(RC_WRITE_FAILED, "Memory allocation failed");
-		}
 		for (int i = 0; i < numPages; i++) mgmtData->fifoQueue[i] = i;
 		mgmtData->fifoFront = 0;
 		mgmtData->fifoRear = 0;
 	}
-	else mgmtData->fifoQueue = NULL;
+	mgmtData->numReadIO = 0;
+	mgmtData->numWriteIO = 0;
 	mgmtData->clockHand = 0;
-	bm->pageFile = (char *)malloc(strlen(pageFileName) + 1);
-	if (!bm->pageFile)
-	{
-		if (mgmtData->fifoQueue) free(mgmtData->fifoQueue);
-		closePageFile(mgmtData->fileHandle);
-		for (int i = 0; i < numPages; i++) free(mgmtData->frames[i].data);
-		free(mgmtData->frames);
-		free(mgmtData->fileHandle);
-		free(mgmtData);
-		THROW(RC_WRITE_FAILED, "Memory allocation failed");
-	}
+	loadWorkingSet(mgmtData, pageFileName);
 	strcpy(bm->pageFile, pageFileName);
 	bm->numPages = numPages;
 	bm->strategy = strategy;
@@ -198,20 +434,10 @@ RC shutdownBufferPool(BM_BufferPool *const bm)
 	if (!bm || !bm->mgmtData)
 		THROW(RC_FILE_HANDLE_NOT_INIT, "Buffer pool is not initialized");
 	BM_MgmtData *mgmtData = (BM_MgmtData *)bm->mgmtData;
-	forceFlushPool(bm);
+	checkpointPool(bm);
 	if (mgmtData->fileHandle)
-	{
 		closePageFile(mgmtData->fileHandle);
-		free(mgmtData->fileHandle);
-	}
-	if (mgmtData->frames)
-	{
-		for (int i = 0; i < bm->numPages; i++)
-			if (mgmtData->frames[i].data) free(mgmtData->frames[i].data);
-		free(mgmtData->frames);
-	}
-	if (mgmtData->fifoQueue) free(mgmtData->fifoQueue);
-	free(mgmtData);
+	freeMgmtData(mgmtData);
 	bm->mgmtData = NULL;
 	if (bm->pageFile) { free(bm->pageFile); bm->pageFile = NULL; }
 	return RC_OK;
@@ -222,65 +448,70 @@ RC forceFlushPool(BM_BufferPool *const bm)
 	if (!bm || !bm->mgmtData)
 		THROW(RC_FILE_HANDLE_NOT_INIT, "Buffer pool is not initialized");
 	BM_MgmtData *mgmtData = (BM_MgmtData *)bm->mgmtData;
-	for (int i = 0; i < bm->numPages; i++)
+	for (int w = 0; w < mgmtData->numMaskWords; w++)
 	{
-		if (mgmtData->frames[i].dirty && mgmtData->frames[i].pageNum != NO_PAGE)
+		BM_FrameMask dirty = mgmtData->dirtyBits[w] & mgmtData->residentBits[w];
+		while (dirty)
 		{
-			writeBlock(mgmtData->frames[i].pageNum, mgmtData->fileHandle, mgmtData->frames[i].data);
-			mgmtData->frames[i].dirty = false;
-			mgmtData->numWriteIO++;
+			int i = w * BM_MASK_BITS + __builtin_ctzll(dirty);
+			dirty &= dirty - 1;
+			writeBackFrame(mgmtData, i);
 		}
 	}
 	return RC_OK;
 }
 
+RC checkpointPool(BM_BufferPool *const bm)
+{
+	RC rc = forceFlushPool(bm);
+	if (rc != RC_OK) return rc;
+	return saveWorkingSet(bm);
+}
+
 RC pinPage(BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber pageNum)
 {
 	if (!bm || !bm->mgmtData || !page)
 		THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
 	BM_MgmtData *mgmtData = (BM_MgmtData *)bm->mgmtData;
-	static int accessCounter = 0;
 	int frameIndex = findFrame(bm, pageNum);
 	if (frameIndex != -1)
 	{
-		mgmtData->frames[frameIndex].fixCount++;
-		mgmtData->frames[frameIndex].lastUsed = ++accessCounter;
-		mgmtData->frames[frameIndex].accessCount++;
-		mgmtData->frames[frameIndex].refBit = true;
+		mgmtData->fixCounts[frameIndex]++;
+		mgmtData->lastUsed[frameIndex] = ++mgmtData->accessClock;
+		mgmtData->accessCounts[frameIndex]++;
+		setBit(mgmtData->pinnedBits, frameIndex);
+		setBit(mgmtData->refBits, frameIndex);
 		page->pageNum = pageNum;
-		page->data = mgmtData->frames[frameIndex].data;
+		page->data = frameData(mgmtData, frameIndex);
+		if (mgmtData->warmPages) prefetchWorkingSet(bm, BM_WARM_PREFETCH_BATCH);
 		return RC_OK;
 	}
 	frameIndex = findFreeFrame(bm);
 	if (frameIndex == -1)
 	{
-		switch (bm->strategy)
-		{
-		case RS_FIFO: frameIndex = evictFIFO(bm); break;
-		case RS_LRU: frameIndex = evictLRU(bm); break;
-		case RS_CLOCK: frameIndex = evictCLOCK(bm); break;
-		case RS_LFU:
-		case RS_LRU_K: frameIndex = evictLRU(bm); break;
-		default: frameIndex = evictFIFO(bm); break;
-		}
+		frameIndex = evictFrame(bm);
 		if (frameIndex == -1)
 			THROW(RC_WRITE_FAILED, "Cannot evict page - all frames are pinned");
 	}
-	readBlock(pageNum, mgmtData->fileHandle, mgmtData->frames[frameIndex].data);
+	frameWriteBegin(&mgmtData->versions[frameIndex]);
+	RC rc = readBlock(pageNum, mgmtData->fileHandle, frameData(mgmtData, frameIndex));
+	if (rc != RC_OK)
+	{
+		assignFrame(mgmtData, frameIndex, NO_PAGE, 0, 0);
+		frameWriteEnd(&mgmtData->versions[frameIndex]);
+		return rc;
+	}
 	mgmtData->numReadIO++;
-	mgmtData->frames[frameIndex].pageNum = pageNum;
-	mgmtData->frames[frameIndex].dirty = false;
-	mgmtData->frames[frameIndex].fixCount = 1;
-	mgmtData->frames[frameIndex].lastUsed = ++accessCounter;
-	mgmtData->frames[frameIndex].accessCount = 1;
-	mgmtData->frames[frameIndex].refBit = true;
+	assignFrame(mgmtData, frameIndex, pageNum, 1, ++mgmtData->accessClock);
+	frameWriteEnd(&mgmtData->versions[frameIndex]);
 	if (bm->strategy == RS_FIFO && mgmtData->fifoQueue)
 	{
 		mgmtData->fifoQueue[mgmtData->fifoRear] = frameIndex;
 		mgmtData->fifoRear = (mgmtData->fifoRear + 1) % bm->numPages;
 	}
 	page->pageNum = pageNum;
-	page->data = mgmtData->frames[frameIndex].data;
+	page->data = frameData(mgmtData, frameIndex);
+	if (mgmtData->warmPages) prefetchWorkingSet(bm, BM_WARM_PREFETCH_BATCH);
 	return RC_OK;
 }
 
@@ -292,9 +523,10 @@ RC unpinPage(BM_BufferPool *const bm, BM_PageHandle *const page)
 	int frameIndex = findFrame(bm, page->pageNum);
 	if (frameIndex == -1)
 		THROW(RC_FILE_HANDLE_NOT_INIT, "Page not found in buffer");
-	if (mgmtData->frames[frameIndex].fixCount <= 0)
+	if (mgmtData->fixCounts[frameIndex] <= 0)
 		THROW(RC_FILE_HANDLE_NOT_INIT, "Page fix count is already zero");
-	mgmtData->frames[frameIndex].fixCount--;
+	if (--mgmtData->fixCounts[frameIndex] == 0)
+		clearBit(mgmtData->pinnedBits, frameIndex);
 	return RC_OK;
 }
 
@@ -306,10 +538,86 @@ RC markDirty(BM_BufferPool *const bm, BM_PageHandle *const page)
 	int frameIndex = findFrame(bm, page->pageNum);
 	if (frameIndex == -1)
 		THROW(RC_FILE_HANDLE_NOT_INIT, "Page not found in buffer");
-	mgmtData->frames[frameIndex].dirty = true;
+	setBit(mgmtData->dirtyBits, frameIndex);
+	frameWriteEnd(&mgmtData->versions[frameIndex]);
 	return RC_OK;
 }
 
+RC beginPageWrite(BM_BufferPool *const bm, BM_PageHandle *const page)
+{
+	if (!bm || !bm->mgmtData || !page)
+		THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	BM_MgmtData *mgmtData = (BM_MgmtData *)bm->mgmtData;
+	int frameIndex = findFrame(bm, page->pageNum);
+	if (frameIndex == -1)
+		THROW(RC_FILE_HANDLE_NOT_INIT, "Page not found in buffer");
+	frameWriteBegin(&mgmtData->versions[frameIndex]);
+	return RC_OK;
+}
+
+RC readPageIfResident(BM_BufferPool *const bm, const PageNumber pageNum, const int offset, const int length, char *dest)
+{
+	if (!bm || !bm->mgmtData || !dest || offset < 0 || length < 0 || offset + length > PAGE_SIZE)
+		THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	BM_MgmtData *mgmtData = (BM_MgmtData *)bm->mgmtData;
+	for (int attempt = 0; attempt < BM_OPTIMISTIC_RETRIES; attempt++)
+	{
+		int frameIndex = findFrame(bm, pageNum);
+		if (frameIndex == -1) break;
+		unsigned int before = __atomic_load_n(&mgmtData->versions[frameIndex], __ATOMIC_ACQUIRE);
+		if (!(before & 1))
+		{
+			memcpy(dest, frameData(mgmtData, frameIndex) + offset, length);
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if (__atomic_load_n(&mgmtData->pageNums[frameIndex], __ATOMIC_RELAXED) == pageNum
+					&& __atomic_load_n(&mgmtData->versions[frameIndex], __ATOMIC_RELAXED) == before)
+			{
+				// leave a recency hint, written only if it is not already set
+				BM_FrameMask *hint = &mgmtData->readBits[MASK_WORD(frameIndex)];
+				if (!(__atomic_load_n(hint, __ATOMIC_RELAXED) & MASK_BIT(frameIndex)))
+					__atomic_fetch_or(hint, MASK_BIT(frameIndex), __ATOMIC_RELAXED);
+				return RC_OK;
+			}
+		}
+		__atomic_fetch_add(&mgmtData->numOptimisticRetries, 1, __ATOMIC_RELAXED);
+	}
+	return RC_PAGE_NOT_RESIDENT;
+}
+
+RC readPageOptimistic(BM_BufferPool *const bm, const PageNumber pageNum, const int offset, const int length, char *dest)
+{
+	RC rc = readPageIfResident(bm, pageNum, offset, length, dest);
+	if (rc != RC_PAGE_NOT_RESIDENT) return rc;
+	BM_PageHandle page;
+	rc = pinPage(bm, &page, pageNum);
+	if (rc != RC_OK) return rc;
+	memcpy(dest, page.data + offset, length);
+	unpinPage(bm, &page);
+	return RC_OK;
+}
+
+RC prefetchPages(BM_BufferPool *const bm, const PageNumber startPage, const int numPages)
+{
+	if (!bm || !bm->mgmtData || startPage < 0 || numPages < 0)
+		THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	BM_MgmtData *mgmtData = (BM_MgmtData *)bm->mgmtData;
+	int endPage = startPage + (numPages < bm->numPages ? numPages : bm->numPages - 1);
+	if (endPage > mgmtData->fileHandle->totalNumPages) endPage = mgmtData->fileHandle->totalNumPages;
+	for (PageNumber pageNum = startPage; pageNum < endPage; pageNum++)
+	{
+		if (findFrame(bm, pageNum) != -1) continue;
+		if (loadUnpinned(bm, pageNum, true, ++mgmtData->accessClock) == -1) break;
+	}
+	return RC_OK;
+}
+
+RC ensurePoolCapacity(BM_BufferPool *const bm, const int numPages)
+{
+	if (!bm || !bm->mgmtData || numPages < 0)
+		THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	return ensureCapacity(numPages, ((BM_MgmtData *)bm->mgmtData)->fileHandle);
+}
+
 RC forcePage(BM_BufferPool *const bm, BM_PageHandle *const page)
 {
 	if (!bm || !bm->mgmtData || !page)
@@ -318,8 +626,8 @@ RC forcePage(BM_BufferPool *const bm, BM_PageHandle *const page)
 	int frameIndex = findFrame(bm, page->pageNum);
 	if (frameIndex == -1)
 		THROW(RC_FILE_HANDLE_NOT_INIT, "Page not found in buffer");
-	writeBlock(page->pageNum, mgmtData->fileHandle, mgmtData->frames[frameIndex].data);
-	mgmtData->frames[frameIndex].dirty = false;
+	writeBlock(page->pageNum, mgmtData->fileHandle, frameData(mgmtData, frameIndex));
+	clearBit(mgmtData->dirtyBits, frameIndex);
 	mgmtData->numWriteIO++;
 	return RC_OK;
 }
@@ -330,8 +638,7 @@ PageNumber *getFrameContents(BM_BufferPool *const bm)
 	BM_MgmtData *mgmtData = (BM_MgmtData *)bm->mgmtData;
 	PageNumber *contents = (PageNumber *)malloc(bm->numPages * sizeof(PageNumber));
 	if (!contents) return NULL;
-	for (int i = 0; i < bm->numPages; i++)
-		contents[i] = mgmtData->frames[i].pageNum;
+	memcpy(contents, mgmtData->pageNums, bm->numPages * sizeof(PageNumber));
 	return contents;
 }
 
@@ -342,7 +649,7 @@ bool *getDirtyFlags(BM_BufferPool *const bm)
 	bool *flags = (bool *)malloc(bm->numPages * sizeof(bool));
 	if (!flags) return NULL;
 	for (int i = 0; i < bm->numPages; i++)
-		flags[i] = mgmtData->frames[i].dirty;
+		flags[i] = testBit(mgmtData->dirtyBits, i);
 	return flags;
 }
 
@@ -352,8 +659,7 @@ int *getFixCounts(BM_BufferPool *const bm)
 	BM_MgmtData *mgmtData = (BM_MgmtData *)bm->mgmtData;
 	int *counts = (int *)malloc(bm->numPages * sizeof(int));
 	if (!counts) return NULL;
-	for (int i = 0; i < bm->numPages; i++)
-		counts[i] = mgmtData->frames[i].fixCount;
+	memcpy(counts, mgmtData->fixCounts, bm->numPages * sizeof(int));
 	return counts;
 }
 
@@ -368,3 +674,17 @@ int getNumWriteIO(BM_BufferPool *const bm)
 	if (!bm || !bm->mgmtData) return -1;
 	return ((BM_MgmtData *)bm->mgmtData)->numWriteIO;
 }
+
+int getNumOptimisticRetries(BM_BufferPool *const bm)
+{
+	if (!bm || !bm->mgmtData) return -1;
+	return __atomic_load_n(&((BM_MgmtData *)bm->mgmtData)->numOptimisticRetries, __ATOMIC_RELAXED);
+}
+
+RC discardWorkingSet(const char *const pageFileName)
+{
+	char fileName[WARM_FILE_NAME_SIZE(pageFileName)];
+	getWarmFileName(fileName, sizeof(fileName), pageFileName);
+	remove(fileName);
+	return RC_OK;
+}
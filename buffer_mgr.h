@@ -46,6 +46,8 @@ RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName,
 		void *stratData);
 RC shutdownBufferPool(BM_BufferPool *const bm);
 RC forceFlushPool(BM_BufferPool *const bm);
+// forceFlushPool plus a snapshot of the resident pages for warm restart
+RC checkpointPool(BM_BufferPool *const bm);
 
 // Buffer Manager Interface Access Pages
 RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page);
@@ -53,6 +55,29 @@ RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, 
 		const PageNumber pageNum);
+// pinPage only reads pages that exist; code that allocates pages grows the
+// page file to at least numPages pages first
+RC ensurePoolCapacity (BM_BufferPool *const bm, const int numPages);
+
+// Optimistic (pin-free) access: readers copy a byte range out of a resident
+// frame and validate its version, retrying if the frame was loaded, evicted
+// or written meanwhile; non-resident pages fall back to pin/copy/unpin.
+// Writers bracket in-place changes with beginPageWrite ... markDirty. A
+// successful optimistic read writes nothing shared except, the first time a
+// frame is read since the last eviction, one bit in a 64-frame hint word; the
+// next eviction turns the hint into LRU recency and a CLOCK reference bit.
+// Optimistic reads do not count towards a frame's fix or access counts.
+RC beginPageWrite (BM_BufferPool *const bm, BM_PageHandle *const page);
+RC readPageOptimistic (BM_BufferPool *const bm, const PageNumber pageNum,
+		const int offset, const int length, char *dest);
+// The optimistic copy alone: RC_PAGE_NOT_RESIDENT instead of pinning, so
+// callers that serialize pins can take their lock only on a miss
+RC readPageIfResident (BM_BufferPool *const bm, const PageNumber pageNum,
+		const int offset, const int length, char *dest);
+
+// Read-ahead: load up to numPages existing pages starting at startPage into
+// unpinned frames, evicting unpinned victims if needed
+RC prefetchPages (BM_BufferPool *const bm, const PageNumber startPage, const int numPages);
 
 // Statistics Interface
 PageNumber *getFrameContents (BM_BufferPool *const bm);
@@ -60,5 +85,16 @@ bool *getDirtyFlags (BM_BufferPool *const bm);
 int *getFixCounts (BM_BufferPool *const bm);
 int getNumReadIO (BM_BufferPool *const bm);
 int getNumWriteIO (BM_BufferPool *const bm);
+// optimistic reads that found their frame mid-write or changed underneath
+int getNumOptimisticRetries (BM_BufferPool *const bm);
+
+// Warm restart: the resident page list is saved to <pageFile>.warm by
+// shutdownBufferPool and checkpointPool, and prefetched into free frames
+// after the next initBufferPool; pages past the end of the file are dropped.
+// The pool never snapshots on its own, so after a crash the snapshot is the
+// one from the last checkpoint: callers that want a recent one run
+// checkpointPool periodically (the record manager does so every
+// RM_CHECKPOINT_WRITES writes to a table).
+RC discardWorkingSet (const char *const pageFileName);
 
 #endif
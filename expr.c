@@ -1,11 +1,130 @@
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "dberror.h"
 #include "record_mgr.h"
 #include "expr.h"
 #include "tables.h"
 
+// Opcodes of a compiled predicate. The comparisons come in pairs per data
+// type, in DataType order, and push their result; the rest work on the
+// results already pushed.
+typedef enum PredOp {
+	PRED_INT_EQUAL,
+	PRED_INT_SMALLER,
+	PRED_STRING_EQUAL,
+	PRED_STRING_SMALLER,
+	PRED_FLOAT_EQUAL,
+	PRED_FLOAT_SMALLER,
+	PRED_BOOL_EQUAL,
+	PRED_BOOL_SMALLER,
+	PRED_LOAD_BOOL,      // pushes a bool attribute or constant
+	PRED_EQUAL,          // compares the top two results
+	PRED_SMALLER,
+	PRED_NOT,
+	PRED_CHAIN           // a flattened run of ANDs or ORs, see PredChain
+} PredOp;
+
+// An attribute (cons NULL) or a constant operand of a comparison. A batch
+// binds each attribute to base and stride before it runs, so rows may be
+// stored one after another or column by column.
+typedef struct PredOperand {
+	const char *cons;    // the constant's bytes: &v, or str for strings
+	int attr;            // attribute number
+	int offset;          // attribute offset within the record
+	int width;           // bytes a string operand may span
+	const char *base;    // the attribute in the first row of the batch
+	int stride;          // bytes from one row's attribute to the next
+	union {
+		int intV;
+		float floatV;
+		bool boolV;
+	} v;
+	char *str;
+} PredOperand;
+
+typedef struct PredInstr {
+	PredOp op;
+	PredOperand args[2];
+	int chain;           // PRED_CHAIN: index into Predicate.chains
+	int next;            // PRED_CHAIN: first instruction after its terms
+} PredInstr;
+
+// One operand of a chain: the code in [start, end) pushes its result
+typedef struct PredTerm {
+	int start;
+	int end;
+	double cost;         // estimated work per row
+	double prior;        // estimated share of rows that pass
+	double evals;        // rows evaluated and passed, halved on every reorder
+	double passes;
+} PredTerm;
+
+// Terms of an AND (or OR) chain run in order until one fails (passes).
+// Every PRED_REORDER_ROWS rows the terms are sorted again by their cost per
+// row they decide, using the observed pass rates.
+typedef struct PredChain {
+	bool isAnd;
+	int numTerms;
+	PredTerm *terms;
+	long rows;           // rows evaluated since the last reorder
+} PredChain;
+
+#define PRED_REORDER_ROWS 1024
+// weight of the prior pass rate, in rows
+#define PRED_PRIOR_ROWS 16
+
+// Batches are evaluated PRED_CHUNK_ROWS rows (a multiple of 64) at a time,
+// comparing PRED_LANES numbers per instruction
+#define PRED_CHUNK_ROWS 256
+#define PRED_CHUNK_WORDS (PRED_CHUNK_ROWS / 64)
+#if defined(__AVX2__)
+#define PRED_LANES 8
+#elif defined(__SSE2__)
+#define PRED_LANES 4
+#else
+#define PRED_LANES 1
+#endif
+
+struct Predicate {
+	PredInstr *code;
+	int length;
+	PredChain *chains;
+	int numChains;
+	int depth;           // results pushed at most at once
+	int pushed;          // results on the stack while compiling
+};
+
+static int countNodes(Expr *expr);
+static int attrPosition(Schema *schema, int attrNum);
+static RC compileOperand(Expr *expr, Schema *schema, PredOperand *operand, DataType *type);
+static RC compileNode(Predicate *pred, Expr *expr, Schema *schema);
+static RC compileChain(Predicate *pred, Expr *expr, Schema *schema);
+static void collectTerms(Expr *expr, OpType type, Expr **terms, int *numTerms);
+static double estimateCost(Predicate *pred, int start, int end);
+static double estimatePass(Expr *expr);
+static void orderTerms(PredChain *chain);
+static bool evalRange(Predicate *pred, int from, int to, const char *data);
+static bool evalChain(Predicate *pred, PredChain *chain, const char *data);
+static void evalBatch(Predicate *pred, const char *rows, int recordSize, const char *const *columns, const int *widths, int numRows, uint64_t *selection);
+static void bindOperands(Predicate *pred, const char *rows, int recordSize, const char *const *columns, const int *widths, int first);
+static void evalRangeBatch(Predicate *pred, int from, int to, int n, const uint64_t *active, uint64_t *out);
+static void evalChainBatch(Predicate *pred, PredChain *chain, int n, const uint64_t *active, uint64_t *out);
+static PredInstr *emit(Predicate *pred, PredOp op, int popped);
+static int compareStrings(const char *left, int leftWidth, const char *right, int rightWidth);
+static bool evalCompare(PredInstr *in, const char *data);
+static bool compareValues(PredInstr *in, const char *l, const char *r);
+static void gatherOperand(PredOperand *operand, int n, int *out);
+static void compareColumns(PredInstr *in, int n, uint64_t *bits);
+static int compareLane(PredOp op, int li, int ri, float lf, float rf);
+static int compareLanes(PredOp op, const int *l, const int *r);
+
 // implementations
 RC 
 valueEquals (Value *left, Value *right, Value *result)
@@ -74,6 +193,7 @@ boolAnd (Value *left, Value *right, Value *result)
 {
 	if (left->dt != DT_BOOL || right->dt != DT_BOOL)
 		THROW(RC_RM_BOOLEAN_EXPR_ARG_IS_NOT_BOOLEAN, "boolean AND requires boolean inputs");
+	result->dt = DT_BOOL;
 	result->v.boolV = (left->v.boolV && right->v.boolV);
 
 	return RC_OK;
@@ -84,6 +204,7 @@ boolOr (Value *left, Value *right, Value *result)
 {
 	if (left->dt != DT_BOOL || right->dt != DT_BOOL)
 		THROW(RC_RM_BOOLEAN_EXPR_ARG_IS_NOT_BOOLEAN, "boolean OR requires boolean inputs");
+	result->dt = DT_BOOL;
 	result->v.boolV = (left->v.boolV || right->v.boolV);
 
 	return RC_OK;
@@ -106,6 +227,15 @@ evalExpr (Record *record, Schema *schema, Expr *expr, Value **result)
 		//    rIn = (Value *) malloc(sizeof(Value));
 
 		CHECK(evalExpr(record, schema, op->args[0], &lIn));
+		// AND and OR skip their right side once the left one decides them
+		if ((op->type == OP_BOOL_AND || op->type == OP_BOOL_OR) && lIn->dt == DT_BOOL
+				&& (op->type == OP_BOOL_AND) != (lIn->v.boolV != 0))
+		{
+			(*result)->dt = DT_BOOL;
+			(*result)->v.boolV = lIn->v.boolV != 0;
+			freeVal(lIn);
+			break;
+		}
 		if (twoArgs)
 			CHECK(evalExpr(record, schema, op->args[1], &rIn));
 
@@ -140,8 +270,32 @@ evalExpr (Record *record, Schema *schema, Expr *expr, Value **result)
 		CPVAL(*result,expr->expr.cons);
 		break;
 	case EXPR_ATTRREF:
-		free(*result);
-		CHECK(getAttr(record, schema, expr->expr.attrRef, result));
+		// numbers are read into the result directly; only strings need a copy
+		if (expr->expr.attrRef < 0 || expr->expr.attrRef >= schema->numAttr)
+		{
+			free(*result);
+			CHECK(getAttr(record, schema, expr->expr.attrRef, result));
+			break;
+		}
+		switch (schema->dataTypes[expr->expr.attrRef])
+		{
+		case DT_INT:
+			(*result)->dt = DT_INT;
+			CHECK(getIntAttr(record, schema, expr->expr.attrRef, &(*result)->v.intV));
+			break;
+		case DT_FLOAT:
+			(*result)->dt = DT_FLOAT;
+			CHECK(getFloatAttr(record, schema, expr->expr.attrRef, &(*result)->v.floatV));
+			break;
+		case DT_BOOL:
+			(*result)->dt = DT_BOOL;
+			CHECK(getBoolAttr(record, schema, expr->expr.attrRef, &(*result)->v.boolV));
+			break;
+		case DT_STRING:
+			free(*result);
+			CHECK(getAttr(record, schema, expr->expr.attrRef, result));
+			break;
+		}
 		break;
 	}
 
@@ -188,3 +342,708 @@ freeVal (Value *val)
 	free(val);
 }
 
+
+RC
+compilePredicate (Expr *expr, Schema *schema, Predicate **pred)
+{
+	RC rc;
+	*pred = NULL;
+	if (!expr || !schema)
+		THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	if (expr->type == EXPR_CONST && expr->expr.cons->dt != DT_BOOL)
+		THROW(RC_RM_EXPR_RESULT_IS_NOT_BOOLEAN, "condition is not boolean");
+	if (expr->type == EXPR_ATTRREF && expr->expr.attrRef >= 0 && expr->expr.attrRef < schema->numAttr
+			&& schema->dataTypes[expr->expr.attrRef] != DT_BOOL)
+		THROW(RC_RM_EXPR_RESULT_IS_NOT_BOOLEAN, "condition is not boolean");
+
+	Predicate *p = (Predicate *) malloc(sizeof(Predicate));
+	p->code = (PredInstr *) calloc(countNodes(expr), sizeof(PredInstr));
+	p->length = 0;
+	p->chains = (PredChain *) calloc(countNodes(expr), sizeof(PredChain));
+	p->numChains = 0;
+	p->depth = 0;
+	p->pushed = 0;
+	if ((rc = compileNode(p, expr, schema)) != RC_OK)
+	{
+		freePredicate(p);
+		return rc;
+	}
+	*pred = p;
+	return RC_OK;
+}
+
+bool
+evalPredicate (Predicate *pred, Record *record)
+{
+	return evalRange(pred, 0, pred->length, record->data);
+}
+
+void
+evalPredicateBatch (Predicate *pred, const char *rows, int recordSize, int numRows, uint64_t *selection)
+{
+	evalBatch(pred, rows, recordSize, NULL, NULL, numRows, selection);
+}
+
+void
+evalPredicateColumns (Predicate *pred, const char *const *columns, const int *widths, int numRows, uint64_t *selection)
+{
+	evalBatch(pred, NULL, 0, columns, widths, numRows, selection);
+}
+
+void
+freePredicate (Predicate *pred)
+{
+	int i;
+	if (!pred)
+		return;
+	for (i = 0; i < pred->length; i++)
+	{
+		free(pred->code[i].args[0].str);
+		free(pred->code[i].args[1].str);
+	}
+	for (i = 0; i < pred->numChains; i++)
+		free(pred->chains[i].terms);
+	free(pred->chains);
+	free(pred->code);
+	free(pred);
+}
+
+// Emits the code for a boolean expression, which pushes one result
+static RC
+compileNode (Predicate *pred, Expr *expr, Schema *schema)
+{
+	PredInstr *in;
+	DataType type;
+	RC rc;
+
+	if (expr->type != EXPR_OP)
+	{
+		in = emit(pred, PRED_LOAD_BOOL, 0);
+		if ((rc = compileOperand(expr, schema, &in->args[0], &type)) != RC_OK)
+			return rc;
+		if (type != DT_BOOL)
+			THROW(RC_RM_BOOLEAN_EXPR_ARG_IS_NOT_BOOLEAN, "boolean operator requires boolean inputs");
+		return RC_OK;
+	}
+
+	Operator *op = expr->expr.op;
+	switch (op->type)
+	{
+	case OP_COMP_EQUAL:
+	case OP_COMP_SMALLER:
+		if (op->args[0]->type != EXPR_OP && op->args[1]->type != EXPR_OP)
+		{
+			// two operands read straight from the record or the constants
+			DataType rightType;
+			in = emit(pred, PRED_INT_EQUAL, 0);
+			if ((rc = compileOperand(op->args[0], schema, &in->args[0], &type)) != RC_OK
+					|| (rc = compileOperand(op->args[1], schema, &in->args[1], &rightType)) != RC_OK)
+				return rc;
+			if (type != rightType)
+				THROW(RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE, "comparison only supported for values of the same datatype");
+			in->op = PRED_INT_EQUAL + 2 * type + (op->type == OP_COMP_SMALLER);
+			return RC_OK;
+		}
+		// comparing the results of nested conditions
+		if ((rc = compileNode(pred, op->args[0], schema)) != RC_OK)
+			return rc;
+		if ((rc = compileNode(pred, op->args[1], schema)) != RC_OK)
+			return rc;
+		emit(pred, op->type == OP_COMP_EQUAL ? PRED_EQUAL : PRED_SMALLER, 2);
+		return RC_OK;
+	case OP_BOOL_NOT:
+		if ((rc = compileNode(pred, op->args[0], schema)) != RC_OK)
+			return rc;
+		emit(pred, PRED_NOT, 1);
+		return RC_OK;
+	case OP_BOOL_AND:
+	case OP_BOOL_OR:
+		return compileChain(pred, expr, schema);
+	}
+	THROW(RC_RM_UNKOWN_DATATYPE, "unknown operator");
+}
+
+// Flattens a run of ANDs (or ORs) into one chain. Each term is compiled on
+// its own stack, so the terms can run in any order or not at all.
+static RC
+compileChain (Predicate *pred, Expr *expr, Schema *schema)
+{
+	OpType type = expr->expr.op->type;
+	int numTerms = 0, at = pred->length, outer, i;
+	Expr *terms[countNodes(expr)];
+	PredChain *chain = &pred->chains[pred->numChains];
+	RC rc;
+
+	collectTerms(expr, type, terms, &numTerms);
+	chain->isAnd = type == OP_BOOL_AND;
+	chain->numTerms = numTerms;
+	chain->terms = (PredTerm *) calloc(numTerms, sizeof(PredTerm));
+	chain->rows = 0;
+	emit(pred, PRED_CHAIN, 0)->chain = pred->numChains++;
+	outer = pred->pushed;
+	for (i = 0; i < numTerms; i++)
+	{
+		PredTerm *term = &chain->terms[i];
+		pred->pushed = 0;
+		term->start = pred->length;
+		if ((rc = compileNode(pred, terms[i], schema)) != RC_OK)
+			return rc;
+		term->end = pred->length;
+		term->cost = estimateCost(pred, term->start, term->end);
+		term->prior = estimatePass(terms[i]);
+	}
+	pred->pushed = outer;
+	pred->code[at].next = pred->length;
+	orderTerms(chain);
+	return RC_OK;
+}
+
+static void
+collectTerms (Expr *expr, OpType type, Expr **terms, int *numTerms)
+{
+	if (expr->type == EXPR_OP && expr->expr.op->type == type)
+	{
+		collectTerms(expr->expr.op->args[0], type, terms, numTerms);
+		collectTerms(expr->expr.op->args[1], type, terms, numTerms);
+	}
+	else
+		terms[(*numTerms)++] = expr;
+}
+
+// Work of the code in [start, end), counting string comparisons as 4
+// numeric ones; nested chains are counted as if no term were skipped
+static double
+estimateCost (Predicate *pred, int start, int end)
+{
+	double cost = 0;
+	int i;
+	for (i = start; i < end; i++)
+	{
+		if (pred->code[i].op == PRED_STRING_EQUAL || pred->code[i].op == PRED_STRING_SMALLER)
+			cost += 4;
+		else if (pred->code[i].op <= PRED_LOAD_BOOL)
+			cost += 1;
+	}
+	return cost;
+}
+
+// Share of rows expected to pass, with the textbook guesses of 1/10 for
+// equality and 1/3 for a range comparison, terms taken as independent
+static double
+estimatePass (Expr *expr)
+{
+	double l, r;
+	if (expr->type != EXPR_OP)
+		return 0.5;
+	switch (expr->expr.op->type)
+	{
+	case OP_COMP_EQUAL:
+		return 0.1;
+	case OP_COMP_SMALLER:
+		return 1.0 / 3;
+	case OP_BOOL_NOT:
+		return 1 - estimatePass(expr->expr.op->args[0]);
+	case OP_BOOL_AND:
+		return estimatePass(expr->expr.op->args[0]) * estimatePass(expr->expr.op->args[1]);
+	case OP_BOOL_OR:
+		l = estimatePass(expr->expr.op->args[0]);
+		r = estimatePass(expr->expr.op->args[1]);
+		return l + r - l * r;
+	}
+	return 0.5;
+}
+
+// Sorts the terms by cost per row decided, which minimises the expected
+// cost of the chain: a term decides an AND when it fails and an OR when it
+// passes. The observed pass rates are smoothed towards the prior and then
+// halved, so later rows weigh more.
+static void
+orderTerms (PredChain *chain)
+{
+	double rank[chain->numTerms], r;
+	PredTerm term;
+	int i, j;
+
+	for (i = 0; i < chain->numTerms; i++)
+	{
+		PredTerm *t = &chain->terms[i];
+		double pass = (t->passes + t->prior * PRED_PRIOR_ROWS) / (t->evals + PRED_PRIOR_ROWS);
+		rank[i] = t->cost / ((chain->isAnd ? 1 - pass : pass) + 1e-9);
+		t->evals /= 2;
+		t->passes /= 2;
+	}
+	// insertion sort; ties keep the order the terms were written in
+	for (i = 1; i < chain->numTerms; i++)
+	{
+		term = chain->terms[i];
+		r = rank[i];
+		for (j = i; j > 0 && rank[j - 1] > r; j--)
+		{
+			chain->terms[j] = chain->terms[j - 1];
+			rank[j] = rank[j - 1];
+		}
+		chain->terms[j] = term;
+		rank[j] = r;
+	}
+	chain->rows = 0;
+}
+
+// Appends an instruction that pops popped results and pushes one
+static PredInstr *
+emit (Predicate *pred, PredOp op, int popped)
+{
+	PredInstr *in = &pred->code[pred->length++];
+	in->op = op;
+	pred->pushed += 1 - popped;
+	if (pred->pushed > pred->depth)
+		pred->depth = pred->pushed;
+	return in;
+}
+
+static RC
+compileOperand (Expr *expr, Schema *schema, PredOperand *operand, DataType *type)
+{
+	if (expr->type == EXPR_ATTRREF)
+	{
+		int attr = expr->expr.attrRef;
+		if (attr < 0 || attr >= schema->numAttr)
+			THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+		*type = schema->dataTypes[attr];
+		operand->attr = attr;
+		operand->offset = attrPosition(schema, attr);
+		operand->width = schema->typeLength[attr];
+		return RC_OK;
+	}
+
+	Value *cons = expr->expr.cons;
+	*type = cons->dt;
+	switch (cons->dt)
+	{
+	case DT_INT:
+		operand->v.intV = cons->v.intV;
+		break;
+	case DT_FLOAT:
+		operand->v.floatV = cons->v.floatV;
+		break;
+	case DT_BOOL:
+		operand->v.boolV = cons->v.boolV;
+		break;
+	case DT_STRING:
+		operand->width = strlen(cons->v.stringV) + 1;
+		operand->str = (char *) malloc(operand->width);
+		memcpy(operand->str, cons->v.stringV, operand->width);
+		operand->cons = operand->str;
+		return RC_OK;
+	}
+	operand->cons = (const char *) &operand->v;
+	return RC_OK;
+}
+
+// strcmp for strings that end at a NUL or after width bytes
+static int
+compareStrings (const char *left, int leftWidth, const char *right, int rightWidth)
+{
+	int n = leftWidth < rightWidth ? leftWidth : rightWidth;
+	int cmp = strncmp(left, right, n);
+	if (cmp != 0 || leftWidth == rightWidth || memchr(left, '\0', n))
+		return cmp;
+	// equal up to the shorter width, where that operand ends
+	if (leftWidth < rightWidth)
+		return right[n] ? -1 : 0;
+	return left[n] ? 1 : 0;
+}
+
+static int
+countNodes (Expr *expr)
+{
+	if (expr->type != EXPR_OP)
+		return 1;
+	if (expr->expr.op->type == OP_BOOL_NOT)
+		return 1 + countNodes(expr->expr.op->args[0]);
+	return 1 + countNodes(expr->expr.op->args[0]) + countNodes(expr->expr.op->args[1]);
+}
+
+static int
+attrPosition (Schema *schema, int attrNum)
+{
+	int offset = 0, i;
+	if (schema->attrOffsets)
+		return schema->attrOffsets[attrNum];
+	for (i = 0; i < attrNum; i++)
+	{
+		switch (schema->dataTypes[i])
+		{
+		case DT_INT:
+			offset += sizeof(int);
+			break;
+		case DT_FLOAT:
+			offset += sizeof(float);
+			break;
+		case DT_BOOL:
+			offset += sizeof(bool);
+			break;
+		case DT_STRING:
+			offset += schema->typeLength[i];
+			break;
+		}
+	}
+	return offset;
+}
+
+// Runs a comparison or bool load on the row at data
+static bool
+evalCompare (PredInstr *in, const char *data)
+{
+	const char *l = in->args[0].cons ? in->args[0].cons : data + in->args[0].offset;
+	const char *r = in->args[1].cons ? in->args[1].cons : data + in->args[1].offset;
+	return compareValues(in, l, r);
+}
+
+// Runs a comparison on the operand bytes at l and r, or a bool load on l
+static bool
+compareValues (PredInstr *in, const char *l, const char *r)
+{
+	int li, ri;
+	float lf, rf;
+	bool lb, rb;
+
+	switch (in->op)
+	{
+	case PRED_INT_EQUAL:
+	case PRED_INT_SMALLER:
+		memcpy(&li, l, sizeof(int));
+		memcpy(&ri, r, sizeof(int));
+		return in->op == PRED_INT_EQUAL ? li == ri : li < ri;
+	case PRED_FLOAT_EQUAL:
+	case PRED_FLOAT_SMALLER:
+		memcpy(&lf, l, sizeof(float));
+		memcpy(&rf, r, sizeof(float));
+		return in->op == PRED_FLOAT_EQUAL ? lf == rf : lf < rf;
+	case PRED_BOOL_EQUAL:
+	case PRED_BOOL_SMALLER:
+		memcpy(&lb, l, sizeof(bool));
+		memcpy(&rb, r, sizeof(bool));
+		return in->op == PRED_BOOL_EQUAL ? lb == rb : lb < rb;
+	case PRED_STRING_EQUAL:
+		return compareStrings(l, in->args[0].width, r, in->args[1].width) == 0;
+	case PRED_STRING_SMALLER:
+		return compareStrings(l, in->args[0].width, r, in->args[1].width) < 0;
+	case PRED_LOAD_BOOL:
+		memcpy(&lb, l, sizeof(bool));
+		return lb;
+	default:
+		return FALSE;
+	}
+}
+
+// Runs the code in [from, to), which pushes one result, on the row at data
+static bool
+evalRange (Predicate *pred, int from, int to, const char *data)
+{
+	bool stack[pred->depth];
+	int top = 0, i;
+	PredInstr *in;
+
+	for (i = from; i < to; i++)
+	{
+		in = &pred->code[i];
+		switch (in->op)
+		{
+		case PRED_EQUAL:
+			top--;
+			stack[top - 1] = stack[top - 1] == stack[top];
+			break;
+		case PRED_SMALLER:
+			top--;
+			stack[top - 1] = stack[top - 1] < stack[top];
+			break;
+		case PRED_NOT:
+			stack[top - 1] = !stack[top - 1];
+			break;
+		case PRED_CHAIN:
+			stack[top++] = evalChain(pred, &pred->chains[in->chain], data);
+			i = in->next - 1;
+			break;
+		default:
+			stack[top++] = evalCompare(in, data);
+			break;
+		}
+	}
+	return stack[0];
+}
+
+static bool
+evalChain (Predicate *pred, PredChain *chain, const char *data)
+{
+	bool result = chain->isAnd, pass;
+	int t;
+
+	for (t = 0; t < chain->numTerms; t++)
+	{
+		PredTerm *term = &chain->terms[t];
+		pass = evalRange(pred, term->start, term->end, data) != 0;
+		term->evals++;
+		term->passes += pass;
+		if (pass != chain->isAnd)
+		{
+			result = pass;
+			break;
+		}
+	}
+	if (++chain->rows >= PRED_REORDER_ROWS)
+		orderTerms(chain);
+	return result;
+}
+
+// Evaluates pred a chunk of rows at a time, binding the operands to each
+// chunk: to rows stored recordSize bytes apart, or to columns if not NULL
+static void
+evalBatch (Predicate *pred, const char *rows, int recordSize, const char *const *columns, const int *widths, int numRows, uint64_t *selection)
+{
+	uint64_t active[PRED_CHUNK_WORDS];
+	int start, n, w;
+	for (start = 0; start < numRows; start += PRED_CHUNK_ROWS)
+	{
+		n = numRows - start < PRED_CHUNK_ROWS ? numRows - start : PRED_CHUNK_ROWS;
+		for (w = 0; w < PRED_CHUNK_WORDS; w++)
+			active[w] = w * 64 + 64 <= n ? ~0ULL : w * 64 < n ? (1ULL << (n % 64)) - 1 : 0;
+		bindOperands(pred, rows, recordSize, columns, widths, start);
+		evalRangeBatch(pred, 0, pred->length, n, active, selection + start / 64);
+		for (w = 0; w * 64 < n; w++)
+			selection[start / 64 + w] &= active[w];
+	}
+}
+
+// Points every attribute operand at its value in row first
+static void
+bindOperands (Predicate *pred, const char *rows, int recordSize, const char *const *columns, const int *widths, int first)
+{
+	PredOperand *operand;
+	int i, k;
+	for (i = 0; i < pred->length; i++)
+	{
+		if (pred->code[i].op > PRED_LOAD_BOOL)
+			continue;
+		for (k = 0; k < 2; k++)
+		{
+			operand = &pred->code[i].args[k];
+			if (operand->cons)
+				continue;
+			if (columns)
+			{
+				operand->stride = widths[operand->attr];
+				operand->base = columns[operand->attr] + (size_t) first * operand->stride;
+			}
+			else
+			{
+				operand->stride = recordSize;
+				operand->base = rows + (size_t) first * recordSize + operand->offset;
+			}
+		}
+	}
+}
+
+// Like evalRange on n <= PRED_CHUNK_ROWS bound rows, with a stack of
+// selection bitmaps. Only the rows set in active are needed; the bits of the
+// others in out are left undefined.
+static void
+evalRangeBatch (Predicate *pred, int from, int to, int n, const uint64_t *active, uint64_t *out)
+{
+	uint64_t stack[pred->depth][PRED_CHUNK_WORDS];
+	uint64_t bits;
+	int words = (n + 63) / 64;
+	int top = 0, i, w, row;
+	const char *l, *r;
+	PredInstr *in;
+
+	for (i = from; i < to; i++)
+	{
+		in = &pred->code[i];
+		switch (in->op)
+		{
+		case PRED_INT_EQUAL:
+		case PRED_INT_SMALLER:
+		case PRED_FLOAT_EQUAL:
+		case PRED_FLOAT_SMALLER:
+			compareColumns(in, n, stack[top++]);
+			break;
+		case PRED_EQUAL:
+			top--;
+			for (w = 0; w < words; w++)
+				stack[top - 1][w] = ~(stack[top - 1][w] ^ stack[top][w]);
+			break;
+		case PRED_SMALLER:
+			top--;
+			for (w = 0; w < words; w++)
+				stack[top - 1][w] = ~stack[top - 1][w] & stack[top][w];
+			break;
+		case PRED_NOT:
+			for (w = 0; w < words; w++)
+				stack[top - 1][w] = ~stack[top - 1][w];
+			break;
+		case PRED_CHAIN:
+			evalChainBatch(pred, &pred->chains[in->chain], n, active, stack[top++]);
+			i = in->next - 1;
+			break;
+		default:
+			// strings and bools are tested one active row at a time
+			memset(stack[top], 0, sizeof(stack[top]));
+			for (w = 0; w < words; w++)
+				for (bits = active[w]; bits; bits &= bits - 1)
+				{
+					row = w * 64 + __builtin_ctzll(bits);
+					l = in->args[0].cons ? in->args[0].cons : in->args[0].base + (size_t) row * in->args[0].stride;
+					r = in->args[1].cons ? in->args[1].cons : in->args[1].base + (size_t) row * in->args[1].stride;
+					if (compareValues(in, l, r))
+						stack[top][w] |= 1ULL << (row % 64);
+				}
+			top++;
+			break;
+		}
+	}
+	memcpy(out, stack[0], words * sizeof(uint64_t));
+}
+
+// Each term runs only on the rows the terms before it left undecided
+static void
+evalChainBatch (Predicate *pred, PredChain *chain, int n, const uint64_t *active, uint64_t *out)
+{
+	uint64_t open[PRED_CHUNK_WORDS], bits[PRED_CHUNK_WORDS], pass, any;
+	int words = (n + 63) / 64, t, w;
+	long evaluated, passed;
+
+	memcpy(open, active, words * sizeof(uint64_t));
+	memset(out, 0, words * sizeof(uint64_t));
+	for (t = 0; t < chain->numTerms; t++)
+	{
+		PredTerm *term = &chain->terms[t];
+		for (any = 0, w = 0; w < words; w++)
+			any |= open[w];
+		if (!any)
+			break;
+		evalRangeBatch(pred, term->start, term->end, n, open, bits);
+		evaluated = passed = 0;
+		for (w = 0; w < words; w++)
+		{
+			pass = bits[w] & open[w];
+			evaluated += __builtin_popcountll(open[w]);
+			passed += __builtin_popcountll(pass);
+			if (chain->isAnd)
+				open[w] = pass;
+			else
+			{
+				out[w] |= pass;
+				open[w] &= ~pass;
+			}
+		}
+		term->evals += evaluated;
+		term->passes += passed;
+	}
+	// the rows still open passed every term of an AND
+	if (chain->isAnd)
+		memcpy(out, open, words * sizeof(uint64_t));
+	for (w = 0; w < words; w++)
+		chain->rows += __builtin_popcountll(active[w]);
+	if (chain->rows >= PRED_REORDER_ROWS)
+		orderTerms(chain);
+}
+
+// Copies a numeric operand of n rows into out, or repeats a constant. A
+// column of packed numbers is copied in one go.
+static void
+gatherOperand (PredOperand *operand, int n, int *out)
+{
+	const char *value = operand->base;
+	int i, v;
+	if (operand->cons)
+	{
+		memcpy(&v, operand->cons, sizeof(int));
+		for (i = 0; i < n; i++)
+			out[i] = v;
+		return;
+	}
+	if (operand->stride == sizeof(int))
+	{
+		memcpy(out, value, n * sizeof(int));
+		return;
+	}
+	for (i = 0; i < n; i++, value += operand->stride)
+		memcpy(&out[i], value, sizeof(int));
+}
+
+// Sets bit i of bits if row i passes the int or float comparison in
+static void
+compareColumns (PredInstr *in, int n, uint64_t *bits)
+{
+	// ints and floats are both 4 bytes and gathered alike
+	union {
+		int i[PRED_CHUNK_ROWS];
+		float f[PRED_CHUNK_ROWS];
+	} left, right;
+	int i;
+
+	gatherOperand(&in->args[0], n, left.i);
+	gatherOperand(&in->args[1], n, right.i);
+	memset(bits, 0, PRED_CHUNK_WORDS * sizeof(uint64_t));
+	for (i = 0; i + PRED_LANES <= n; i += PRED_LANES)
+		bits[i / 64] |= (uint64_t) compareLanes(in->op, &left.i[i], &right.i[i]) << (i % 64);
+	for (; i < n; i++)
+		bits[i / 64] |= (uint64_t) compareLane(in->op, left.i[i], right.i[i], left.f[i], right.f[i]) << (i % 64);
+}
+
+static int
+compareLane (PredOp op, int li, int ri, float lf, float rf)
+{
+	switch (op)
+	{
+	case PRED_INT_EQUAL:
+		return li == ri;
+	case PRED_INT_SMALLER:
+		return li < ri;
+	case PRED_FLOAT_EQUAL:
+		return lf == rf;
+	default:
+		return lf < rf;
+	}
+}
+
+// Compares PRED_LANES values of l and r (ints, or floats with the same bits)
+// and returns one bit per lane
+static int
+compareLanes (PredOp op, const int *l, const int *r)
+{
+#if defined(__AVX2__)
+	__m256i li = _mm256_loadu_si256((const __m256i *) l), ri = _mm256_loadu_si256((const __m256i *) r);
+	__m256 lf = _mm256_castsi256_ps(li), rf = _mm256_castsi256_ps(ri);
+	switch (op)
+	{
+	case PRED_INT_EQUAL:
+		return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(li, ri)));
+	case PRED_INT_SMALLER:
+		return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(ri, li)));
+	case PRED_FLOAT_EQUAL:
+		return _mm256_movemask_ps(_mm256_cmp_ps(lf, rf, _CMP_EQ_OQ));
+	default:
+		return _mm256_movemask_ps(_mm256_cmp_ps(lf, rf, _CMP_LT_OQ));
+	}
+#elif defined(__SSE2__)
+	__m128i li = _mm_loadu_si128((const __m128i *) l), ri = _mm_loadu_si128((const __m128i *) r);
+	__m128 lf = _mm_castsi128_ps(li), rf = _mm_castsi128_ps(ri);
+	switch (op)
+	{
+	case PRED_INT_EQUAL:
+		return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(li, ri)));
+	case PRED_INT_SMALLER:
+		return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(li, ri)));
+	case PRED_FLOAT_EQUAL:
+		return _mm_movemask_ps(_mm_cmpeq_ps(lf, rf));
+	default:
+		return _mm_movemask_ps(_mm_cmplt_ps(lf, rf));
+	}
+#else
+	float lf, rf;
+	memcpy(&lf, l, sizeof(float));
+	memcpy(&rf, r, sizeof(float));
+	return compareLane(op, *l, *r, lf, rf);
+#endif
+}
@@ -1,6 +1,8 @@
 #ifndef EXPR_H
 #define EXPR_H
 
+#include <stdint.h>
+
 #include "dberror.h"
 #include "tables.h"
 
@@ -44,6 +46,26 @@ extern RC evalExpr (Record *record, Schema *schema, Expr *expr, Value **result);
 extern RC freeExpr (Expr *expr);
 extern void freeVal(Value *val);
 
+// A condition compiled against a schema into a flat program: attribute
+// offsets and constants are resolved once, and each comparison runs a
+// comparator specialised for its type and operator. Runs of ANDs and ORs
+// become chains that stop at the first deciding term and reorder their terms
+// by cost and observed pass rate. compilePredicate fails (leaving *pred NULL)
+// on conditions that are not well-typed booleans, which are left to
+// evalExpr. Evaluating a predicate never allocates, but it updates the
+// statistics, so one predicate must not be evaluated by two threads at once.
+typedef struct Predicate Predicate;
+extern RC compilePredicate (Expr *expr, Schema *schema, Predicate **pred);
+extern bool evalPredicate (Predicate *pred, Record *record);
+// Evaluates pred on numRows rows stored recordSize bytes apart and sets bit i
+// % 64 of selection[i / 64] to whether row i matches. Int and float
+// comparisons run column-wise with SSE2 or AVX2 (if compiled with -mavx2).
+extern void evalPredicateBatch (Predicate *pred, const char *rows, int recordSize, int numRows, uint64_t *selection);
+// Like evalPredicateBatch on rows stored column by column: attribute a of
+// row i is at columns[a] + i * widths[a]
+extern void evalPredicateColumns (Predicate *pred, const char *const *columns, const int *widths, int numRows, uint64_t *selection);
+extern void freePredicate (Predicate *pred);
+
 
 #define CPVAL(_result,_input)						\
   do {									\
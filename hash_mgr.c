@@ -0,0 +1,604 @@
+#include "hash_mgr.h"
+#include "buffer_mgr.h"
+#include "storage_mgr.h"
+#include "dberror.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Disk-based linear hash index. Page 0 holds the index info followed by the
+// start of the bucket directory (bucket number -> primary page); longer
+// directories continue on a chain of directory pages. A bucket is a primary
+// page plus a chain of overflow pages holding (key, RID) entries. Whenever
+// the load factor is exceeded the next bucket in order is split in two, so
+// the index grows one bucket at a time and never rehashes as a whole.
+
+#define INFO_PAGE 0
+#define HASH_MAGIC 0x48415348
+#define HASH_POOL_SIZE 16
+#define MAX_LOAD_PERCENT 75
+
+typedef struct HashInfo {
+	int magic;
+	DataType keyType;
+	int keyLength;
+	int level;        // buckets below split use level + 1 hash bits, the rest level
+	int split;        // next bucket to split
+	int numEntries;
+	int numPages;
+	int freePage;
+	int dirPage;      // first directory page after the info page, or -1
+} HashInfo;
+
+typedef struct BucketHeader {
+	int numEntries;
+	int next;         // next overflow page, next free page, or -1
+} BucketHeader;
+
+typedef struct HashManager {
+	BM_BufferPool *bm;
+	HashInfo info;
+	int keySize;
+	int entrySize;
+	int entriesPerPage;
+	int *buckets;     // primary page of every bucket
+	int capacity;
+} HashManager;
+
+typedef struct HashScan {
+	int page;
+	int pos;
+	char key[];
+} HashScan;
+
+#define INFO_DIR_ENTRIES ((PAGE_SIZE - (int)sizeof(HashInfo)) / (int)sizeof(int))
+#define PAGE_DIR_ENTRIES (PAGE_SIZE / (int)sizeof(int) - 1)
+
+static int keySize(DataType keyType, int keyLength);
+static RC encodeEntry(HashManager *ht, Value *key, RID rid, char *entry);
+static uint32_t hashEntry(HashManager *ht, const char *entry);
+static int numBuckets(HashManager *ht);
+static int bucketOf(HashManager *ht, const char *entry);
+static BucketHeader *bucketHeader(char *page);
+static char *bucketEntry(HashManager *ht, char *page, int i);
+static RC allocPage(HashManager *ht, BM_PageHandle *ph);
+static RC freePage(HashManager *ht, int page);
+static void addBucket(HashManager *ht, int page);
+static RC loadDirectory(HashManager *ht, char *infoPage);
+static RC pinDirPage(HashManager *ht, int *link, BM_PageHandle *ph);
+static RC saveInfo(HashManager *ht);
+static RC findEntry(HashManager *ht, const char *entry, int length, int *page, int *prev, int *pos);
+static RC addEntry(HashManager *ht, int bucket, const char *entry);
+static RC splitBucket(HashManager *ht);
+
+RC createHashIndex(char *idxId, DataType keyType, int keyLength) {
+	BM_BufferPool bm;
+	BM_PageHandle ph;
+	RC rc;
+
+	if (!idxId || (keyType == DT_STRING && keyLength <= 0))
+		THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	int entrySize = keySize(keyType, keyLength) + sizeof(RID);
+	if ((PAGE_SIZE - (int)sizeof(BucketHeader)) / entrySize < 2)
+		THROW(RC_IM_N_TO_LAGE, "Key too large");
+
+	rc = createPageFile(idxId);
+	if (rc != RC_OK) return rc;
+	rc = initBufferPool(&bm, idxId, 3, RS_FIFO, NULL);
+	if (rc != RC_OK) return rc;
+
+	// a single empty bucket on page 1
+	HashInfo info = { HASH_MAGIC, keyType, keyLength, 0, 0, 0, 2, -1, -1 };
+	int bucket = 1;
+	rc = ensurePoolCapacity(&bm, bucket + 1);
+	if (rc == RC_OK) rc = pinPage(&bm, &ph, bucket);
+	if (rc == RC_OK) {
+		bucketHeader(ph.data)->numEntries = 0;
+		bucketHeader(ph.data)->next = -1;
+		markDirty(&bm, &ph);
+		unpinPage(&bm, &ph);
+		rc = pinPage(&bm, &ph, INFO_PAGE);
+	}
+	if (rc == RC_OK) {
+		memcpy(ph.data, &info, sizeof(HashInfo));
+		memcpy(ph.data + sizeof(HashInfo), &bucket, sizeof(int));
+		markDirty(&bm, &ph);
+		unpinPage(&bm, &ph);
+	}
+	shutdownBufferPool(&bm);
+	return rc;
+}
+
+RC openHashIndex(HashHandle **index, char *idxId) {
+	BM_PageHandle ph;
+	if (!index || !idxId) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+
+	HashManager *ht = (HashManager *)malloc(sizeof(HashManager));
+	ht->bm = (BM_BufferPool *)malloc(sizeof(BM_BufferPool));
+	ht->buckets = NULL;
+	RC rc = initBufferPool(ht->bm, idxId, HASH_POOL_SIZE, RS_LRU, NULL);
+	if (rc == RC_OK) {
+		rc = pinPage(ht->bm, &ph, INFO_PAGE);
+		if (rc == RC_OK) {
+			memcpy(&ht->info, ph.data, sizeof(HashInfo));
+			if (ht->info.magic != HASH_MAGIC) {
+				RC_message = "Unsupported index format";
+				rc = RC_IM_UNSUPPORTED_INDEX_FORMAT;
+			} else {
+				rc = loadDirectory(ht, ph.data);
+			}
+			unpinPage(ht->bm, &ph);
+		}
+		if (rc != RC_OK) shutdownBufferPool(ht->bm);
+	}
+	if (rc != RC_OK) {
+		free(ht->buckets);
+		free(ht->bm);
+		free(ht);
+		return rc;
+	}
+
+	ht->keySize = keySize(ht->info.keyType, ht->info.keyLength);
+	ht->entrySize = ht->keySize + sizeof(RID);
+	ht->entriesPerPage = (PAGE_SIZE - sizeof(BucketHeader)) / ht->entrySize;
+	HashHandle *handle = (HashHandle *)malloc(sizeof(HashHandle));
+	handle->keyType = ht->info.keyType;
+	handle->idxId = (char *)malloc(strlen(idxId) + 1);
+	strcpy(handle->idxId, idxId);
+	handle->mgmtData = ht;
+	*index = handle;
+	return RC_OK;
+}
+
+RC closeHashIndex(HashHandle *index) {
+	if (!index || !index->mgmtData) THROW(RC_FILE_HANDLE_NOT_INIT, "Index not initialized");
+	HashManager *ht = (HashManager *)index->mgmtData;
+
+	RC rc = saveInfo(ht);
+	forceFlushPool(ht->bm);
+	shutdownBufferPool(ht->bm);
+	free(ht->bm);
+	free(ht->buckets);
+	free(ht);
+	free(index->idxId);
+	free(index);
+	return rc;
+}
+
+RC deleteHashIndex(char *idxId) {
+	if (!idxId) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	discardWorkingSet(idxId);
+	return destroyPageFile(idxId);
+}
+
+RC getNumHashEntries(HashHandle *index, int *result) {
+	if (!index || !index->mgmtData || !result) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	*result = ((HashManager *)index->mgmtData)->info.numEntries;
+	return RC_OK;
+}
+
+RC getNumBuckets(HashHandle *index, int *result) {
+	if (!index || !index->mgmtData || !result) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	*result = numBuckets((HashManager *)index->mgmtData);
+	return RC_OK;
+}
+
+RC findHashKey(HashHandle *index, Value *key, RID *result) {
+	if (!index || !index->mgmtData || !key || !result) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	HashManager *ht = (HashManager *)index->mgmtData;
+	BM_PageHandle ph;
+	char entry[PAGE_SIZE];
+	RID none = { 0, 0 };
+	int page, prev, pos;
+
+	RC rc = encodeEntry(ht, key, none, entry);
+	if (rc == RC_OK) rc = findEntry(ht, entry, ht->keySize, &page, &prev, &pos);
+	if (rc == RC_OK) rc = pinPage(ht->bm, &ph, page);
+	if (rc != RC_OK) return rc;
+	memcpy(result, bucketEntry(ht, ph.data, pos) + ht->keySize, sizeof(RID));
+	return unpinPage(ht->bm, &ph);
+}
+
+RC insertHashKey(HashHandle *index, Value *key, RID rid) {
+	if (!index || !index->mgmtData || !key) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	HashManager *ht = (HashManager *)index->mgmtData;
+	char entry[PAGE_SIZE];
+	int page, prev, pos;
+
+	RC rc = encodeEntry(ht, key, rid, entry);
+	if (rc != RC_OK) return rc;
+	rc = findEntry(ht, entry, ht->entrySize, &page, &prev, &pos);
+	if (rc == RC_OK) THROW(RC_IM_KEY_ALREADY_EXISTS, "Key already exists");
+	if (rc != RC_IM_KEY_NOT_FOUND) return rc;
+	rc = addEntry(ht, bucketOf(ht, entry), entry);
+	if (rc != RC_OK) return rc;
+	ht->info.numEntries++;
+
+	if ((long)ht->info.numEntries * 100 > (long)numBuckets(ht) * ht->entriesPerPage * MAX_LOAD_PERCENT)
+		return splitBucket(ht);
+	return RC_OK;
+}
+
+RC deleteHashKey(HashHandle *index, Value *key, RID rid) {
+	if (!index || !index->mgmtData || !key) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	HashManager *ht = (HashManager *)index->mgmtData;
+	BM_PageHandle ph;
+	char entry[PAGE_SIZE];
+	int page, prev, pos;
+
+	RC rc = encodeEntry(ht, key, rid, entry);
+	if (rc == RC_OK) rc = findEntry(ht, entry, ht->entrySize, &page, &prev, &pos);
+	if (rc == RC_OK) rc = pinPage(ht->bm, &ph, page);
+	if (rc != RC_OK) return rc;
+
+	// the page's last entry fills the hole
+	BucketHeader *header = bucketHeader(ph.data);
+	beginPageWrite(ht->bm, &ph);
+	header->numEntries--;
+	memmove(bucketEntry(ht, ph.data, pos), bucketEntry(ht, ph.data, header->numEntries), ht->entrySize);
+	int next = header->next;
+	bool empty = header->numEntries == 0;
+	markDirty(ht->bm, &ph);
+	unpinPage(ht->bm, &ph);
+	ht->info.numEntries--;
+	if (!empty || prev < 0) return RC_OK;
+
+	// an emptied overflow page leaves the chain
+	rc = pinPage(ht->bm, &ph, prev);
+	if (rc != RC_OK) return rc;
+	beginPageWrite(ht->bm, &ph);
+	bucketHeader(ph.data)->next = next;
+	markDirty(ht->bm, &ph);
+	unpinPage(ht->bm, &ph);
+	return freePage(ht, page);
+}
+
+RC openHashScan(HashHandle *index, Value *key, HT_ScanHandle **handle) {
+	if (!index || !index->mgmtData || !key || !handle) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	HashManager *ht = (HashManager *)index->mgmtData;
+	HashScan *scan = (HashScan *)malloc(sizeof(HashScan) + ht->entrySize);
+	RID none = { 0, 0 };
+
+	RC rc = encodeEntry(ht, key, none, scan->key);
+	if (rc != RC_OK) {
+		free(scan);
+		return rc;
+	}
+	scan->page = ht->buckets[bucketOf(ht, scan->key)];
+	scan->pos = 0;
+	*handle = (HT_ScanHandle *)malloc(sizeof(HT_ScanHandle));
+	(*handle)->index = index;
+	(*handle)->mgmtData = scan;
+	return RC_OK;
+}
+
+RC nextHashEntry(HT_ScanHandle *handle, RID *result) {
+	if (!handle || !handle->mgmtData || !result) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	HashManager *ht = (HashManager *)handle->index->mgmtData;
+	HashScan *scan = (HashScan *)handle->mgmtData;
+	BM_PageHandle ph;
+
+	while (scan->page >= 0) {
+		RC rc = pinPage(ht->bm, &ph, scan->page);
+		if (rc != RC_OK) return rc;
+		BucketHeader *header = bucketHeader(ph.data);
+		while (scan->pos < header->numEntries) {
+			char *entry = bucketEntry(ht, ph.data, scan->pos++);
+			if (memcmp(entry, scan->key, ht->keySize) == 0) {
+				memcpy(result, entry + ht->keySize, sizeof(RID));
+				return unpinPage(ht->bm, &ph);
+			}
+		}
+		scan->page = header->next;
+		scan->pos = 0;
+		unpinPage(ht->bm, &ph);
+	}
+
+	THROW(RC_IM_NO_MORE_ENTRIES, "No more entries");
+}
+
+RC closeHashScan(HT_ScanHandle *handle) {
+	if (!handle) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	free(handle->mgmtData);
+	free(handle);
+	return RC_OK;
+}
+
+static int keySize(DataType keyType, int keyLength) {
+	switch (keyType) {
+	case DT_INT: return sizeof(int);
+	case DT_FLOAT: return sizeof(float);
+	case DT_BOOL: return sizeof(bool);
+	case DT_STRING: return keyLength;
+	}
+	return 0;
+}
+
+// Equal keys must encode to equal bytes, since entries are hashed and
+// compared as bytes
+static RC encodeEntry(HashManager *ht, Value *key, RID rid, char *entry) {
+	if (key->dt != ht->info.keyType)
+		THROW(RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE, "Key type mismatch");
+	switch (key->dt) {
+	case DT_INT: memcpy(entry, &key->v.intV, sizeof(int)); break;
+	case DT_FLOAT: {
+		float f = key->v.floatV == 0 ? 0 : key->v.floatV;   // -0 == 0
+		memcpy(entry, &f, sizeof(float));
+		break;
+	}
+	case DT_BOOL: {
+		bool b = key->v.boolV != 0;
+		memcpy(entry, &b, sizeof(bool));
+		break;
+	}
+	case DT_STRING: strncpy(entry, key->v.stringV, ht->info.keyLength); break;
+	}
+	memcpy(entry + ht->keySize, &rid, sizeof(RID));
+	return RC_OK;
+}
+
+// FNV-1a over the key bytes, finished with a mixer so the low bits used
+// for addressing depend on every byte
+static uint32_t hashEntry(HashManager *ht, const char *entry) {
+	uint32_t hash = 2166136261u;
+	for (int i = 0; i < ht->keySize; i++) {
+		hash ^= (unsigned char)entry[i];
+		hash *= 16777619u;
+	}
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35u;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+static int numBuckets(HashManager *ht) {
+	return (1 << ht->info.level) + ht->info.split;
+}
+
+static int bucketOf(HashManager *ht, const char *entry) {
+	uint32_t hash = hashEntry(ht, entry);
+	uint32_t bucket = hash & ((1u << ht->info.level) - 1);
+	// buckets before split have already been split with one more bit
+	if (bucket < (uint32_t)ht->info.split)
+		bucket = hash & ((2u << ht->info.level) - 1);
+	return (int)bucket;
+}
+
+static BucketHeader *bucketHeader(char *page) {
+	return (BucketHeader *)page;
+}
+
+static char *bucketEntry(HashManager *ht, char *page, int i) {
+	return page + sizeof(BucketHeader) + i * ht->entrySize;
+}
+
+// Pins an empty page, reusing one from the free list if there is one
+static RC allocPage(HashManager *ht, BM_PageHandle *ph) {
+	int page = ht->info.freePage;
+	RC rc;
+	if (page >= 0) {
+		rc = pinPage(ht->bm, ph, page);
+		if (rc != RC_OK) return rc;
+		ht->info.freePage = bucketHeader(ph->data)->next;
+	} else {
+		page = ht->info.numPages;
+		rc = ensurePoolCapacity(ht->bm, page + 1);
+		if (rc != RC_OK) return rc;
+		rc = pinPage(ht->bm, ph, page);
+		if (rc != RC_OK) return rc;
+		ht->info.numPages++;
+	}
+	beginPageWrite(ht->bm, ph);
+	bucketHeader(ph->data)->numEntries = 0;
+	bucketHeader(ph->data)->next = -1;
+	return RC_OK;
+}
+
+static RC freePage(HashManager *ht, int page) {
+	BM_PageHandle ph;
+	RC rc = pinPage(ht->bm, &ph, page);
+	if (rc != RC_OK) return rc;
+	beginPageWrite(ht->bm, &ph);
+	bucketHeader(ph.data)->numEntries = 0;
+	bucketHeader(ph.data)->next = ht->info.freePage;
+	ht->info.freePage = page;
+	markDirty(ht->bm, &ph);
+	return unpinPage(ht->bm, &ph);
+}
+
+static void addBucket(HashManager *ht, int page) {
+	int n = numBuckets(ht);
+	if (n == ht->capacity) {
+		ht->capacity *= 2;
+		ht->buckets = (int *)realloc(ht->buckets, ht->capacity * sizeof(int));
+	}
+	ht->buckets[n] = page;
+}
+
+static RC loadDirectory(HashManager *ht, char *infoPage) {
+	BM_PageHandle ph;
+	int n = numBuckets(ht);
+	int count = n < INFO_DIR_ENTRIES ? n : INFO_DIR_ENTRIES;
+	ht->capacity = 16;
+	while (ht->capacity <= n) ht->capacity *= 2;
+	ht->buckets = (int *)malloc(ht->capacity * sizeof(int));
+	memcpy(ht->buckets, infoPage + sizeof(HashInfo), count * sizeof(int));
+
+	for (int page = ht->info.dirPage, done = count; done < n; done += count) {
+		RC rc = pinPage(ht->bm, &ph, page);
+		if (rc != RC_OK) return rc;
+		int *dir = (int *)ph.data;
+		count = n - done < PAGE_DIR_ENTRIES ? n - done : PAGE_DIR_ENTRIES;
+		memcpy(ht->buckets + done, dir + 1, count * sizeof(int));
+		page = dir[0];
+		unpinPage(ht->bm, &ph);
+	}
+	return RC_OK;
+}
+
+// Pins the directory page *link names, chaining a new one if *link is -1
+static RC pinDirPage(HashManager *ht, int *link, BM_PageHandle *ph) {
+	RC rc;
+	if (*link >= 0) {
+		rc = pinPage(ht->bm, ph, *link);
+		if (rc == RC_OK) beginPageWrite(ht->bm, ph);
+		return rc;
+	}
+	rc = allocPage(ht, ph);
+	if (rc != RC_OK) return rc;
+	((int *)ph->data)[0] = -1;
+	*link = ph->pageNum;
+	return RC_OK;
+}
+
+// Writes the directory and then the info, which chaining directory pages
+// may have changed
+static RC saveInfo(HashManager *ht) {
+	BM_PageHandle ph, dirPh;
+	int n = numBuckets(ht);
+	int *link = &ht->info.dirPage;
+	bool pinned = false;
+	RC rc;
+
+	for (int done = INFO_DIR_ENTRIES; done < n; done += PAGE_DIR_ENTRIES) {
+		rc = pinDirPage(ht, link, &dirPh);
+		if (pinned) {
+			markDirty(ht->bm, &ph);
+			unpinPage(ht->bm, &ph);
+		}
+		if (rc != RC_OK) return rc;
+		ph = dirPh;
+		pinned = true;
+		int *dir = (int *)ph.data;
+		int count = n - done < PAGE_DIR_ENTRIES ? n - done : PAGE_DIR_ENTRIES;
+		memcpy(dir + 1, ht->buckets + done, count * sizeof(int));
+		link = dir;
+	}
+	if (pinned) {
+		markDirty(ht->bm, &ph);
+		unpinPage(ht->bm, &ph);
+	}
+
+	rc = pinPage(ht->bm, &ph, INFO_PAGE);
+	if (rc != RC_OK) return rc;
+	beginPageWrite(ht->bm, &ph);
+	memcpy(ph.data, &ht->info, sizeof(HashInfo));
+	memcpy(ph.data + sizeof(HashInfo), ht->buckets, (n < INFO_DIR_ENTRIES ? n : INFO_DIR_ENTRIES) * sizeof(int));
+	markDirty(ht->bm, &ph);
+	return unpinPage(ht->bm, &ph);
+}
+
+// Finds the first entry in entry's bucket whose leading length bytes match
+// (the key alone, or the whole entry). prev is the page chained before it,
+// or -1 on the primary page.
+static RC findEntry(HashManager *ht, const char *entry, int length, int *page, int *prev, int *pos) {
+	BM_PageHandle ph;
+	*prev = -1;
+	*page = ht->buckets[bucketOf(ht, entry)];
+	while (*page >= 0) {
+		RC rc = pinPage(ht->bm, &ph, *page);
+		if (rc != RC_OK) return rc;
+		BucketHeader *header = bucketHeader(ph.data);
+		for (*pos = 0; *pos < header->numEntries; (*pos)++) {
+			if (memcmp(bucketEntry(ht, ph.data, *pos), entry, length) == 0)
+				return unpinPage(ht->bm, &ph);
+		}
+		*prev = *page;
+		*page = header->next;
+		unpinPage(ht->bm, &ph);
+	}
+	THROW(RC_IM_KEY_NOT_FOUND, "Key not found");
+}
+
+// Stores entry in the first page of the bucket with room, chaining an
+// overflow page when all are full
+static RC addEntry(HashManager *ht, int bucket, const char *entry) {
+	BM_PageHandle ph, newPh;
+	int page = ht->buckets[bucket];
+	RC rc;
+
+	for (;;) {
+		rc = pinPage(ht->bm, &ph, page);
+		if (rc != RC_OK) return rc;
+		BucketHeader *header = bucketHeader(ph.data);
+		if (header->numEntries < ht->entriesPerPage) {
+			beginPageWrite(ht->bm, &ph);
+			memcpy(bucketEntry(ht, ph.data, header->numEntries++), entry, ht->entrySize);
+			markDirty(ht->bm, &ph);
+			return unpinPage(ht->bm, &ph);
+		}
+		if (header->next < 0) break;
+		page = header->next;
+		unpinPage(ht->bm, &ph);
+	}
+
+	rc = allocPage(ht, &newPh);
+	if (rc != RC_OK) {
+		unpinPage(ht->bm, &ph);
+		return rc;
+	}
+	memcpy(bucketEntry(ht, newPh.data, 0), entry, ht->entrySize);
+	bucketHeader(newPh.data)->numEntries = 1;
+	markDirty(ht->bm, &newPh);
+	unpinPage(ht->bm, &newPh);
+
+	beginPageWrite(ht->bm, &ph);
+	bucketHeader(ph.data)->next = newPh.pageNum;
+	markDirty(ht->bm, &ph);
+	return unpinPage(ht->bm, &ph);
+}
+
+// Splits bucket split into itself and a new bucket split + 2^level,
+// moving each entry by the next hash bit
+static RC splitBucket(HashManager *ht) {
+	BM_PageHandle ph;
+	int from = ht->info.split;
+	int count = 0, capacity = ht->entriesPerPage;
+	char *entries = (char *)malloc(capacity * ht->entrySize);
+	RC rc = RC_OK;
+
+	// empty the chain into entries, keeping only the primary page
+	for (int page = ht->buckets[from]; page >= 0 && rc == RC_OK; ) {
+		rc = pinPage(ht->bm, &ph, page);
+		if (rc != RC_OK) break;
+		BucketHeader *header = bucketHeader(ph.data);
+		if (count + header->numEntries > capacity) {
+			capacity = 2 * (count + header->numEntries);
+			entries = (char *)realloc(entries, capacity * ht->entrySize);
+		}
+		memcpy(entries + count * ht->entrySize, bucketEntry(ht, ph.data, 0), header->numEntries * ht->entrySize);
+		count += header->numEntries;
+		int next = header->next;
+		if (page == ht->buckets[from]) {
+			beginPageWrite(ht->bm, &ph);
+			header->numEntries = 0;
+			header->next = -1;
+			markDirty(ht->bm, &ph);
+			unpinPage(ht->bm, &ph);
+		} else {
+			unpinPage(ht->bm, &ph);
+			rc = freePage(ht, page);
+		}
+		page = next;
+	}
+
+	if (rc == RC_OK) rc = allocPage(ht, &ph);
+	if (rc == RC_OK) {
+		markDirty(ht->bm, &ph);
+		unpinPage(ht->bm, &ph);
+		addBucket(ht, ph.pageNum);
+		if (++ht->info.split == (1 << ht->info.level)) {
+			ht->info.level++;
+			ht->info.split = 0;
+		}
+	}
+	for (int i = 0; i < count && rc == RC_OK; i++) {
+		char *entry = entries + i * ht->entrySize;
+		rc = addEntry(ht, bucketOf(ht, entry), entry);
+	}
+	free(entries);
+	return rc;
+}
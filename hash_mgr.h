@@ -0,0 +1,41 @@
+#ifndef HASH_MGR_H
+#define HASH_MGR_H
+
+#include "dberror.h"
+#include "tables.h"
+
+// structure for accessing hash indexes
+typedef struct HashHandle {
+	DataType keyType;
+	char *idxId;
+	void *mgmtData;
+} HashHandle;
+
+typedef struct HT_ScanHandle {
+	HashHandle *index;
+	void *mgmtData;
+} HT_ScanHandle;
+
+// create, destroy, open, and close a linear hash index. keyLength is the
+// width of DT_STRING keys (other types ignore it). A key may map to several
+// RIDs; only an identical (key, RID) pair is rejected.
+extern RC createHashIndex (char *idxId, DataType keyType, int keyLength);
+extern RC openHashIndex (HashHandle **index, char *idxId);
+extern RC closeHashIndex (HashHandle *index);
+extern RC deleteHashIndex (char *idxId);
+
+// access information about a hash index
+extern RC getNumHashEntries (HashHandle *index, int *result);
+extern RC getNumBuckets (HashHandle *index, int *result);
+
+// index access
+extern RC findHashKey (HashHandle *index, Value *key, RID *result);
+extern RC insertHashKey (HashHandle *index, Value *key, RID rid);
+// removes the entry for key that points at rid
+extern RC deleteHashKey (HashHandle *index, Value *key, RID rid);
+// returns the RIDs stored under key, in no particular order
+extern RC openHashScan (HashHandle *index, Value *key, HT_ScanHandle **handle);
+extern RC nextHashEntry (HT_ScanHandle *handle, RID *result);
+extern RC closeHashScan (HT_ScanHandle *handle);
+
+#endif // HASH_MGR_H
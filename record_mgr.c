@@ -1,15 +1,84 @@
 #include "record_mgr.h"
+#include "btree_mgr.h"
+#include "hash_mgr.h"
 #include "buffer_mgr.h"
 #include "storage_mgr.h"
+#include "slotted_page.h"
 #include "dberror.h"
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define SLOT_SIZE sizeof(int)
-#define PAGE_HEADER_SIZE (sizeof(int) * 3)
+// numSlots, freeSlots and two reserved ints, so the slot bitmap that
+// follows is 8-byte aligned
+#define PAGE_HEADER_SIZE (sizeof(int) * 4)
+#define SLOT_WORD_BITS 64
+#define MAX_SLOT_WORDS (PAGE_SIZE / SLOT_WORD_BITS)
 #define SCHEMA_PAGE 0
-#define FIRST_DATA_PAGE 1
+#define FSM_FIRST_PAGE 1
+#define FIRST_DATA_PAGE 2
+#define DEFAULT_POOL_SIZE 3
+#define TABLE_MAGIC 0x524D5442
+#define TABLE_FORMAT_VERSION 7
+#define TABLE_INFO_SIZE 64
+// slotted records are padded so a forwarding RID always fits in their place
+#define SP_MIN_RECORD ((int)sizeof(RID))
+// longest string key createTableWithIndex accepts for a table index
+#define MAX_INDEXED_KEY_SIZE 256
+#define MAX_KEY_RANGES 64
+
+// Zone maps: <table>.zone holds an entry per data page with the min and max
+// of every attribute over the rows stored there (strings by their first
+// ZONE_VALUE_SIZE bytes). Entries only widen; a zeroed entry means the page
+// has never held a row.
+#define ZONE_VALUE_SIZE 8
+#define ZONE_HEADER_SIZE 8
+#define ZONE_ATTR_SIZE (2 * ZONE_VALUE_SIZE)
+#define ZONE_POOL_SIZE 4
+
+// parallel scan workers claim this many consecutive pages at a time
+#define MORSEL_PAGES 16
+
+// room for a table name plus its longest file suffix, ".table"
+#define TABLE_FILE_NAME_SIZE(name) (strlen(name) + sizeof(".table"))
+
+// Free-space map: every FSM page holds a 2-bit category for each of the
+// FSM_ENTRIES_PER_PAGE data pages that follow it. A zeroed map page reads
+// as "every page full", so freshly appended map pages need no setup.
+#define FSM_BITS 2
+#define FSM_MASK ((1 << FSM_BITS) - 1)
+#define FSM_ENTRIES_PER_BYTE (8 / FSM_BITS)
+#define FSM_ENTRIES_PER_WORD (64 / FSM_BITS)
+#define FSM_ENTRIES_PER_PAGE (PAGE_SIZE * FSM_ENTRIES_PER_BYTE)
+#define FSM_GROUP_SIZE (FSM_ENTRIES_PER_PAGE + 1)
+#define FSM_FULL 0
+#define FSM_LOW 1
+#define FSM_HALF 2
+#define FSM_EMPTY 3
+
+// Table metadata kept at the start of SCHEMA_PAGE, ahead of the schema.
+// cleanShutdown is cleared on disk while the table is open, so a crashed
+// table is detected on the next open and its counts are rebuilt.
+typedef struct TableInfo {
+	int magic;
+	int formatVersion;
+	int numTuples;
+	int firstFreePage;
+	int numPages;
+	int cleanShutdown;
+	int pageFormat;
+	int indexKind;
+} TableInfo;
+
+// Where an attribute lives in a row and, for PAX pages, where its column
+// starts in the page
+typedef struct ColumnInfo {
+	int size;
+	int rowOffset;
+	int pageOffset;
+} ColumnInfo;
 
 typedef struct TableManager {
 	BM_BufferPool *bm;
@@ -17,47 +86,216 @@ typedef struct TableManager {
 	int firstFreePage;
 	Schema *schema;
 	int recordSize;
+	int slotsPerPage;
+	int recordsOffset;
+	int numPages;
+	RM_PageFormat format;
+	ColumnInfo *columns;
+	RM_IndexKind indexKind; // index on keyAttr; its handle below is open
+	BTreeHandle *btree;
+	HashHandle *hash;
+	int keyAttr;
+	BM_BufferPool *zones;   // NULL when an entry would not fit a page
+	int zoneSize;
+	int zonesPerPage;
+	int readAhead;
+	RM_WritePolicy writePolicy;
+	int writesSinceCheckpoint;
 } TableManager;
 
 typedef struct ScanManager {
 	int currentPage;
 	int currentSlot;
 	Expr *condition;
+	Predicate *pred;     // condition compiled, NULL if evalExpr runs it
 	int totalScanned;
+	int *condAttrs;      // distinct attributes the condition reads
+	int numCondAttrs;
+	bool useIndex;       // rids holds every row the condition can match
+	RID *rids;
+	int numRids;
+	int nextRid;
+	int *projAttrs;      // attributes next returns, NULL for whole rows
+	int *projOffsets;    // where each of them goes in a projected record
+	int numProjAttrs;
+	Schema *projSchema;
+	int outSize;         // size of the records next returns
+	char *row;           // full row scratch space for projected scans
 } ScanManager;
 
+// Shared state of a parallelScan. Workers copy each page out of the pool
+// and scan the copy. Resident pages are copied optimistically; poolLock is
+// only taken to pin and unpin a page that missed.
+typedef struct ParallelScan {
+	RM_TableData *rel;
+	Expr *cond;
+	int *condAttrs;
+	int numCondAttrs;
+	RM_ScanCallback callback;
+	void *callbackData;
+	pthread_mutex_t poolLock;   // guards the table's buffer pools
+	int nextMorsel;             // first page of the next unclaimed morsel
+	int stop;                   // set once a worker fails
+	RC rc;
+} ParallelScan;
+
+typedef struct ScanWorker {
+	ParallelScan *scan;
+	int worker;
+	pthread_t thread;
+	bool started;
+} ScanWorker;
+
+// A key interval; NULL bounds are open and point at the condition's constants
+typedef struct KeyRange {
+	Value *low;
+	Value *high;
+	bool lowInclusive;
+	bool highInclusive;
+} KeyRange;
+
 static int getRecordSizeHelper(Schema *schema);
+static RC typedAttr(Record *record, Schema *schema, int attrNum, DataType dt, char **attrData);
+static bool computeLayout(Schema *schema);
 static RC writeSchemaToPage(BM_BufferPool *bm, Schema *schema);
 static RC readSchemaFromPage(BM_BufferPool *bm, Schema **schema);
 static int calculateSlotsPerPage(int recordSize);
-static RC findFreeSlot(TableManager *tm, RID *rid);
-static RC markSlotAsUsed(BM_BufferPool *bm, RID *rid, int recordSize);
-static RC markSlotAsFree(BM_BufferPool *bm, RID *rid, int recordSize);
-static bool isSlotUsed(char *page, int slot, int recordSize);
-static char* getRecordDataPointer(char *page, int slot, int recordSize);
-static int getNextFreePage(char *page);
-static void setNextFreePage(char *page, int nextPage);
+static RC appendDataPage(TableManager *tm, int *page);
+static RC modifyWhere(RM_TableData *rel, Expr *cond, RM_RecordSetter setter, void *setterData);
+static int slotBitmapSize(int numSlots);
+static uint64_t *slotBitmap(char *page);
+static bool isSlotUsed(char *page, int slot);
+static int nextUsedSlot(char *page, int slot, int numSlots);
+static int nextSetBit(uint64_t *words, int bit, int limit);
+static uint64_t *selectRows(TableManager *tm, Predicate *pred, char *page, int first, uint64_t *selected);
+static char* getRecordDataPointer(TableManager *tm, char *page, int slot);
+static void finishWrite(TableManager *tm);
+static RC readTableInfo(BM_BufferPool *bm, TableInfo *info);
+static RC writeTableInfo(BM_BufferPool *bm, TableInfo *info);
+static RC saveTableInfo(TableManager *tm, bool clean);
+static RC recoverTableInfo(TableManager *tm, char *fileName);
+static bool isMapPage(int page);
+static bool isDataPage(TableManager *tm, int page);
+static int mapPageOf(int page);
+static int freeSpaceCategory(int numSlots, int freeSlots);
+static RC setFreeSpace(BM_BufferPool *bm, int page, int category);
+static int findPageWithRoom(BM_BufferPool *bm, int startPage, int numPages, int minCategory);
+static int nextDataPage(TableManager *tm, int page);
+static void initDataPage(char *page, RM_PageFormat format, int slotsPerPage);
+static int pageCategory(TableManager *tm, char *page);
+static int countTuples(TableManager *tm, char *page);
+static RC evalCondition(Expr *cond, Predicate *pred, Record *record, Schema *schema, bool *matches);
+static RC whereMatches(Expr *cond, Predicate *pred, Record *record, Schema *schema, bool *matches);
+static int getAttrSize(Schema *schema, int attrNum);
+static int maxEncodedSize(Schema *schema);
+static int encodeRecord(TableManager *tm, const char *row, char *out);
+static void decodeRecord(TableManager *tm, const char *in, char *row);
+static void finishPageWrite(TableManager *tm, BM_PageHandle *ph, int oldCategory);
+static RC pinPageWithRoom(TableManager *tm, int length, BM_PageHandle *ph);
+static RC pinSlottedRow(TableManager *tm, RID id, BM_PageHandle *ph, char **data, int *length);
+static RC readSlottedRow(TableManager *tm, BM_PageHandle *ph, char *data, int flags, char *row);
+static RC removeEntry(TableManager *tm, RID id);
+static RC insertFixed(TableManager *tm, Record **records, int numRecords, RID *rids, int *inserted);
+static RC insertSlotted(TableManager *tm, Record **records, int numRecords, RID *rids, int *inserted);
+static RC removeRecord(TableManager *tm, RID id, char *old);
+static RC replaceRecord(TableManager *tm, Record *record, char *old);
+static RC getSlotted(TableManager *tm, RID id, char *row);
+static RC deleteSlotted(TableManager *tm, RID id, char *old);
+static RC updateSlotted(TableManager *tm, Record *record, char *old);
+static RC nextSlotted(RM_ScanHandle *scan, Record *record);
+static RC modifyWhereSlotted(RM_TableData *rel, Expr *cond, Predicate *pred, RM_RecordSetter setter, void *setterData);
+static bool isValidFormat(int format);
+static int slotsForFormat(Schema *schema, RM_PageFormat format);
+static int layoutColumns(Schema *schema, int numSlots, ColumnInfo *columns);
+static void readRow(TableManager *tm, char *page, int slot, char *row);
+static void writeRow(TableManager *tm, char *page, int slot, const char *row);
+static void readColumns(TableManager *tm, char *page, int slot, char *row, int *attrs, int numAttrs);
+static void readKey(TableManager *tm, char *page, int slot, char *row);
+static void collectAttrs(Expr *expr, int *attrs, int *numAttrs);
+static RC nextPax(RM_ScanHandle *scan, Record *record);
+static bool isIndexable(Schema *schema);
+static RC createIndex(char *name, Schema *schema, RM_IndexKind kind);
+static RC openIndex(RM_TableData *rel, char *name, bool rebuild);
+static void rowKey(TableManager *tm, const char *row, Value *key, char *buf);
+static RC indexInsert(TableManager *tm, const char *row, RID id);
+static RC indexRemove(TableManager *tm, const char *row, RID id);
+static RC indexUpdate(TableManager *tm, const char *oldRow, const char *newRow, RID id);
+static int zoneEntrySize(Schema *schema);
+static RC openZones(RM_TableData *rel, char *name, bool rebuild);
+static void zoneValue(TableManager *tm, int attr, const char *row, char *value);
+static int compareZoneValues(DataType dt, const char *a, const char *b);
+static RC widenZone(TableManager *tm, int page, const char *row);
+static bool pageMayMatch(TableManager *tm, Expr *cond, int page);
+static bool entryMayMatch(TableManager *tm, Expr *cond, const char *entry);
+static bool zoneMayMatch(TableManager *tm, Expr *expr, const char *entry);
+static bool comparisonMayMatch(TableManager *tm, Operator *op, bool negated, const char *entry);
+static bool zoneAbove(DataType dt, const char *min, Value *cons, bool strict);
+static bool zoneBelow(DataType dt, const char *max, Value *cons, bool strict);
+static int candidatePage(TableManager *tm, ScanManager *sm);
+static int keyRanges(TableManager *tm, Expr *expr, KeyRange *ranges);
+static int comparisonRange(TableManager *tm, Operator *op, bool negated, KeyRange *ranges);
+static int compareKeyValues(Value *a, Value *b);
+static int compareLowBounds(const void *a, const void *b);
+static bool isEmptyRange(KeyRange *range);
+static bool intersectRanges(KeyRange *a, KeyRange *b, KeyRange *out);
+static int normalizeRanges(KeyRange *ranges, int numRanges);
+static bool indexServes(TableManager *tm, KeyRange *ranges, int numRanges);
+static RC collectRids(TableManager *tm, KeyRange *ranges, int numRanges, ScanManager *sm);
+static int compareRids(const void *a, const void *b);
+static RC nextIndexed(RM_ScanHandle *scan, Record *record);
+static RC nextFixed(RM_ScanHandle *scan, BM_PageHandle *ph, Record *view);
+static void projectSchema(Schema *schema, TableManager *tm, int *attrs, int numAttrs, ScanManager *sm);
+static void emitRow(TableManager *tm, ScanManager *sm, const char *row, char *out);
+static void emitPaxRow(TableManager *tm, ScanManager *sm, char *page, int slot, char *out);
+static RC batchFromPage(RM_ScanHandle *scan, char *page, RecordBatch *batch, int max);
+static void *scanWorker(void *arg);
+static RC copyPage(ParallelScan *ps, int page, char *copy, bool *mayMatch);
+static RC copyFromPool(ParallelScan *ps, BM_BufferPool *bm, int page, int offset, int length, char *dest);
+static RC scanPageCopy(ParallelScan *ps, Predicate *pred, int worker, int page, char *copy, Record *record);
+
+static const RM_Config builtinConfig = { DEFAULT_POOL_SIZE, RS_FIFO, NULL, 0, RM_WRITE_BACK };
+static RM_Config defaultConfig = { DEFAULT_POOL_SIZE, RS_FIFO, NULL, 0, RM_WRITE_BACK };
 
 RC initRecordManager(void *mgmtData) {
+	RM_Config *config = (RM_Config *)mgmtData;
+	if (config && config->numPages <= 0)
+		THROW(RC_FILE_HANDLE_NOT_INIT, "Buffer pool size must be positive");
+	defaultConfig = config ? *config : builtinConfig;
 	return RC_OK;
 }
 
 RC shutdownRecordManager() {
+	defaultConfig = builtinConfig;
 	return RC_OK;
 }
 
 RC createTable(char *name, Schema *schema) {
-	char fileName[256];
+	return createTableWithFormat(name, schema, RM_PAGE_FIXED);
+}
+
+RC createTableWithFormat(char *name, Schema *schema, RM_PageFormat format) {
+	return createTableWithIndex(name, schema, format, RM_INDEX_NONE);
+}
+
+RC createTableWithIndex(char *name, Schema *schema, RM_PageFormat format, RM_IndexKind index) {
+	char fileName[TABLE_FILE_NAME_SIZE(name)];
 	BM_BufferPool *bm;
-	BM_PageHandle *ph;
+	BM_PageHandle ph;
 	RC rc;
 	
-	sprintf(fileName, "%s.table", name);
+	if (!isValidFormat(format))
+		THROW(RC_RM_UNSUPPORTED_TABLE_FORMAT, "Unknown page format");
+	if (index != RM_INDEX_NONE && (!isIndexable(schema) || (index != RM_INDEX_BTREE && index != RM_INDEX_HASH)))
+		THROW(RC_IM_UNSUPPORTED_INDEX_FORMAT, "Schema needs a single key attribute to be indexed");
+	if (format == RM_PAGE_SLOTTED && maxEncodedSize(schema) > SP_USABLE_SIZE - (int)SP_ENTRY_SIZE)
+		THROW(RC_RM_RECORD_TOO_LARGE, "Record too large for page");
+	
+	snprintf(fileName, sizeof(fileName), "%s.table", name);
 	rc = createPageFile(fileName);
 	if (rc != RC_OK) return rc;
 	
 	bm = (BM_BufferPool *)malloc(sizeof(BM_BufferPool));
-	rc = initBufferPool(bm, fileName, 3, RS_FIFO, NULL);
+	rc = initBufferPool(bm, fileName, DEFAULT_POOL_SIZE, RS_FIFO, NULL);
 	if (rc != RC_OK) {
 		free(bm);
 		return rc;
@@ -70,55 +308,69 @@ RC createTable(char *name, Schema *schema) {
 		return rc;
 	}
 	
-	ph = (BM_PageHandle *)malloc(sizeof(BM_PageHandle));
-	rc = pinPage(bm, ph, FIRST_DATA_PAGE);
+	// the file grows over the first map page and the first data page
+	rc = ensurePoolCapacity(bm, FIRST_DATA_PAGE + 1);
+	if (rc == RC_OK) rc = pinPage(bm, &ph, FIRST_DATA_PAGE);
 	if (rc != RC_OK) {
-		SM_FileHandle fh;
-		openPageFile(fileName, &fh);
-		appendEmptyBlock(&fh);
-		closePageFile(&fh);
-		rc = pinPage(bm, ph, FIRST_DATA_PAGE);
-		if (rc != RC_OK) {
-			shutdownBufferPool(bm);
-			free(bm);
-			free(ph);
-			return rc;
-		}
+		shutdownBufferPool(bm);
+		free(bm);
+		return rc;
 	}
 	
-	int *header = (int *)ph->data;
-	header[0] = calculateSlotsPerPage(getRecordSizeHelper(schema));
-	header[1] = header[0];
-	header[2] = -1;
+	initDataPage(ph.data, format, slotsForFormat(schema, format));
+	markDirty(bm, &ph);
+	unpinPage(bm, &ph);
+	setFreeSpace(bm, FIRST_DATA_PAGE, FSM_EMPTY);
 	
-	markDirty(bm, ph);
-	unpinPage(bm, ph);
+	TableInfo info = { TABLE_MAGIC, TABLE_FORMAT_VERSION, 0, FIRST_DATA_PAGE, FIRST_DATA_PAGE + 1, 1, format, index };
+	rc = writeTableInfo(bm, &info);
 	shutdownBufferPool(bm);
 	free(bm);
-	free(ph);
 	
-	return RC_OK;
+	if (rc == RC_OK && zoneEntrySize(schema) <= PAGE_SIZE) {
+		snprintf(fileName, sizeof(fileName), "%s.zone", name);
+		rc = createPageFile(fileName);
+	}
+	if (rc == RC_OK && index != RM_INDEX_NONE)
+		rc = createIndex(name, schema, index);
+	return rc;
 }
 
 RC openTable(RM_TableData *rel, char *name) {
-	char fileName[256];
+	return openTableWithConfig(rel, name, NULL);
+}
+
+RC openTableWithConfig(RM_TableData *rel, char *name, RM_Config *config) {
+	char fileName[TABLE_FILE_NAME_SIZE(name)];
 	TableManager *tm;
 	BM_BufferPool *bm;
 	Schema *schema;
 	RC rc;
 	
-	sprintf(fileName, "%s.table", name);
+	if (!config) config = &defaultConfig;
+	if (config->numPages <= 0)
+		THROW(RC_FILE_HANDLE_NOT_INIT, "Buffer pool size must be positive");
+	
+	snprintf(fileName, sizeof(fileName), "%s.table", name);
 	tm = (TableManager *)malloc(sizeof(TableManager));
 	bm = (BM_BufferPool *)malloc(sizeof(BM_BufferPool));
 	
-	rc = initBufferPool(bm, fileName, 3, RS_FIFO, NULL);
+	rc = initBufferPool(bm, fileName, config->numPages, config->strategy, config->stratData);
 	if (rc != RC_OK) {
 		free(tm);
 		free(bm);
 		return rc;
 	}
 	
-	rc = readSchemaFromPage(bm, &schema);
+	TableInfo info;
+	rc = readTableInfo(bm, &info);
+	if (rc == RC_OK && (info.magic != TABLE_MAGIC || info.formatVersion != TABLE_FORMAT_VERSION
+			|| !isValidFormat(info.pageFormat))) {
+		RC_message = "Unsupported table format";
+		rc = RC_RM_UNSUPPORTED_TABLE_FORMAT;
+	}
+	if (rc == RC_OK)
+		rc = readSchemaFromPage(bm, &schema);
 	if (rc != RC_OK) {
 		shutdownBufferPool(bm);
 		free(tm);
@@ -129,30 +381,43 @@ RC openTable(RM_TableData *rel, char *name) {
 	tm->bm = bm;
 	tm->schema = schema;
 	tm->recordSize = getRecordSizeHelper(schema);
-	tm->numTuples = 0;
-	tm->firstFreePage = FIRST_DATA_PAGE;
+	tm->slotsPerPage = slotsForFormat(schema, info.pageFormat);
+	tm->recordsOffset = PAGE_HEADER_SIZE + slotBitmapSize(tm->slotsPerPage);
+	tm->numTuples = info.numTuples;
+	tm->firstFreePage = info.firstFreePage;
+	tm->numPages = info.numPages;
+	tm->format = info.pageFormat;
+	tm->columns = (ColumnInfo *)malloc(schema->numAttr * sizeof(ColumnInfo));
+	layoutColumns(schema, tm->slotsPerPage, tm->columns);
+	tm->indexKind = info.indexKind;
+	tm->btree = NULL;
+	tm->hash = NULL;
+	tm->zones = NULL;
+	tm->zoneSize = zoneEntrySize(schema);
+	tm->zonesPerPage = PAGE_SIZE / tm->zoneSize;
+	tm->keyAttr = schema->keySize > 0 ? schema->keyAttrs[0] : -1;
+	tm->readAhead = config->readAhead;
+	tm->writePolicy = config->writePolicy;
+	tm->writesSinceCheckpoint = 0;
 	
-	BM_PageHandle *ph = (BM_PageHandle *)malloc(sizeof(BM_PageHandle));
-	int page = FIRST_DATA_PAGE;
-	
-	while (page >= 0) {
-		rc = pinPage(bm, ph, page);
-		if (rc != RC_OK) break;
-		
-		int *header = (int *)ph->data;
-		tm->numTuples += (header[0] - header[1]);
-		if (header[1] > 0 && tm->firstFreePage == FIRST_DATA_PAGE && page == FIRST_DATA_PAGE)
-			tm->firstFreePage = page;
-		page = header[2];
-		
-		unpinPage(bm, ph);
+	if (!info.cleanShutdown)
+		rc = recoverTableInfo(tm, fileName);
+	if (rc == RC_OK)
+		rc = saveTableInfo(tm, false);
+	if (rc != RC_OK) {
+		freeSchema(schema);
+		shutdownBufferPool(bm);
+		free(tm->columns);
+		free(tm);
+		free(bm);
+		return rc;
 	}
-	free(ph);
 	
 	rel->name = (char *)malloc(strlen(name) + 1);
 	if (!rel->name) {
 		freeSchema(schema);
 		shutdownBufferPool(bm);
+		free(tm->columns);
 		free(tm);
 		free(bm);
 		THROW(RC_WRITE_FAILED, "Memory allocation failed");
@@ -161,16 +426,34 @@ RC openTable(RM_TableData *rel, char *name) {
 	rel->schema = schema;
 	rel->mgmtData = tm;
 	
+	// an index that was open during a crash may have missed changes
+	if (info.indexKind != RM_INDEX_NONE)
+		rc = openIndex(rel, name, !info.cleanShutdown);
+	if (rc == RC_OK && tm->zonesPerPage > 0)
+		rc = openZones(rel, name, !info.cleanShutdown);
+	if (rc != RC_OK) {
+		closeTable(rel);
+		return rc;
+	}
 	return RC_OK;
 }
 
 RC closeTable(RM_TableData *rel) {
 	if (!rel || !rel->mgmtData) THROW(RC_FILE_HANDLE_NOT_INIT, "Table not initialized");
 	TableManager *tm = (TableManager *)rel->mgmtData;
+	if (tm->btree) closeBtree(tm->btree);
+	if (tm->hash) closeHashIndex(tm->hash);
+	if (tm->zones) {
+		forceFlushPool(tm->zones);
+		shutdownBufferPool(tm->zones);
+		free(tm->zones);
+	}
+	saveTableInfo(tm, true);
 	forceFlushPool(tm->bm);
 	shutdownBufferPool(tm->bm);
 	free(tm->bm);
 	freeSchema(rel->schema);
+	free(tm->columns);
 	free(tm);
 	if (rel->name) { free(rel->name); rel->name = NULL; }
 	rel->mgmtData = NULL;
@@ -178,8 +461,16 @@ RC closeTable(RM_TableData *rel) {
 }
 
 RC deleteTable(char *name) {
-	char fileName[256];
-	sprintf(fileName, "%s.table", name);
+	char fileName[TABLE_FILE_NAME_SIZE(name)];
+	// the index and zone files are optional, whatever kind of index it is
+	snprintf(fileName, sizeof(fileName), "%s.idx", name);
+	discardWorkingSet(fileName);
+	destroyPageFile(fileName);
+	snprintf(fileName, sizeof(fileName), "%s.zone", name);
+	discardWorkingSet(fileName);
+	destroyPageFile(fileName);
+	snprintf(fileName, sizeof(fileName), "%s.table", name);
+	discardWorkingSet(fileName);
 	return destroyPageFile(fileName);
 }
 
@@ -188,213 +479,451 @@ int getNumTuples(RM_TableData *rel) {
 	return ((TableManager *)rel->mgmtData)->numTuples;
 }
 
+BM_BufferPool *getTableBufferPool(RM_TableData *rel) {
+	if (!rel || !rel->mgmtData) return NULL;
+	return ((TableManager *)rel->mgmtData)->bm;
+}
+
 RC insertRecord(RM_TableData *rel, Record *record) {
+	return insertRecords(rel, &record, 1, NULL);
+}
+
+RC insertRecords(RM_TableData *rel, Record **records, int numRecords, RID *rids) {
+	if (!rel || !rel->mgmtData || (numRecords > 0 && !records))
+		THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
 	TableManager *tm = (TableManager *)rel->mgmtData;
-	BM_PageHandle *ph;
-	RID rid;
+	int done = 0;
 	RC rc;
-	char *recordPos;
 	
-	rc = findFreeSlot(tm, &rid);
-	if (rc != RC_OK) return rc;
+	if (tm->format == RM_PAGE_SLOTTED)
+		rc = insertSlotted(tm, records, numRecords, rids, &done);
+	else
+		rc = insertFixed(tm, records, numRecords, rids, &done);
 	
-	ph = (BM_PageHandle *)malloc(sizeof(BM_PageHandle));
-	rc = pinPage(tm->bm, ph, rid.page);
-	if (rc != RC_OK) {
-		free(ph);
-		return rc;
+	for (int i = 0; i < done; i++) {
+		RC indexRc = widenZone(tm, records[i]->id.page, records[i]->data);
+		if (indexRc == RC_OK) indexRc = indexInsert(tm, records[i]->data, records[i]->id);
+		if (rc == RC_OK) rc = indexRc;
 	}
-	
-	recordPos = getRecordDataPointer(ph->data, rid.slot, tm->recordSize);
-	memcpy(recordPos, record->data, tm->recordSize);
-	markSlotAsUsed(tm->bm, &rid, tm->recordSize);
-	record->id = rid;
-	markDirty(tm->bm, ph);
-	unpinPage(tm->bm, ph);
-	free(ph);
-	tm->numTuples++;
-	return RC_OK;
+	if (done > 0) finishWrite(tm);
+	return rc;
 }
 
+// The index entry is keyed by the row's contents: removeRecord and
+// replaceRecord copy the old key out of the page they already hold pinned
 RC deleteRecord(RM_TableData *rel, RID id) {
 	TableManager *tm = (TableManager *)rel->mgmtData;
-	BM_PageHandle *ph;
+	char old[PAGE_SIZE];
+	RC rc = removeRecord(tm, id, tm->indexKind != RM_INDEX_NONE ? old : NULL);
+	if (rc != RC_OK) return rc;
+	return indexRemove(tm, old, id);
+}
+
+RC updateRecord(RM_TableData *rel, Record *record) {
+	TableManager *tm = (TableManager *)rel->mgmtData;
+	char old[PAGE_SIZE];
+	RC rc = replaceRecord(tm, record, tm->indexKind != RM_INDEX_NONE ? old : NULL);
+	if (rc == RC_OK) rc = widenZone(tm, record->id.page, record->data);
+	if (rc != RC_OK) return rc;
+	return indexUpdate(tm, old, record->data, record->id);
+}
+
+// When old is not NULL, the key of the deleted row is copied into it
+static RC removeRecord(TableManager *tm, RID id, char *old) {
+	BM_PageHandle ph;
 	RC rc;
 	
-	ph = (BM_PageHandle *)malloc(sizeof(BM_PageHandle));
-	rc = pinPage(tm->bm, ph, id.page);
-	if (rc != RC_OK) {
-		free(ph);
+	if (!isDataPage(tm, id.page))
+		THROW(RC_FILE_NOT_FOUND, "Record not found");
+	if (tm->format == RM_PAGE_SLOTTED) {
+		rc = deleteSlotted(tm, id, old);
+		if (rc == RC_OK) finishWrite(tm);
 		return rc;
 	}
 	
-	if (!isSlotUsed(ph->data, id.slot, tm->recordSize)) {
-		unpinPage(tm->bm, ph);
-		free(ph);
+	if (id.slot < 0 || id.slot >= tm->slotsPerPage)
 		THROW(RC_FILE_NOT_FOUND, "Record not found");
-	}
+	rc = pinPage(tm->bm, &ph, id.page);
+	if (rc != RC_OK) return rc;
 	
-	markSlotAsFree(tm->bm, &id, tm->recordSize);
-	if (getNextFreePage(ph->data) == -1) {
-		BM_PageHandle *infoPh = (BM_PageHandle *)malloc(sizeof(BM_PageHandle));
-		rc = pinPage(tm->bm, infoPh, SCHEMA_PAGE);
-		if (rc == RC_OK) {
-			int *infoHeader = (int *)infoPh->data;
-			setNextFreePage(ph->data, tm->firstFreePage);
-			tm->firstFreePage = id.page;
-			markDirty(tm->bm, infoPh);
-			unpinPage(tm->bm, infoPh);
-		}
-		free(infoPh);
+	if (!isSlotUsed(ph.data, id.slot)) {
+		unpinPage(tm->bm, &ph);
+		THROW(RC_FILE_NOT_FOUND, "Record not found");
 	}
 	
-	markDirty(tm->bm, ph);
-	unpinPage(tm->bm, ph);
-	free(ph);
+	if (old) readKey(tm, ph.data, id.slot, old);
+	int *header = (int *)ph.data;
+	beginPageWrite(tm->bm, &ph);
+	slotBitmap(ph.data)[id.slot / SLOT_WORD_BITS] &= ~(1ULL << (id.slot % SLOT_WORD_BITS));
+	header[1]++;
+	if (freeSpaceCategory(header[0], header[1]) != freeSpaceCategory(header[0], header[1] - 1))
+		setFreeSpace(tm->bm, id.page, freeSpaceCategory(header[0], header[1]));
+	if (id.page < tm->firstFreePage)
+		tm->firstFreePage = id.page;
+	
+	markDirty(tm->bm, &ph);
+	unpinPage(tm->bm, &ph);
 	tm->numTuples--;
+	finishWrite(tm);
 	return RC_OK;
 }
 
-RC updateRecord(RM_TableData *rel, Record *record) {
-	TableManager *tm = (TableManager *)rel->mgmtData;
-	BM_PageHandle *ph;
+// When old is not NULL, the key the row had before is copied into it
+static RC replaceRecord(TableManager *tm, Record *record, char *old) {
+	BM_PageHandle ph;
 	RC rc;
-	char *recordPos;
 	
-	ph = (BM_PageHandle *)malloc(sizeof(BM_PageHandle));
-	rc = pinPage(tm->bm, ph, record->id.page);
-	if (rc != RC_OK) {
-		free(ph);
+	if (!isDataPage(tm, record->id.page))
+		THROW(RC_FILE_NOT_FOUND, "Record not found");
+	if (tm->format == RM_PAGE_SLOTTED) {
+		rc = updateSlotted(tm, record, old);
+		if (rc == RC_OK) finishWrite(tm);
 		return rc;
 	}
 	
-	if (!isSlotUsed(ph->data, record->id.slot, tm->recordSize)) {
-		unpinPage(tm->bm, ph);
-		free(ph);
+	if (record->id.slot < 0 || record->id.slot >= tm->slotsPerPage)
+		THROW(RC_FILE_NOT_FOUND, "Record not found");
+	rc = pinPage(tm->bm, &ph, record->id.page);
+	if (rc != RC_OK) return rc;
+	
+	if (!isSlotUsed(ph.data, record->id.slot)) {
+		unpinPage(tm->bm, &ph);
 		THROW(RC_FILE_NOT_FOUND, "Record not found");
 	}
 	
-	recordPos = getRecordDataPointer(ph->data, record->id.slot, tm->recordSize);
-	memcpy(recordPos, record->data, tm->recordSize);
-	markDirty(tm->bm, ph);
-	unpinPage(tm->bm, ph);
-	free(ph);
+	if (old) readKey(tm, ph.data, record->id.slot, old);
+	beginPageWrite(tm->bm, &ph);
+	writeRow(tm, ph.data, record->id.slot, record->data);
+	markDirty(tm->bm, &ph);
+	unpinPage(tm->bm, &ph);
+	finishWrite(tm);
 	return RC_OK;
 }
 
+RC deleteWhere(RM_TableData *rel, Expr *cond) {
+	return modifyWhere(rel, cond, NULL, NULL);
+}
+
+RC updateWhere(RM_TableData *rel, Expr *cond, RM_RecordSetter setter, void *setterData) {
+	if (!setter) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	return modifyWhere(rel, cond, setter, setterData);
+}
+
 RC getRecord(RM_TableData *rel, RID id, Record *record) {
 	TableManager *tm = (TableManager *)rel->mgmtData;
-	BM_PageHandle *ph;
+	uint64_t slotWord;
 	RC rc;
-	char *recordPos;
 	
-	ph = (BM_PageHandle *)malloc(sizeof(BM_PageHandle));
-	rc = pinPage(tm->bm, ph, id.page);
-	if (rc != RC_OK) {
-		free(ph);
+	if (!isDataPage(tm, id.page))
+		THROW(RC_FILE_NOT_FOUND, "Record not found");
+	if (tm->format == RM_PAGE_SLOTTED) {
+		if (!record->data) record->data = (char *)malloc(tm->recordSize);
+		rc = getSlotted(tm, id, record->data);
+		if (rc == RC_OK) record->id = id;
 		return rc;
 	}
 	
-	if (!isSlotUsed(ph->data, id.slot, tm->recordSize)) {
-		unpinPage(tm->bm, ph);
-		free(ph);
+	if (id.slot < 0 || id.slot >= tm->slotsPerPage)
 		THROW(RC_FILE_NOT_FOUND, "Record not found");
+	
+	if (tm->format == RM_PAGE_PAX) {
+		BM_PageHandle ph;
+		rc = pinPage(tm->bm, &ph, id.page);
+		if (rc != RC_OK) return rc;
+		if (!isSlotUsed(ph.data, id.slot)) {
+			unpinPage(tm->bm, &ph);
+			THROW(RC_FILE_NOT_FOUND, "Record not found");
+		}
+		record->id = id;
+		if (!record->data) record->data = (char *)malloc(tm->recordSize);
+		readRow(tm, ph.data, id.slot, record->data);
+		return unpinPage(tm->bm, &ph);
 	}
 	
-	recordPos = getRecordDataPointer(ph->data, id.slot, tm->recordSize);
+	// the bitmap word is checked first; a delete racing with the row copy
+	// still returns a row that was live at the RID when the bit was read
+	rc = readPageOptimistic(tm->bm, id.page, PAGE_HEADER_SIZE + (id.slot / SLOT_WORD_BITS) * sizeof(uint64_t),
+			sizeof(uint64_t), (char *)&slotWord);
+	if (rc != RC_OK) return rc;
+	if (!((slotWord >> (id.slot % SLOT_WORD_BITS)) & 1))
+		THROW(RC_FILE_NOT_FOUND, "Record not found");
+	
 	record->id = id;
 	if (!record->data) record->data = (char *)malloc(tm->recordSize);
-	memcpy(record->data, recordPos, tm->recordSize);
-	unpinPage(tm->bm, ph);
-	free(ph);
+	return readPageOptimistic(tm->bm, id.page, tm->recordsOffset + id.slot * tm->recordSize, tm->recordSize, record->data);
+}
+
+RC getRecordView(RM_TableData *rel, RID id, RM_RecordView *view) {
+	TableManager *tm = (TableManager *)rel->mgmtData;
+	RC rc;
+	
+	view->rel = rel;
+	view->pinned = false;
+	view->buffer = NULL;
+	if (!isDataPage(tm, id.page))
+		THROW(RC_FILE_NOT_FOUND, "Record not found");
+	if (tm->format != RM_PAGE_FIXED) {
+		view->record.data = view->buffer = (char *)malloc(tm->recordSize);
+		rc = getRecord(rel, id, &view->record);
+		if (rc != RC_OK) releaseRecordView(view);
+		return rc;
+	}
+	
+	if (id.slot < 0 || id.slot >= tm->slotsPerPage)
+		THROW(RC_FILE_NOT_FOUND, "Record not found");
+	rc = pinPage(tm->bm, &view->page, id.page);
+	if (rc != RC_OK) return rc;
+	if (!isSlotUsed(view->page.data, id.slot)) {
+		unpinPage(tm->bm, &view->page);
+		THROW(RC_FILE_NOT_FOUND, "Record not found");
+	}
+	view->pinned = true;
+	view->record.id = id;
+	view->record.data = getRecordDataPointer(tm, view->page.data, id.slot);
 	return RC_OK;
 }
 
+RC releaseRecordView(RM_RecordView *view) {
+	if (!view || !view->rel) THROW(RC_FILE_HANDLE_NOT_INIT, "View not initialized");
+	RC rc = RC_OK;
+	if (view->pinned)
+		rc = unpinPage(((TableManager *)view->rel->mgmtData)->bm, &view->page);
+	free(view->buffer);
+	view->pinned = false;
+	view->buffer = NULL;
+	view->record.data = NULL;
+	return rc;
+}
+
 RC startScan(RM_TableData *rel, RM_ScanHandle *scan, Expr *cond) {
+	return startScanWithProjection(rel, scan, cond, NULL, 0);
+}
+
+RC startScanWithProjection(RM_TableData *rel, RM_ScanHandle *scan, Expr *cond, int *attrs, int numAttrs) {
+	TableManager *tm = (TableManager *)rel->mgmtData;
+	if (attrs && numAttrs < 1) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	for (int i = 0; attrs && i < numAttrs; i++)
+		if (attrs[i] < 0 || attrs[i] >= rel->schema->numAttr)
+			THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	
 	ScanManager *sm = (ScanManager *)malloc(sizeof(ScanManager));
 	sm->currentPage = FIRST_DATA_PAGE;
 	sm->currentSlot = 0;
 	sm->condition = cond;
+	sm->pred = NULL;
+	if (cond) compilePredicate(cond, rel->schema, &sm->pred);
 	sm->totalScanned = 0;
+	sm->condAttrs = NULL;
+	sm->numCondAttrs = 0;
+	sm->useIndex = false;
+	sm->rids = NULL;
+	sm->numRids = 0;
+	sm->nextRid = 0;
+	sm->projAttrs = NULL;
+	sm->projOffsets = NULL;
+	sm->numProjAttrs = 0;
+	sm->projSchema = NULL;
+	sm->outSize = tm->recordSize;
+	sm->row = NULL;
+	if (cond && tm->format == RM_PAGE_PAX) {
+		sm->condAttrs = (int *)malloc(rel->schema->numAttr * sizeof(int));
+		collectAttrs(cond, sm->condAttrs, &sm->numCondAttrs);
+	}
+	if (attrs)
+		projectSchema(rel->schema, tm, attrs, numAttrs, sm);
 	scan->rel = rel;
 	scan->mgmtData = sm;
+	
+	// a condition that bounds the key is answered from the index; the whole
+	// condition is still checked on every row fetched
+	if (cond && tm->indexKind != RM_INDEX_NONE) {
+		KeyRange ranges[MAX_KEY_RANGES];
+		int numRanges = keyRanges(tm, cond, ranges);
+		if (indexServes(tm, ranges, numRanges)) {
+			RC rc = collectRids(tm, ranges, numRanges, sm);
+			if (rc != RC_OK) {
+				closeScan(scan);
+				return rc;
+			}
+			sm->useIndex = true;
+			return RC_OK;
+		}
+	}
+	if (tm->readAhead > 0)
+		prefetchPages(tm->bm, FIRST_DATA_PAGE, tm->readAhead);
 	return RC_OK;
 }
 
 RC next(RM_ScanHandle *scan, Record *record) {
 	ScanManager *sm = (ScanManager *)scan->mgmtData;
 	TableManager *tm = (TableManager *)scan->rel->mgmtData;
-	BM_PageHandle *ph;
+	BM_PageHandle ph;
+	Record view;
+	
+	if (sm->useIndex) return nextIndexed(scan, record);
+	if (tm->format == RM_PAGE_SLOTTED) return nextSlotted(scan, record);
+	if (tm->format == RM_PAGE_PAX) return nextPax(scan, record);
+	
+	RC rc = nextFixed(scan, &ph, &view);
+	if (rc != RC_OK) return rc;
+	record->id = view.id;
+	if (!record->data) record->data = (char *)malloc(sm->outSize);
+	emitRow(tm, sm, view.data, record->data);
+	return unpinPage(tm->bm, &ph);
+}
+
+RC nextView(RM_ScanHandle *scan, RM_RecordView *view) {
+	ScanManager *sm = (ScanManager *)scan->mgmtData;
+	TableManager *tm = (TableManager *)scan->rel->mgmtData;
+	RC rc;
+	
+	view->rel = scan->rel;
+	view->pinned = false;
+	view->buffer = NULL;
+	if (sm->useIndex || tm->format != RM_PAGE_FIXED || sm->projAttrs) {
+		view->record.data = view->buffer = (char *)malloc(sm->outSize);
+		rc = next(scan, &view->record);
+	} else {
+		rc = nextFixed(scan, &view->page, &view->record);
+		view->pinned = rc == RC_OK;
+	}
+	if (rc != RC_OK) releaseRecordView(view);
+	return rc;
+}
+
+RC nextBatch(RM_ScanHandle *scan, RecordBatch *batch, int max) {
+	if (!scan || !scan->mgmtData || !batch || max < 1) THROW(RC_FILE_HANDLE_NOT_INIT, "Scan not initialized");
+	ScanManager *sm = (ScanManager *)scan->mgmtData;
+	TableManager *tm = (TableManager *)scan->rel->mgmtData;
+	BM_PageHandle ph;
+	Record record;
 	RC rc;
-	Value *result;
-	int slotsPerPage = calculateSlotsPerPage(tm->recordSize);
 	
-	ph = (BM_PageHandle *)malloc(sizeof(BM_PageHandle));
+	if (max > batch->capacity) max = batch->capacity;
+	batch->numRecords = 0;
 	
-	while (sm->currentPage >= 0) {
-		rc = pinPage(tm->bm, ph, sm->currentPage);
+	// index scans fetch each RID on its own page anyway, and projected rows
+	// are filled one at a time
+	if (sm->useIndex || sm->projAttrs) {
+		while (batch->numRecords < max) {
+			record.data = batch->data + batch->numRecords * sm->outSize;
+			rc = next(scan, &record);
+			if (rc == RC_RM_NO_MORE_TUPLES) break;
+			if (rc != RC_OK) return rc;
+			batch->ids[batch->numRecords++] = record.id;
+		}
+	}
+	
+	while (!sm->useIndex && !sm->projAttrs && batch->numRecords < max && (sm->currentPage = candidatePage(tm, sm)) >= 0) {
+		rc = pinPage(tm->bm, &ph, sm->currentPage);
+		// the page is retried by the next call once the rows so far are out
+		if (rc != RC_OK && batch->numRecords > 0) break;
+		if (rc != RC_OK) return rc;
+		rc = batchFromPage(scan, ph.data, batch, max);
 		if (rc != RC_OK) {
-			free(ph);
-			THROW(RC_RM_NO_MORE_TUPLES, "No more tuples");
+			unpinPage(tm->bm, &ph);
+			return rc;
 		}
 		
-		int *header = (int *)ph->data;
-		int numSlots = header[0];
-		
-		while (sm->currentSlot < numSlots) {
-			if (isSlotUsed(ph->data, sm->currentSlot, tm->recordSize)) {
-				RID rid = {sm->currentPage, sm->currentSlot};
-				char *recordPos = getRecordDataPointer(ph->data, sm->currentSlot, tm->recordSize);
-				record->id = rid;
-				if (!record->data) record->data = (char *)malloc(tm->recordSize);
-				memcpy(record->data, recordPos, tm->recordSize);
-				
-				bool matches = true;
-				if (sm->condition) {
-					rc = evalExpr(record, scan->rel->schema, sm->condition, &result);
-					if (rc != RC_OK) {
-						unpinPage(tm->bm, ph);
-						free(ph);
-						return rc;
-					}
-					if (result && result->dt == DT_BOOL) {
-						matches = result->v.boolV;
-						freeVal(result);
-					}
-				}
-				
-				sm->currentSlot++;
-				if (matches) {
-					unpinPage(tm->bm, ph);
-					free(ph);
-					return RC_OK;
-				}
-			} else {
-				sm->currentSlot++;
-			}
+		// a full batch may leave rows on this page for the next call
+		if (batch->numRecords < max) {
+			sm->currentPage = nextDataPage(tm, sm->currentPage);
+			sm->currentSlot = 0;
 		}
-		
-		sm->currentPage = header[2];
-		sm->currentSlot = 0;
-		unpinPage(tm->bm, ph);
+		unpinPage(tm->bm, &ph);
+		if (tm->readAhead > 0 && sm->currentSlot == 0 && sm->currentPage >= 0)
+			prefetchPages(tm->bm, sm->currentPage, tm->readAhead);
 	}
 	
-	free(ph);
-	THROW(RC_RM_NO_MORE_TUPLES, "No more tuples");
+	if (batch->numRecords == 0) THROW(RC_RM_NO_MORE_TUPLES, "No more tuples");
+	return RC_OK;
+}
+
+Schema *getScanSchema(RM_ScanHandle *scan) {
+	ScanManager *sm = (ScanManager *)scan->mgmtData;
+	return sm->projSchema ? sm->projSchema : scan->rel->schema;
 }
 
 RC closeScan(RM_ScanHandle *scan) {
 	if (!scan || !scan->mgmtData) THROW(RC_FILE_HANDLE_NOT_INIT, "Scan not initialized");
+	free(((ScanManager *)scan->mgmtData)->condAttrs);
+	freePredicate(((ScanManager *)scan->mgmtData)->pred);
+	free(((ScanManager *)scan->mgmtData)->rids);
+	free(((ScanManager *)scan->mgmtData)->projAttrs);
+	free(((ScanManager *)scan->mgmtData)->projOffsets);
+	free(((ScanManager *)scan->mgmtData)->row);
+	freeSchema(((ScanManager *)scan->mgmtData)->projSchema);
 	free(scan->mgmtData);
 	scan->mgmtData = NULL;
 	return RC_OK;
 }
 
+RC parallelScan(RM_TableData *rel, Expr *cond, int numThreads, RM_ScanCallback callback, void *callbackData) {
+	if (!rel || !rel->mgmtData || !callback || numThreads < 1)
+		THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	TableManager *tm = (TableManager *)rel->mgmtData;
+	ParallelScan ps;
+	ps.rel = rel;
+	ps.cond = cond;
+	ps.condAttrs = NULL;
+	ps.numCondAttrs = 0;
+	ps.callback = callback;
+	ps.callbackData = callbackData;
+	ps.nextMorsel = FIRST_DATA_PAGE;
+	ps.stop = 0;
+	ps.rc = RC_OK;
+	if (cond && tm->format == RM_PAGE_PAX) {
+		ps.condAttrs = (int *)malloc(rel->schema->numAttr * sizeof(int));
+		collectAttrs(cond, ps.condAttrs, &ps.numCondAttrs);
+	}
+	pthread_mutex_init(&ps.poolLock, NULL);
+	
+	// worker 0 is the calling thread; if a thread cannot be started the
+	// others take its morsels
+	ScanWorker *workers = (ScanWorker *)malloc(numThreads * sizeof(ScanWorker));
+	for (int i = 0; i < numThreads; i++) {
+		workers[i].scan = &ps;
+		workers[i].worker = i;
+	}
+	for (int i = 1; i < numThreads; i++)
+		workers[i].started = pthread_create(&workers[i].thread, NULL, scanWorker, &workers[i]) == 0;
+	scanWorker(&workers[0]);
+	for (int i = 1; i < numThreads; i++)
+		if (workers[i].started) pthread_join(workers[i].thread, NULL);
+	
+	pthread_mutex_destroy(&ps.poolLock);
+	free(workers);
+	free(ps.condAttrs);
+	return ps.rc;
+}
+
+RC createRecordBatch(RecordBatch **batch, Schema *schema, int capacity) {
+	if (!batch || !schema || capacity < 1) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	*batch = (RecordBatch *)malloc(sizeof(RecordBatch));
+	(*batch)->capacity = capacity;
+	(*batch)->numRecords = 0;
+	(*batch)->ids = (RID *)malloc(capacity * sizeof(RID));
+	(*batch)->data = (char *)malloc((size_t)capacity * getRecordSizeHelper(schema));
+	return RC_OK;
+}
+
+RC freeRecordBatch(RecordBatch *batch) {
+	if (!batch) return RC_OK;
+	free(batch->ids);
+	free(batch->data);
+	free(batch);
+	return RC_OK;
+}
+
 int getRecordSize(Schema *schema) {
 	return getRecordSizeHelper(schema);
 }
 
 Schema *createSchema(int numAttr, char **attrNames, DataType *dataTypes, int *typeLength, int keySize, int *keys) {
+	return createSchemaWithLayout(numAttr, attrNames, dataTypes, typeLength, keySize, keys, LAYOUT_PACKED);
+}
+
+Schema *createSchemaWithLayout(int numAttr, char **attrNames, DataType *dataTypes, int *typeLength, int keySize, int *keys, RecordLayout layout) {
 	Schema *schema = (Schema *)malloc(sizeof(Schema));
 	if (!schema) return NULL;
 	
@@ -424,6 +953,11 @@ Schema *createSchema(int numAttr, char **attrNames, DataType *dataTypes, int *ty
 	for (int i = 0; i < keySize; i++)
 		schema->keyAttrs[i] = keys[i];
 	
+	schema->layout = layout;
+	if (!computeLayout(schema)) {
+		freeSchema(schema);
+		return NULL;
+	}
 	return schema;
 }
 
@@ -437,6 +971,8 @@ RC freeSchema(Schema *schema) {
 	if (schema->dataTypes) free(schema->dataTypes);
 	if (schema->typeLength) free(schema->typeLength);
 	if (schema->keyAttrs) free(schema->keyAttrs);
+	free(schema->attrOffsets);
+	free(schema->attrSizes);
 	free(schema);
 	return RC_OK;
 }
@@ -467,15 +1003,7 @@ RC freeRecord(Record *record) {
 RC getAttr(Record *record, Schema *schema, int attrNum, Value **value) {
 	if (!record || !schema || !value || attrNum < 0 || attrNum >= schema->numAttr)
 		THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
-	int offset = 0;
-	for (int i = 0; i < attrNum; i++) {
-		switch (schema->dataTypes[i]) {
-		case DT_INT: offset += sizeof(int); break;
-		case DT_FLOAT: offset += sizeof(float); break;
-		case DT_BOOL: offset += sizeof(bool); break;
-		case DT_STRING: offset += schema->typeLength[i]; break;
-		}
-	}
+	int offset = schema->attrOffsets[attrNum];
 	Value *val = (Value *)malloc(sizeof(Value));
 	if (!val) THROW(RC_WRITE_FAILED, "Memory allocation failed");
 	val->dt = schema->dataTypes[attrNum];
@@ -500,54 +1028,123 @@ RC setAttr(Record *record, Schema *schema, int attrNum, Value *value) {
 		THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
 	if (value->dt != schema->dataTypes[attrNum])
 		THROW(RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE, "Data type mismatch");
-	int offset = 0;
-	for (int i = 0; i < attrNum; i++) {
-		switch (schema->dataTypes[i]) {
-		case DT_INT: offset += sizeof(int); break;
-		case DT_FLOAT: offset += sizeof(float); break;
-		case DT_BOOL: offset += sizeof(bool); break;
-		case DT_STRING: offset += schema->typeLength[i]; break;
-		}
-	}
+	int offset = schema->attrOffsets[attrNum];
 	char *attrData = record->data + offset;
 	switch (schema->dataTypes[attrNum]) {
 	case DT_INT: memcpy(attrData, &(value->v.intV), sizeof(int)); break;
 	case DT_FLOAT: memcpy(attrData, &(value->v.floatV), sizeof(float)); break;
 	case DT_BOOL: memcpy(attrData, &(value->v.boolV), sizeof(bool)); break;
-	case DT_STRING: memcpy(attrData, value->v.stringV, schema->typeLength[attrNum]); break;
+	case DT_STRING: strncpy(attrData, value->v.stringV, schema->typeLength[attrNum]); break;
+	}
+	return RC_OK;
+}
+
+RC getIntAttr(Record *record, Schema *schema, int attrNum, int *value) {
+	char *attrData;
+	RC rc = typedAttr(record, schema, attrNum, DT_INT, &attrData);
+	if (rc == RC_OK) memcpy(value, attrData, sizeof(int));
+	return rc;
+}
+
+RC getFloatAttr(Record *record, Schema *schema, int attrNum, float *value) {
+	char *attrData;
+	RC rc = typedAttr(record, schema, attrNum, DT_FLOAT, &attrData);
+	if (rc == RC_OK) memcpy(value, attrData, sizeof(float));
+	return rc;
+}
+
+RC getBoolAttr(Record *record, Schema *schema, int attrNum, bool *value) {
+	char *attrData;
+	RC rc = typedAttr(record, schema, attrNum, DT_BOOL, &attrData);
+	if (rc == RC_OK) memcpy(value, attrData, sizeof(bool));
+	return rc;
+}
+
+RC getStringAttrRef(Record *record, Schema *schema, int attrNum, const char **value, int *length) {
+	char *attrData;
+	RC rc = typedAttr(record, schema, attrNum, DT_STRING, &attrData);
+	if (rc != RC_OK) return rc;
+	const char *end = memchr(attrData, '\0', schema->typeLength[attrNum]);
+	*value = attrData;
+	*length = end ? end - attrData : schema->typeLength[attrNum];
+	return RC_OK;
+}
+
+RC setAttrRaw(Record *record, Schema *schema, int attrNum, const void *value, int length) {
+	if (!value || !schema || attrNum < 0 || attrNum >= schema->numAttr)
+		THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	char *attrData;
+	DataType dt = schema->dataTypes[attrNum];
+	RC rc = typedAttr(record, schema, attrNum, dt, &attrData);
+	if (rc != RC_OK) return rc;
+	int size = getAttrSize(schema, attrNum);
+	if (dt != DT_STRING) {
+		memcpy(attrData, value, size);
+		return RC_OK;
 	}
+	if (length < 0) THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	if (length > size) length = size;
+	memcpy(attrData, value, length);
+	memset(attrData + length, 0, size - length);
+	return RC_OK;
+}
+
+// Locates attribute attrNum in record, checking that it has type dt
+static RC typedAttr(Record *record, Schema *schema, int attrNum, DataType dt, char **attrData) {
+	if (!record || !record->data || !schema || attrNum < 0 || attrNum >= schema->numAttr)
+		THROW(RC_FILE_HANDLE_NOT_INIT, "Invalid parameters");
+	if (schema->dataTypes[attrNum] != dt)
+		THROW(RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE, "Data type mismatch");
+	*attrData = record->data + schema->attrOffsets[attrNum];
 	return RC_OK;
 }
 
+// Every schema comes from createSchema, createSchemaWithLayout or a table's
+// schema page, so its offset table is always filled in
 static int getRecordSizeHelper(Schema *schema) {
-	int size = 0;
-	for (int i = 0; i < schema->numAttr; i++) {
-		switch (schema->dataTypes[i]) {
-		case DT_INT: size += sizeof(int); break;
-		case DT_FLOAT: size += sizeof(float); break;
-		case DT_BOOL: size += sizeof(bool); break;
-		case DT_STRING: size += schema->typeLength[i]; break;
+	return schema->recordSize;
+}
+
+// Fills in the offset table. The aligned layout places attributes by falling
+// alignment: ints and floats, then bools (a short), then strings, and rounds
+// the record up so rows stored back to back stay aligned.
+static bool computeLayout(Schema *schema) {
+	int offset = 0;
+	schema->attrOffsets = (int *)malloc(schema->numAttr * sizeof(int));
+	schema->attrSizes = (int *)malloc(schema->numAttr * sizeof(int));
+	if (!schema->attrOffsets || !schema->attrSizes) return false;
+	int numPasses = schema->layout == LAYOUT_ALIGNED ? 3 : 1;
+	for (int pass = 0; pass < numPasses; pass++) {
+		for (int i = 0; i < schema->numAttr; i++) {
+			DataType dt = schema->dataTypes[i];
+			int group = dt == DT_STRING ? 2 : dt == DT_BOOL ? 1 : 0;
+			if (numPasses > 1 && group != pass) continue;
+			schema->attrSizes[i] = getAttrSize(schema, i);
+			schema->attrOffsets[i] = offset;
+			offset += schema->attrSizes[i];
 		}
 	}
-	return size;
+	if (schema->layout == LAYOUT_ALIGNED)
+		offset = (offset + sizeof(int) - 1) & ~(int)(sizeof(int) - 1);
+	schema->recordSize = offset;
+	return true;
 }
 
 static int calculateSlotsPerPage(int recordSize) {
-	int slotOverhead = 1;
 	int usableSpace = PAGE_SIZE - PAGE_HEADER_SIZE;
-	return usableSpace / (recordSize + slotOverhead);
+	int numSlots = usableSpace * 8 / (recordSize * 8 + 1);
+	while (slotBitmapSize(numSlots) + numSlots * recordSize > usableSpace)
+		numSlots--;
+	return numSlots;
 }
 
 static RC writeSchemaToPage(BM_BufferPool *bm, Schema *schema) {
-	BM_PageHandle *ph = (BM_PageHandle *)malloc(sizeof(BM_PageHandle));
-	RC rc = pinPage(bm, ph, SCHEMA_PAGE);
-	if (rc != RC_OK) {
-		free(ph);
-		return rc;
-	}
+	BM_PageHandle ph;
+	RC rc = pinPage(bm, &ph, SCHEMA_PAGE);
+	if (rc != RC_OK) return rc;
 	
-	char *data = ph->data;
-	int offset = 0;
+	char *data = ph.data;
+	int offset = TABLE_INFO_SIZE;
 	
 	memcpy(data + offset, &(schema->numAttr), sizeof(int));
 	offset += sizeof(int);
@@ -561,8 +1158,7 @@ static RC writeSchemaToPage(BM_BufferPool *bm, Schema *schema) {
 		offset += sizeof(int);
 		int nameLen = strlen(schema->attrNames[i]);
 		if (offset + sizeof(int) + nameLen > PAGE_SIZE) {
-			unpinPage(bm, ph);
-			free(ph);
+			unpinPage(bm, &ph);
 			THROW(RC_WRITE_FAILED, "Schema too large for page");
 		}
 		memcpy(data + offset, &nameLen, sizeof(int));
@@ -571,33 +1167,30 @@ static RC writeSchemaToPage(BM_BufferPool *bm, Schema *schema) {
 		offset += nameLen;
 	}
 	
-	for (int i = 0; i < schema->keySize; i++) {
+	for (int i = 0; i <= schema->keySize; i++) {
 		if (offset + sizeof(int) > PAGE_SIZE) {
-			unpinPage(bm, ph);
-			free(ph);
+			unpinPage(bm, &ph);
 			THROW(RC_WRITE_FAILED, "Schema too large for page");
 		}
-		memcpy(data + offset, &(schema->keyAttrs[i]), sizeof(int));
+		// the record layout follows the key attributes
+		int value = i < schema->keySize ? schema->keyAttrs[i] : (int)schema->layout;
+		memcpy(data + offset, &value, sizeof(int));
 		offset += sizeof(int);
 	}
 	
-	markDirty(bm, ph);
-	unpinPage(bm, ph);
-	free(ph);
+	markDirty(bm, &ph);
+	unpinPage(bm, &ph);
 	return RC_OK;
 }
 
 static RC readSchemaFromPage(BM_BufferPool *bm, Schema **schema) {
-	BM_PageHandle *ph = (BM_PageHandle *)malloc(sizeof(BM_PageHandle));
-	RC rc = pinPage(bm, ph, SCHEMA_PAGE);
-	if (rc != RC_OK) {
-		free(ph);
-		return rc;
-	}
+	BM_PageHandle ph;
+	RC rc = pinPage(bm, &ph, SCHEMA_PAGE);
+	if (rc != RC_OK) return rc;
 	
 	Schema *newSchema = (Schema *)malloc(sizeof(Schema));
-	char *data = ph->data;
-	int offset = 0;
+	char *data = ph.data;
+	int offset = TABLE_INFO_SIZE;
 	
 	memcpy(&(newSchema->numAttr), data + offset, sizeof(int));
 	offset += sizeof(int);
@@ -612,8 +1205,7 @@ static RC readSchemaFromPage(BM_BufferPool *bm, Schema **schema) {
 		if (newSchema->attrNames) free(newSchema->attrNames);
 		if (newSchema->dataTypes) free(newSchema->dataTypes);
 		if (newSchema->typeLength) free(newSchema->typeLength);
-		unpinPage(bm, ph);
-		free(ph);
+		unpinPage(bm, &ph);
 		free(newSchema);
 		THROW(RC_WRITE_FAILED, "Memory allocation failed");
 	}
@@ -632,8 +1224,7 @@ static RC readSchemaFromPage(BM_BufferPool *bm, Schema **schema) {
 			free(newSchema->attrNames);
 			free(newSchema->dataTypes);
 			free(newSchema->typeLength);
-			unpinPage(bm, ph);
-			free(ph);
+			unpinPage(bm, &ph);
 			free(newSchema);
 			THROW(RC_WRITE_FAILED, "Memory allocation failed");
 		}
@@ -648,8 +1239,7 @@ static RC readSchemaFromPage(BM_BufferPool *bm, Schema **schema) {
 		free(newSchema->attrNames);
 		free(newSchema->dataTypes);
 		free(newSchema->typeLength);
-		unpinPage(bm, ph);
-		free(ph);
+		unpinPage(bm, &ph);
 		free(newSchema);
 		THROW(RC_WRITE_FAILED, "Memory allocation failed");
 	}
@@ -658,134 +1248,1862 @@ static RC readSchemaFromPage(BM_BufferPool *bm, Schema **schema) {
 		memcpy(&(newSchema->keyAttrs[i]), data + offset, sizeof(int));
 		offset += sizeof(int);
 	}
+	int layout;
+	memcpy(&layout, data + offset, sizeof(int));
+	newSchema->layout = (RecordLayout)layout;
+	unpinPage(bm, &ph);
 	
-	unpinPage(bm, ph);
-	free(ph);
+	if (!computeLayout(newSchema)) {
+		freeSchema(newSchema);
+		THROW(RC_WRITE_FAILED, "Memory allocation failed");
+	}
 	*schema = newSchema;
 	return RC_OK;
 }
 
-static RC findFreeSlot(TableManager *tm, RID *rid) {
-	BM_PageHandle *ph = (BM_PageHandle *)malloc(sizeof(BM_PageHandle));
-	int page = tm->firstFreePage;
-	RC rc;
+// Shared by deleteWhere (setter == NULL) and updateWhere. Fixed-format rows
+// are evaluated through a Record whose data points into the pinned page, so
+// nothing is copied out; PAX rows go through a scratch row. The page is
+// opened for writing at its first match.
+static RC modifyWhere(RM_TableData *rel, Expr *cond, RM_RecordSetter setter, void *setterData) {
+	if (!rel || !rel->mgmtData) THROW(RC_FILE_HANDLE_NOT_INIT, "Table not initialized");
+	TableManager *tm = (TableManager *)rel->mgmtData;
+	char row[PAGE_SIZE], old[PAGE_SIZE];
+	BM_PageHandle ph;
+	Record view;
+	Predicate *pred = NULL;
+	bool modified = false, matches;
+	RC rc = RC_OK;
 	
-	while (page >= 0) {
-		rc = pinPage(tm->bm, ph, page);
+	if (cond) compilePredicate(cond, rel->schema, &pred);
+	if (tm->format == RM_PAGE_SLOTTED) {
+		rc = modifyWhereSlotted(rel, cond, pred, setter, setterData);
+		freePredicate(pred);
+		return rc;
+	}
+	
+	for (int page = FIRST_DATA_PAGE; page >= 0 && rc == RC_OK; page = nextDataPage(tm, page)) {
+		if (cond && !pageMayMatch(tm, cond, page)) continue;
+		rc = pinPage(tm->bm, &ph, page);
 		if (rc != RC_OK) break;
 		
-		int *header = (int *)ph->data;
-		if (header[1] > 0) {
-			for (int slot = 0; slot < header[0]; slot++) {
-				if (!isSlotUsed(ph->data, slot, tm->recordSize)) {
-					rid->page = page;
-					rid->slot = slot;
-					unpinPage(tm->bm, ph);
-					free(ph);
-					return RC_OK;
-				}
+		int *header = (int *)ph.data;
+		int numSlots = header[0];
+		int oldCategory = freeSpaceCategory(numSlots, header[1]);
+		uint64_t *bitmap = slotBitmap(ph.data);
+		int matched = 0;
+		
+		// compiled conditions are evaluated on all rows up front; the setter
+		// may only change the row it is given, so the selection stays valid
+		uint64_t selected[MAX_SLOT_WORDS];
+		uint64_t *slots = bitmap;
+		bool vectorized = pred != NULL;
+		if (vectorized) slots = selectRows(tm, pred, ph.data, 0, selected);
+		
+		view.id.page = page;
+		for (int slot = nextSetBit(slots, 0, numSlots); slot < numSlots; slot = nextSetBit(slots, slot + 1, numSlots)) {
+			view.id.slot = slot;
+			if (tm->format == RM_PAGE_PAX) {
+				view.data = row;
+				readRow(tm, ph.data, slot, row);
+			} else {
+				view.data = getRecordDataPointer(tm, ph.data, slot);
 			}
+			if (!vectorized) {
+				rc = whereMatches(cond, pred, &view, rel->schema, &matches);
+				if (rc != RC_OK) break;
+				if (!matches) continue;
+			}
+			
+			if (matched++ == 0) beginPageWrite(tm->bm, &ph);
+			if (setter) {
+				if (tm->indexKind != RM_INDEX_NONE) memcpy(old, view.data, tm->recordSize);
+				rc = setter(&view, rel->schema, setterData);
+				if (rc != RC_OK) break;
+				if (view.data == row) writeRow(tm, ph.data, slot, row);
+				rc = widenZone(tm, page, view.data);
+				if (rc == RC_OK) rc = indexUpdate(tm, old, view.data, view.id);
+			} else {
+				rc = indexRemove(tm, view.data, view.id);
+				bitmap[slot / SLOT_WORD_BITS] &= ~(1ULL << (slot % SLOT_WORD_BITS));
+			}
+			if (rc != RC_OK) break;
+		}
+		
+		if (matched) {
+			modified = true;
+			if (!setter) header[1] += matched;
+			markDirty(tm->bm, &ph);
+		}
+		int newCategory = freeSpaceCategory(numSlots, header[1]);
+		unpinPage(tm->bm, &ph);
+		
+		if (matched && !setter) {
+			tm->numTuples -= matched;
+			if (page < tm->firstFreePage) tm->firstFreePage = page;
+			if (newCategory != oldCategory) setFreeSpace(tm->bm, page, newCategory);
 		}
-		page = header[2];
-		unpinPage(tm->bm, ph);
 	}
 	
-	SM_FileHandle fh;
-	rc = openPageFile(tm->bm->pageFile, &fh);
-	if (rc != RC_OK) {
-		free(ph);
-		return rc;
-	}
+	if (modified) finishWrite(tm);
+	freePredicate(pred);
+	return rc;
+}
+
+// Grows the table by one empty data page; a map page that falls at the end
+// of the file stays zeroed
+static RC appendDataPage(TableManager *tm, int *page) {
+	BM_PageHandle ph;
+	int newPage = tm->numPages;
+	if (isMapPage(newPage)) newPage++;
+	RC rc = ensurePoolCapacity(tm->bm, newPage + 1);
+	if (rc != RC_OK) return rc;
+	rc = pinPage(tm->bm, &ph, newPage);
+	if (rc != RC_OK) return rc;
 	
-	int newPage = fh.totalNumPages;
-	appendEmptyBlock(&fh);
+	beginPageWrite(tm->bm, &ph);
+	initDataPage(ph.data, tm->format, tm->slotsPerPage);
+	markDirty(tm->bm, &ph);
+	unpinPage(tm->bm, &ph);
+	
+	tm->numPages = newPage + 1;
+	*page = newPage;
+	return setFreeSpace(tm->bm, newPage, FSM_EMPTY);
+}
+
+static int slotBitmapSize(int numSlots) {
+	return (numSlots + SLOT_WORD_BITS - 1) / SLOT_WORD_BITS * sizeof(uint64_t);
+}
+
+static uint64_t *slotBitmap(char *page) {
+	return (uint64_t *)(page + PAGE_HEADER_SIZE);
+}
+
+static bool isSlotUsed(char *page, int slot) {
+	return (slotBitmap(page)[slot / SLOT_WORD_BITS] >> (slot % SLOT_WORD_BITS)) & 1;
+}
+
+// First used slot at or after slot, or numSlots when there is none
+static int nextUsedSlot(char *page, int slot, int numSlots) {
+	return nextSetBit(slotBitmap(page), slot, numSlots);
+}
+
+// First set bit at or after bit, or limit if there is none before it
+static int nextSetBit(uint64_t *words, int bit, int limit) {
+	if (bit >= limit) return limit;
+	int w = bit / SLOT_WORD_BITS;
+	uint64_t bits = words[w] & (~0ULL << (bit % SLOT_WORD_BITS));
+	while (!bits) {
+		if (++w * SLOT_WORD_BITS >= limit) return limit;
+		bits = words[w];
+	}
+	bit = w * SLOT_WORD_BITS + __builtin_ctzll(bits);
+	return bit < limit ? bit : limit;
+}
+
+// Evaluates pred on the rows of a fixed or PAX page from slot first on, a
+// batch at a time, and returns selected with the bits of the used slots
+// that match set. Unused slots are evaluated too and masked out after. PAX
+// conditions read their columns in place.
+static uint64_t *selectRows(TableManager *tm, Predicate *pred, char *page, int first, uint64_t *selected) {
+	int numSlots = ((int *)page)[0];
+	int start = first - first % SLOT_WORD_BITS;
+	uint64_t *bitmap = slotBitmap(page);
+	if (start >= numSlots) return selected;
+	if (tm->format == RM_PAGE_PAX) {
+		const char *columns[tm->schema->numAttr];
+		int widths[tm->schema->numAttr];
+		for (int i = 0; i < tm->schema->numAttr; i++) {
+			columns[i] = page + tm->columns[i].pageOffset + start * tm->columns[i].size;
+			widths[i] = tm->columns[i].size;
+		}
+		evalPredicateColumns(pred, columns, widths, numSlots - start, selected + start / SLOT_WORD_BITS);
+	} else
+		evalPredicateBatch(pred, getRecordDataPointer(tm, page, start), tm->recordSize, numSlots - start, selected + start / SLOT_WORD_BITS);
+	for (int w = start / SLOT_WORD_BITS; w * SLOT_WORD_BITS < numSlots; w++)
+		selected[w] &= bitmap[w];
+	return selected;
+}
+
+static char* getRecordDataPointer(TableManager *tm, char *page, int slot) {
+	return page + tm->recordsOffset + slot * tm->recordSize;
+}
+
+static void finishWrite(TableManager *tm) {
+	if (tm->writePolicy == RM_WRITE_THROUGH)
+		forceFlushPool(tm->bm);
+	if (++tm->writesSinceCheckpoint >= RM_CHECKPOINT_WRITES) {
+		checkpointPool(tm->bm);
+		tm->writesSinceCheckpoint = 0;
+	}
+}
+
+static RC readTableInfo(BM_BufferPool *bm, TableInfo *info) {
+	BM_PageHandle ph;
+	RC rc = pinPage(bm, &ph, SCHEMA_PAGE);
+	if (rc != RC_OK) return rc;
+	memcpy(info, ph.data, sizeof(TableInfo));
+	return unpinPage(bm, &ph);
+}
+
+static RC writeTableInfo(BM_BufferPool *bm, TableInfo *info) {
+	BM_PageHandle ph;
+	RC rc = pinPage(bm, &ph, SCHEMA_PAGE);
+	if (rc != RC_OK) return rc;
+	beginPageWrite(bm, &ph);
+	memcpy(ph.data, info, sizeof(TableInfo));
+	markDirty(bm, &ph);
+	rc = forcePage(bm, &ph);
+	unpinPage(bm, &ph);
+	return rc;
+}
+
+static RC saveTableInfo(TableManager *tm, bool clean) {
+	TableInfo info = { TABLE_MAGIC, TABLE_FORMAT_VERSION, tm->numTuples, tm->firstFreePage, tm->numPages, clean, tm->format, tm->indexKind };
+	if (clean) checkpointPool(tm->bm);
+	return writeTableInfo(tm->bm, &info);
+}
+
+// The table was not closed cleanly: rebuild the counts from the data pages
+static RC recoverTableInfo(TableManager *tm, char *fileName) {
+	SM_FileHandle fh;
+	BM_PageHandle ph;
+	RC rc = openPageFile(fileName, &fh);
+	if (rc != RC_OK) return rc;
+	tm->numPages = fh.totalNumPages;
 	closePageFile(&fh);
 	
-	rc = pinPage(tm->bm, ph, newPage);
-	if (rc != RC_OK) {
-		free(ph);
-		return rc;
+	tm->numTuples = 0;
+	tm->firstFreePage = -1;
+	for (int page = FIRST_DATA_PAGE; page >= 0; page = nextDataPage(tm, page)) {
+		rc = pinPage(tm->bm, &ph, page);
+		if (rc != RC_OK) return rc;
+		int category = pageCategory(tm, ph.data);
+		tm->numTuples += countTuples(tm, ph.data);
+		if (category != FSM_FULL && tm->firstFreePage == -1)
+			tm->firstFreePage = page;
+		rc = setFreeSpace(tm->bm, page, category);
+		unpinPage(tm->bm, &ph);
+		if (rc != RC_OK) return rc;
+	}
+	if (tm->firstFreePage == -1) tm->firstFreePage = FIRST_DATA_PAGE;
+	return RC_OK;
+}
+
+static bool isMapPage(int page) {
+	return page >= FSM_FIRST_PAGE && (page - FSM_FIRST_PAGE) % FSM_GROUP_SIZE == 0;
+}
+
+// RIDs are checked against this before their page is pinned, so a bad RID
+// neither decodes the schema or a map page as a row nor reads past the end
+static bool isDataPage(TableManager *tm, int page) {
+	return page >= FIRST_DATA_PAGE && page < tm->numPages && !isMapPage(page);
+}
+
+static int mapPageOf(int page) {
+	return page - (page - FSM_FIRST_PAGE) % FSM_GROUP_SIZE;
+}
+
+static int freeSpaceCategory(int numSlots, int freeSlots) {
+	if (freeSlots <= 0) return FSM_FULL;
+	if (freeSlots >= numSlots) return FSM_EMPTY;
+	return (freeSlots * 2 >= numSlots) ? FSM_HALF : FSM_LOW;
+}
+
+static RC setFreeSpace(BM_BufferPool *bm, int page, int category) {
+	BM_PageHandle ph;
+	int mapPage = mapPageOf(page);
+	int entry = page - mapPage - 1;
+	int shift = (entry % FSM_ENTRIES_PER_BYTE) * FSM_BITS;
+	
+	RC rc = pinPage(bm, &ph, mapPage);
+	if (rc != RC_OK) return rc;
+	
+	unsigned char *cell = (unsigned char *)ph.data + entry / FSM_ENTRIES_PER_BYTE;
+	if (((*cell >> shift) & FSM_MASK) != category) {
+		beginPageWrite(bm, &ph);
+		*cell = (*cell & ~(FSM_MASK << shift)) | (category << shift);
+		markDirty(bm, &ph);
+	}
+	return unpinPage(bm, &ph);
+}
+
+// Entries of a map word whose category is at least minCategory, as the low
+// bit of each 2-bit entry
+static uint64_t matchCategory(uint64_t bits, int minCategory) {
+	const uint64_t lowBits = 0x5555555555555555ULL;
+	switch (minCategory) {
+	case FSM_EMPTY: return bits & (bits >> 1) & lowBits;
+	case FSM_HALF: return (bits >> 1) & lowBits;
+	default: return (bits | (bits >> 1)) & lowBits;
 	}
+}
+
+// First data page at or after startPage whose map entry is at least
+// minCategory, or -1. Map entries are scanned a 64-bit word at a time.
+static int findPageWithRoom(BM_BufferPool *bm, int startPage, int numPages, int minCategory) {
+	BM_PageHandle ph;
+	if (startPage < FIRST_DATA_PAGE) startPage = FIRST_DATA_PAGE;
+	if (isMapPage(startPage)) startPage++;
+	int mapPage = mapPageOf(startPage);
+	int entry = startPage - mapPage - 1;
 	
-	int *header = (int *)ph->data;
-	header[0] = calculateSlotsPerPage(tm->recordSize);
-	header[1] = header[0];
+	while (mapPage < numPages) {
+		int numEntries = numPages - mapPage - 1;
+		if (numEntries > FSM_ENTRIES_PER_PAGE) numEntries = FSM_ENTRIES_PER_PAGE;
+		if (entry < numEntries) {
+			if (pinPage(bm, &ph, mapPage) != RC_OK) return -1;
+			
+			const uint64_t *words = (const uint64_t *)ph.data;
+			int w = entry / FSM_ENTRIES_PER_WORD;
+			uint64_t bits = matchCategory(words[w] & (~0ULL << ((entry % FSM_ENTRIES_PER_WORD) * FSM_BITS)), minCategory);
+			int found = -1;
+			while (true) {
+				if (bits) {
+					found = w * FSM_ENTRIES_PER_WORD + __builtin_ctzll(bits) / FSM_BITS;
+					break;
+				}
+				if (++w * FSM_ENTRIES_PER_WORD >= numEntries) break;
+				bits = matchCategory(words[w], minCategory);
+			}
+			unpinPage(bm, &ph);
+			if (found >= 0 && found < numEntries) return mapPage + 1 + found;
+		}
+		mapPage += FSM_GROUP_SIZE;
+		entry = 0;
+	}
+	return -1;
+}
+
+static int nextDataPage(TableManager *tm, int page) {
+	if (++page < tm->numPages && isMapPage(page)) page++;
+	return page < tm->numPages ? page : -1;
+}
+
+static void initDataPage(char *page, RM_PageFormat format, int slotsPerPage) {
+	if (format == RM_PAGE_SLOTTED) {
+		spInitPage(page);
+		return;
+	}
+	int *header = (int *)page;
+	header[0] = slotsPerPage;
+	header[1] = slotsPerPage;
 	header[2] = -1;
+}
+
+static int pageCategory(TableManager *tm, char *page) {
+	if (tm->format == RM_PAGE_SLOTTED) {
+		int freeBytes = spFreeBytes(page);
+		if (freeBytes < (int)SP_ENTRY_SIZE + SP_MIN_RECORD) return FSM_FULL;
+		if (freeBytes >= SP_USABLE_SIZE) return FSM_EMPTY;
+		return (freeBytes * 2 >= SP_USABLE_SIZE) ? FSM_HALF : FSM_LOW;
+	}
+	int *header = (int *)page;
+	return freeSpaceCategory(header[0], header[1]);
+}
+
+static int countTuples(TableManager *tm, char *page) {
+	if (tm->format == RM_PAGE_SLOTTED) {
+		char *data;
+		int length, flags, count = 0;
+		for (int slot = 0; slot < spNumEntries(page); slot++)
+			if (spGet(page, slot, &data, &length, &flags) && !(flags & SP_MOVED))
+				count++;
+		return count;
+	}
+	int *header = (int *)page;
+	return header[0] - header[1];
+}
+
+// A NULL condition matches every row; so does a non-boolean result
+static RC evalCondition(Expr *cond, Predicate *pred, Record *record, Schema *schema, bool *matches) {
+	Value *result;
+	*matches = true;
+	if (!cond) return RC_OK;
+	if (pred) {
+		*matches = evalPredicate(pred, record);
+		return RC_OK;
+	}
+	RC rc = evalExpr(record, schema, cond, &result);
+	if (rc != RC_OK) return rc;
+	if (result && result->dt == DT_BOOL) {
+		*matches = result->v.boolV;
+		freeVal(result);
+	}
+	return RC_OK;
+}
+
+// deleteWhere and updateWhere only touch rows whose condition is true
+static RC whereMatches(Expr *cond, Predicate *pred, Record *record, Schema *schema, bool *matches) {
+	Value *result;
+	*matches = true;
+	if (!cond) return RC_OK;
+	if (pred) {
+		*matches = evalPredicate(pred, record);
+		return RC_OK;
+	}
+	RC rc = evalExpr(record, schema, cond, &result);
+	if (rc != RC_OK) return rc;
+	*matches = result && result->dt == DT_BOOL && result->v.boolV;
+	if (result) freeVal(result);
+	return RC_OK;
+}
+
+static int getAttrSize(Schema *schema, int attrNum) {
+	switch (schema->dataTypes[attrNum]) {
+	case DT_INT: return sizeof(int);
+	case DT_FLOAT: return sizeof(float);
+	case DT_BOOL: return sizeof(bool);
+	case DT_STRING: return schema->typeLength[attrNum];
+	}
+	return 0;
+}
+
+static int maxEncodedSize(Schema *schema) {
+	int size = getRecordSizeHelper(schema);
+	for (int i = 0; i < schema->numAttr; i++)
+		if (schema->dataTypes[i] == DT_STRING) size += sizeof(uint16_t);
+	return size < SP_MIN_RECORD ? SP_MIN_RECORD : size;
+}
+
+// Slotted rows store every string as a 2-byte length and its bytes up to the
+// first NUL; the rest of the row is copied as is
+static int encodeRecord(TableManager *tm, const char *row, char *out) {
+	Schema *schema = tm->schema;
+	int length = 0;
+	for (int i = 0; i < schema->numAttr; i++) {
+		int size = getAttrSize(schema, i);
+		const char *value = row + schema->attrOffsets[i];
+		if (schema->dataTypes[i] == DT_STRING) {
+			const char *end = memchr(value, '\0', size);
+			uint16_t stringLength = end ? end - value : size;
+			memcpy(out + length, &stringLength, sizeof(uint16_t));
+			memcpy(out + length + sizeof(uint16_t), value, stringLength);
+			length += sizeof(uint16_t) + stringLength;
+		} else {
+			memcpy(out + length, value, size);
+			length += size;
+		}
+	}
+	if (length < SP_MIN_RECORD) {
+		memset(out + length, 0, SP_MIN_RECORD - length);
+		length = SP_MIN_RECORD;
+	}
+	return length;
+}
+
+static void decodeRecord(TableManager *tm, const char *in, char *row) {
+	Schema *schema = tm->schema;
+	int end = 0;
+	for (int i = 0; i < schema->numAttr; i++) {
+		int size = getAttrSize(schema, i);
+		char *value = row + schema->attrOffsets[i];
+		if (schema->dataTypes[i] == DT_STRING) {
+			uint16_t stringLength;
+			memcpy(&stringLength, in, sizeof(uint16_t));
+			memcpy(value, in + sizeof(uint16_t), stringLength);
+			memset(value + stringLength, 0, size - stringLength);
+			in += sizeof(uint16_t) + stringLength;
+		} else {
+			memcpy(value, in, size);
+			in += size;
+		}
+		if (schema->attrOffsets[i] + size > end) end = schema->attrOffsets[i] + size;
+	}
+	// padding of an aligned row
+	memset(row + end, 0, tm->recordSize - end);
+}
+
+// Closes a beginPageWrite on a data page and keeps its map entry and the
+// free page hint in step
+static void finishPageWrite(TableManager *tm, BM_PageHandle *ph, int oldCategory) {
+	int page = ph->pageNum;
+	int category = pageCategory(tm, ph->data);
+	markDirty(tm->bm, ph);
+	unpinPage(tm->bm, ph);
+	if (category != oldCategory) setFreeSpace(tm->bm, page, category);
+	if (category != FSM_FULL && page < tm->firstFreePage) tm->firstFreePage = page;
+}
+
+// Pins a slotted page with room for a length-byte record. The hint page is
+// tried whatever its category, so it fills up completely; other pages must
+// be at least half empty (or empty, for large records) to be picked.
+static RC pinPageWithRoom(TableManager *tm, int length, BM_PageHandle *ph) {
+	int need = length + SP_ENTRY_SIZE;
+	int minCategory = need * 2 <= SP_USABLE_SIZE ? FSM_HALF : FSM_EMPTY;
+	int page = tm->firstFreePage;
+	RC rc;
+	
+	if (page < tm->numPages) {
+		rc = pinPage(tm->bm, ph, page);
+		if (rc != RC_OK) return rc;
+		if (spFits(ph->data, length)) return RC_OK;
+		unpinPage(tm->bm, ph);
+	}
 	
-	if (tm->firstFreePage == FIRST_DATA_PAGE) {
-		BM_PageHandle *firstPh = (BM_PageHandle *)malloc(sizeof(BM_PageHandle));
-		rc = pinPage(tm->bm, firstPh, FIRST_DATA_PAGE);
-		if (rc == RC_OK) {
-			int *firstHeader = (int *)firstPh->data;
-			header[2] = firstHeader[2];
-			firstHeader[2] = newPage;
-			markDirty(tm->bm, firstPh);
-			unpinPage(tm->bm, firstPh);
+	int searchFrom = page + 1;
+	while ((page = findPageWithRoom(tm->bm, searchFrom, tm->numPages, minCategory)) >= 0) {
+		rc = pinPage(tm->bm, ph, page);
+		if (rc != RC_OK) return rc;
+		if (spFits(ph->data, length)) {
+			tm->firstFreePage = page;
+			return RC_OK;
 		}
-		free(firstPh);
+		// stale map entry, e.g. left behind by a crash
+		setFreeSpace(tm->bm, page, pageCategory(tm, ph->data));
+		unpinPage(tm->bm, ph);
+		searchFrom = page + 1;
 	}
 	
-	rid->page = newPage;
-	rid->slot = 0;
-	tm->firstFreePage = newPage;
+	rc = appendDataPage(tm, &page);
+	if (rc != RC_OK) return rc;
+	tm->firstFreePage = page;
+	return pinPage(tm->bm, ph, page);
+}
+
+// Pins the page holding the bytes of the record with home RID id, following
+// a forwarding entry
+static RC pinSlottedRow(TableManager *tm, RID id, BM_PageHandle *ph, char **data, int *length) {
+	int flags;
+	RID target;
+	RC rc = pinPage(tm->bm, ph, id.page);
+	if (rc != RC_OK) return rc;
 	
-	markDirty(tm->bm, ph);
+	if (!spGet(ph->data, id.slot, data, length, &flags) || (flags & SP_MOVED)) {
+		unpinPage(tm->bm, ph);
+		THROW(RC_FILE_NOT_FOUND, "Record not found");
+	}
+	if (!(flags & SP_FORWARD)) return RC_OK;
+	
+	memcpy(&target, *data, sizeof(RID));
 	unpinPage(tm->bm, ph);
-	free(ph);
+	rc = pinPage(tm->bm, ph, target.page);
+	if (rc != RC_OK) return rc;
+	if (!spGet(ph->data, target.slot, data, length, &flags)) {
+		unpinPage(tm->bm, ph);
+		THROW(RC_FILE_NOT_FOUND, "Record not found");
+	}
 	return RC_OK;
 }
 
-static RC markSlotAsUsed(BM_BufferPool *bm, RID *rid, int recordSize) {
-	BM_PageHandle *ph = (BM_PageHandle *)malloc(sizeof(BM_PageHandle));
-	RC rc = pinPage(bm, ph, rid->page);
+// Decodes the row whose home entry is data on the pinned page ph. A
+// forwarded row is read from its target page; ph stays pinned either way
+// and is unpinned on error.
+static RC readSlottedRow(TableManager *tm, BM_PageHandle *ph, char *data, int flags, char *row) {
+	BM_PageHandle target;
+	RID moved;
+	int length;
+	if (!(flags & SP_FORWARD)) {
+		decodeRecord(tm, data, row);
+		return RC_OK;
+	}
+	memcpy(&moved, data, sizeof(RID));
+	RC rc = pinPage(tm->bm, &target, moved.page);
+	if (rc == RC_OK && !spGet(target.data, moved.slot, &data, &length, &flags)) {
+		unpinPage(tm->bm, &target);
+		RC_message = "Record not found";
+		rc = RC_FILE_NOT_FOUND;
+	}
 	if (rc != RC_OK) {
-		free(ph);
+		unpinPage(tm->bm, ph);
 		return rc;
 	}
+	decodeRecord(tm, data, row);
+	return unpinPage(tm->bm, &target);
+}
+
+static RC removeEntry(TableManager *tm, RID id) {
+	BM_PageHandle ph;
+	RC rc = pinPage(tm->bm, &ph, id.page);
+	if (rc != RC_OK) return rc;
+	int category = pageCategory(tm, ph.data);
+	beginPageWrite(tm->bm, &ph);
+	spDelete(ph.data, id.slot);
+	finishPageWrite(tm, &ph, category);
+	return RC_OK;
+}
+
+// Fills a page per pin, taking free slots straight from the slot bitmap
+static RC insertFixed(TableManager *tm, Record **records, int numRecords, RID *rids, int *inserted) {
+	BM_PageHandle ph;
+	int searchFrom = tm->firstFreePage;
+	int done = 0;
+	RC rc = RC_OK;
 	
-	int *header = (int *)ph->data;
-	char *tombstone = ph->data + PAGE_HEADER_SIZE + rid->slot * (recordSize + 1);
-	*tombstone = 1;
-	header[1]--;
+	while (done < numRecords) {
+		int page = findPageWithRoom(tm->bm, searchFrom, tm->numPages, FSM_LOW);
+		if (page < 0) {
+			rc = appendDataPage(tm, &page);
+			if (rc != RC_OK) break;
+		}
+		rc = pinPage(tm->bm, &ph, page);
+		if (rc != RC_OK) break;
+		
+		int *header = (int *)ph.data;
+		if (header[1] <= 0) {
+			// stale map entry, e.g. left behind by a crash
+			unpinPage(tm->bm, &ph);
+			setFreeSpace(tm->bm, page, FSM_FULL);
+			searchFrom = page + 1;
+			continue;
+		}
+		
+		int oldCategory = freeSpaceCategory(header[0], header[1]);
+		uint64_t *bitmap = slotBitmap(ph.data);
+		int filled = 0;
+		
+		beginPageWrite(tm->bm, &ph);
+		for (int w = 0; w * SLOT_WORD_BITS < header[0] && filled < header[1] && done < numRecords; w++) {
+			uint64_t freeBits = ~bitmap[w];
+			while (freeBits && done < numRecords) {
+				int slot = w * SLOT_WORD_BITS + __builtin_ctzll(freeBits);
+				if (slot >= header[0]) break;
+				writeRow(tm, ph.data, slot, records[done]->data);
+				bitmap[w] |= freeBits & -freeBits;
+				freeBits &= freeBits - 1;
+				records[done]->id.page = page;
+				records[done]->id.slot = slot;
+				if (rids) rids[done] = records[done]->id;
+				done++;
+				filled++;
+			}
+		}
+		header[1] -= filled;
+		if (!filled) header[1] = 0;  // header disagreed with the bitmap
+		int newCategory = freeSpaceCategory(header[0], header[1]);
+		markDirty(tm->bm, &ph);
+		unpinPage(tm->bm, &ph);
+		
+		if (newCategory != oldCategory)
+			setFreeSpace(tm->bm, page, newCategory);
+		tm->numTuples += filled;
+		tm->firstFreePage = page;
+		searchFrom = newCategory == FSM_FULL ? page + 1 : page;
+	}
+	
+	*inserted = done;
+	return rc;
+}
+
+// Fills pinned pages one after another, keeping each pinned while records fit
+static RC insertSlotted(TableManager *tm, Record **records, int numRecords, RID *rids, int *inserted) {
+	char encoded[PAGE_SIZE];
+	BM_PageHandle ph;
+	bool pinned = false;
+	int category = FSM_FULL;
+	int i;
+	RC rc = RC_OK;
+	
+	for (i = 0; i < numRecords; i++) {
+		int length = encodeRecord(tm, records[i]->data, encoded);
+		if (pinned && !spFits(ph.data, length)) {
+			finishPageWrite(tm, &ph, category);
+			pinned = false;
+		}
+		if (!pinned) {
+			rc = pinPageWithRoom(tm, length, &ph);
+			if (rc != RC_OK) break;
+			pinned = true;
+			category = pageCategory(tm, ph.data);
+			beginPageWrite(tm->bm, &ph);
+		}
+		records[i]->id.page = ph.pageNum;
+		records[i]->id.slot = spInsert(ph.data, encoded, length, 0);
+		if (rids) rids[i] = records[i]->id;
+		tm->numTuples++;
+	}
+	
+	if (pinned) finishPageWrite(tm, &ph, category);
+	*inserted = i;
+	return rc;
+}
+
+static RC getSlotted(TableManager *tm, RID id, char *row) {
+	BM_PageHandle ph;
+	char *data;
+	int length;
+	RC rc = pinSlottedRow(tm, id, &ph, &data, &length);
+	if (rc != RC_OK) return rc;
+	decodeRecord(tm, data, row);
+	return unpinPage(tm->bm, &ph);
+}
+
+// The home entry goes first: a crash in between leaves an unreachable moved
+// row rather than a dangling forward
+static RC deleteSlotted(TableManager *tm, RID id, char *old) {
+	BM_PageHandle ph;
+	char *data;
+	int length, flags;
+	RID target;
+	RC rc = pinPage(tm->bm, &ph, id.page);
+	if (rc != RC_OK) return rc;
+	
+	if (!spGet(ph.data, id.slot, &data, &length, &flags) || (flags & SP_MOVED)) {
+		unpinPage(tm->bm, &ph);
+		THROW(RC_FILE_NOT_FOUND, "Record not found");
+	}
+	if (flags & SP_FORWARD) memcpy(&target, data, sizeof(RID));
+	if (old) {
+		rc = readSlottedRow(tm, &ph, data, flags, old);
+		if (rc != RC_OK) return rc;
+	}
 	
-	markDirty(bm, ph);
-	unpinPage(bm, ph);
-	free(ph);
+	int category = pageCategory(tm, ph.data);
+	beginPageWrite(tm->bm, &ph);
+	spDelete(ph.data, id.slot);
+	finishPageWrite(tm, &ph, category);
+	tm->numTuples--;
+	
+	return (flags & SP_FORWARD) ? removeEntry(tm, target) : RC_OK;
+}
+
+// A row that no longer fits its page moves to one with room and leaves a
+// forwarding entry behind, so its RID stays valid. A moved row returns home
+// as soon as it fits there again.
+static RC updateSlotted(TableManager *tm, Record *record, char *old) {
+	char encoded[PAGE_SIZE];
+	BM_PageHandle ph;
+	RID id = record->id, target, moved;
+	char *data;
+	int length, flags, category;
+	RC rc;
+	
+	int newLength = encodeRecord(tm, record->data, encoded);
+	rc = pinPage(tm->bm, &ph, id.page);
+	if (rc != RC_OK) return rc;
+	if (!spGet(ph.data, id.slot, &data, &length, &flags) || (flags & SP_MOVED)) {
+		unpinPage(tm->bm, &ph);
+		THROW(RC_FILE_NOT_FOUND, "Record not found");
+	}
+	bool forwarded = flags & SP_FORWARD;
+	if (forwarded) memcpy(&target, data, sizeof(RID));
+	if (old) {
+		rc = readSlottedRow(tm, &ph, data, flags, old);
+		if (rc != RC_OK) return rc;
+	}
+	
+	if (spCanUpdate(ph.data, id.slot, newLength)) {
+		category = pageCategory(tm, ph.data);
+		beginPageWrite(tm->bm, &ph);
+		spUpdate(ph.data, id.slot, encoded, newLength, 0);
+		finishPageWrite(tm, &ph, category);
+		return forwarded ? removeEntry(tm, target) : RC_OK;
+	}
+	unpinPage(tm->bm, &ph);
+	
+	if (forwarded) {
+		rc = pinPage(tm->bm, &ph, target.page);
+		if (rc != RC_OK) return rc;
+		if (spCanUpdate(ph.data, target.slot, newLength)) {
+			category = pageCategory(tm, ph.data);
+			beginPageWrite(tm->bm, &ph);
+			spUpdate(ph.data, target.slot, encoded, newLength, SP_MOVED);
+			finishPageWrite(tm, &ph, category);
+			return RC_OK;
+		}
+		unpinPage(tm->bm, &ph);
+	}
+	
+	rc = pinPageWithRoom(tm, newLength, &ph);
+	if (rc != RC_OK) return rc;
+	category = pageCategory(tm, ph.data);
+	beginPageWrite(tm->bm, &ph);
+	moved.page = ph.pageNum;
+	moved.slot = spInsert(ph.data, encoded, newLength, SP_MOVED);
+	finishPageWrite(tm, &ph, category);
+	if (forwarded) {
+		rc = removeEntry(tm, target);
+		if (rc != RC_OK) return rc;
+	}
+	
+	// the old row is at least SP_MIN_RECORD bytes, so the forward always fits
+	rc = pinPage(tm->bm, &ph, id.page);
+	if (rc != RC_OK) return rc;
+	category = pageCategory(tm, ph.data);
+	beginPageWrite(tm->bm, &ph);
+	spUpdate(ph.data, id.slot, (char *)&moved, sizeof(RID), SP_FORWARD);
+	finishPageWrite(tm, &ph, category);
 	return RC_OK;
 }
 
-static RC markSlotAsFree(BM_BufferPool *bm, RID *rid, int recordSize) {
-	BM_PageHandle *ph = (BM_PageHandle *)malloc(sizeof(BM_PageHandle));
-	RC rc = pinPage(bm, ph, rid->page);
+// Moved rows are skipped where they sit and returned through their
+// forwarding entry, so every record is seen once under its home RID
+static RC nextSlotted(RM_ScanHandle *scan, Record *record) {
+	ScanManager *sm = (ScanManager *)scan->mgmtData;
+	TableManager *tm = (TableManager *)scan->rel->mgmtData;
+	BM_PageHandle ph, rowPh;
+	char *data;
+	int length, flags;
+	bool matches;
+	RC rc;
+	
+	if (!record->data) record->data = (char *)malloc(sm->outSize);
+	// projected scans decode into scratch space and copy out what they keep
+	Record row = { { 0, 0 }, sm->projAttrs ? sm->row : record->data };
+	
+	while ((sm->currentPage = candidatePage(tm, sm)) >= 0) {
+		rc = pinPage(tm->bm, &ph, sm->currentPage);
+		if (rc != RC_OK) return rc;
+		
+		for (; sm->currentSlot < spNumEntries(ph.data); sm->currentSlot++) {
+			if (!spGet(ph.data, sm->currentSlot, &data, &length, &flags) || (flags & SP_MOVED))
+				continue;
+			RID id = {sm->currentPage, sm->currentSlot};
+			if (flags & SP_FORWARD) {
+				rc = pinSlottedRow(tm, id, &rowPh, &data, &length);
+				if (rc == RC_OK) {
+					decodeRecord(tm, data, row.data);
+					unpinPage(tm->bm, &rowPh);
+				}
+			} else {
+				decodeRecord(tm, data, row.data);
+				rc = RC_OK;
+			}
+			if (rc == RC_OK)
+				rc = evalCondition(sm->condition, sm->pred, &row, scan->rel->schema, &matches);
+			if (rc != RC_OK) {
+				unpinPage(tm->bm, &ph);
+				return rc;
+			}
+			if (matches) {
+				if (sm->projAttrs) emitRow(tm, sm, row.data, record->data);
+				record->id = id;
+				sm->currentSlot++;
+				unpinPage(tm->bm, &ph);
+				return RC_OK;
+			}
+		}
+		
+		sm->currentPage = nextDataPage(tm, sm->currentPage);
+		sm->currentSlot = 0;
+		unpinPage(tm->bm, &ph);
+		if (tm->readAhead > 0 && sm->currentPage >= 0)
+			prefetchPages(tm->bm, sm->currentPage, tm->readAhead);
+	}
+	
+	THROW(RC_RM_NO_MORE_TUPLES, "No more tuples");
+}
+
+// Each data page is pinned and dirtied once: rows stored on it are deleted
+// or rewritten in place. Rows whose change involves another page (forwarded
+// rows, and updates that no longer fit) go through the single-record
+// helpers, which pin the pages they touch themselves.
+static RC modifyWhereSlotted(RM_TableData *rel, Expr *cond, Predicate *pred, RM_RecordSetter setter, void *setterData) {
+	TableManager *tm = (TableManager *)rel->mgmtData;
+	char row[PAGE_SIZE], old[PAGE_SIZE], encoded[PAGE_SIZE];
+	BM_PageHandle ph;
+	Record view;
+	char *data;
+	int length, flags;
+	bool modified = false, matches;
+	RC rc = RC_OK;
+	
+	view.data = row;
+	for (int page = FIRST_DATA_PAGE; page >= 0 && rc == RC_OK; page = nextDataPage(tm, page)) {
+		if (cond && !pageMayMatch(tm, cond, page)) continue;
+		rc = pinPage(tm->bm, &ph, page);
+		if (rc != RC_OK) break;
+		int category = pageCategory(tm, ph.data);
+		bool dirty = false;
+		
+		for (int slot = 0; slot < spNumEntries(ph.data); slot++) {
+			if (!spGet(ph.data, slot, &data, &length, &flags) || (flags & SP_MOVED))
+				continue;
+			bool forwarded = flags & SP_FORWARD;
+			view.id.page = page;
+			view.id.slot = slot;
+			if (forwarded) {
+				rc = getSlotted(tm, view.id, row);
+				if (rc != RC_OK) break;
+			} else {
+				decodeRecord(tm, data, row);
+			}
+			rc = whereMatches(cond, pred, &view, rel->schema, &matches);
+			if (rc != RC_OK) break;
+			if (!matches) continue;
+			
+			if (setter && tm->indexKind != RM_INDEX_NONE) memcpy(old, row, tm->recordSize);
+			if (setter) rc = setter(&view, rel->schema, setterData);
+			if (rc != RC_OK) break;
+			length = setter ? encodeRecord(tm, row, encoded) : 0;
+			if (!forwarded && (!setter || spCanUpdate(ph.data, slot, length))) {
+				beginPageWrite(tm->bm, &ph);
+				if (setter) {
+					spUpdate(ph.data, slot, encoded, length, 0);
+				} else {
+					spDelete(ph.data, slot);
+					tm->numTuples--;
+				}
+				dirty = true;
+			} else {
+				// the helpers judge free space from the page as it is now
+				int current = pageCategory(tm, ph.data);
+				if (current != category) setFreeSpace(tm->bm, page, current);
+				rc = setter ? updateSlotted(tm, &view, NULL) : deleteSlotted(tm, view.id, NULL);
+				category = pageCategory(tm, ph.data);
+			}
+			if (rc == RC_OK && setter) rc = widenZone(tm, page, row);
+			if (rc == RC_OK) rc = setter ? indexUpdate(tm, old, row, view.id) : indexRemove(tm, row, view.id);
+			if (rc != RC_OK) break;
+			modified = true;
+		}
+		if (dirty) finishPageWrite(tm, &ph, category);
+		else unpinPage(tm->bm, &ph);
+	}
+	
+	if (modified) finishWrite(tm);
+	return rc;
+}
+
+static bool isValidFormat(int format) {
+	return format == RM_PAGE_FIXED || format == RM_PAGE_SLOTTED || format == RM_PAGE_PAX;
+}
+
+// PAX pages may hold a few slots less than fixed ones, as every column
+// starts 8-byte aligned
+static int slotsForFormat(Schema *schema, RM_PageFormat format) {
+	int numSlots = calculateSlotsPerPage(getRecordSizeHelper(schema));
+	if (format == RM_PAGE_PAX)
+		while (layoutColumns(schema, numSlots, NULL) > PAGE_SIZE)
+			numSlots--;
+	return numSlots;
+}
+
+// Fills in columns (if not NULL) and returns the end of the last PAX column
+static int layoutColumns(Schema *schema, int numSlots, ColumnInfo *columns) {
+	int pageOffset = PAGE_HEADER_SIZE + slotBitmapSize(numSlots);
+	for (int i = 0; i < schema->numAttr; i++) {
+		int size = getAttrSize(schema, i);
+		pageOffset = (pageOffset + 7) & ~7;
+		if (columns) {
+			columns[i].size = size;
+			columns[i].rowOffset = schema->attrOffsets[i];
+			columns[i].pageOffset = pageOffset;
+		}
+		pageOffset += numSlots * size;
+	}
+	return pageOffset;
+}
+
+static void readRow(TableManager *tm, char *page, int slot, char *row) {
+	if (tm->format != RM_PAGE_PAX) {
+		memcpy(row, getRecordDataPointer(tm, page, slot), tm->recordSize);
+		return;
+	}
+	for (int i = 0; i < tm->schema->numAttr; i++) {
+		ColumnInfo *column = &tm->columns[i];
+		memcpy(row + column->rowOffset, page + column->pageOffset + slot * column->size, column->size);
+	}
+}
+
+static void writeRow(TableManager *tm, char *page, int slot, const char *row) {
+	if (tm->format != RM_PAGE_PAX) {
+		memcpy(getRecordDataPointer(tm, page, slot), row, tm->recordSize);
+		return;
+	}
+	for (int i = 0; i < tm->schema->numAttr; i++) {
+		ColumnInfo *column = &tm->columns[i];
+		memcpy(page + column->pageOffset + slot * column->size, row + column->rowOffset, column->size);
+	}
+}
+
+// Copies just the listed attributes of a PAX row into their place in row
+static void readColumns(TableManager *tm, char *page, int slot, char *row, int *attrs, int numAttrs) {
+	for (int i = 0; i < numAttrs; i++) {
+		ColumnInfo *column = &tm->columns[attrs[i]];
+		memcpy(row + column->rowOffset, page + column->pageOffset + slot * column->size, column->size);
+	}
+}
+
+// Copies the key attribute of the row in slot into its place in row
+static void readKey(TableManager *tm, char *page, int slot, char *row) {
+	ColumnInfo *column = &tm->columns[tm->keyAttr];
+	if (tm->format == RM_PAGE_PAX)
+		readColumns(tm, page, slot, row, &tm->keyAttr, 1);
+	else
+		memcpy(row + column->rowOffset, getRecordDataPointer(tm, page, slot) + column->rowOffset, column->size);
+}
+
+static void collectAttrs(Expr *expr, int *attrs, int *numAttrs) {
+	switch (expr->type) {
+	case EXPR_ATTRREF:
+		for (int i = 0; i < *numAttrs; i++)
+			if (attrs[i] == expr->expr.attrRef) return;
+		attrs[(*numAttrs)++] = expr->expr.attrRef;
+		break;
+	case EXPR_OP:
+		collectAttrs(expr->expr.op->args[0], attrs, numAttrs);
+		if (expr->expr.op->type != OP_BOOL_NOT)
+			collectAttrs(expr->expr.op->args[1], attrs, numAttrs);
+		break;
+	case EXPR_CONST:
+		break;
+	}
+}
+
+// Only the columns the condition reads are copied out before it is
+// evaluated; the rest of the row follows for matches only
+static RC nextPax(RM_ScanHandle *scan, Record *record) {
+	ScanManager *sm = (ScanManager *)scan->mgmtData;
+	TableManager *tm = (TableManager *)scan->rel->mgmtData;
+	BM_PageHandle ph;
+	bool matches;
+	RC rc;
+	
+	if (!record->data) record->data = (char *)malloc(sm->outSize);
+	Record row = { { 0, 0 }, sm->projAttrs ? sm->row : record->data };
+	
+	while ((sm->currentPage = candidatePage(tm, sm)) >= 0) {
+		rc = pinPage(tm->bm, &ph, sm->currentPage);
+		if (rc != RC_OK) return rc;
+		
+		int numSlots = ((int *)ph.data)[0];
+		while ((sm->currentSlot = nextUsedSlot(ph.data, sm->currentSlot, numSlots)) < numSlots) {
+			int slot = sm->currentSlot++;
+			if (sm->condition) {
+				readColumns(tm, ph.data, slot, row.data, sm->condAttrs, sm->numCondAttrs);
+				rc = evalCondition(sm->condition, sm->pred, &row, scan->rel->schema, &matches);
+				if (rc != RC_OK) {
+					unpinPage(tm->bm, &ph);
+					return rc;
+				}
+				if (!matches) continue;
+			}
+			if (sm->projAttrs)
+				emitPaxRow(tm, sm, ph.data, slot, record->data);
+			else
+				readRow(tm, ph.data, slot, record->data);
+			record->id.page = sm->currentPage;
+			record->id.slot = slot;
+			unpinPage(tm->bm, &ph);
+			return RC_OK;
+		}
+		
+		sm->currentPage = nextDataPage(tm, sm->currentPage);
+		sm->currentSlot = 0;
+		unpinPage(tm->bm, &ph);
+		if (tm->readAhead > 0 && sm->currentPage >= 0)
+			prefetchPages(tm->bm, sm->currentPage, tm->readAhead);
+	}
+	
+	THROW(RC_RM_NO_MORE_TUPLES, "No more tuples");
+}
+
+
+// Only tables keyed on a single attribute get an index
+static bool isIndexable(Schema *schema) {
+	if (schema->keySize != 1) return false;
+	int keyAttr = schema->keyAttrs[0];
+	return schema->dataTypes[keyAttr] != DT_STRING || schema->typeLength[keyAttr] <= MAX_INDEXED_KEY_SIZE;
+}
+
+// Table indexes are non-unique: the record manager has never enforced keys
+static RC createIndex(char *name, Schema *schema, RM_IndexKind kind) {
+	char fileName[TABLE_FILE_NAME_SIZE(name)];
+	int keyAttr = schema->keyAttrs[0];
+	snprintf(fileName, sizeof(fileName), "%s.idx", name);
+	if (kind == RM_INDEX_HASH)
+		return createHashIndex(fileName, schema->dataTypes[keyAttr], schema->typeLength[keyAttr]);
+	return createBtreeWithOptions(fileName, schema->dataTypes[keyAttr], schema->typeLength[keyAttr], 0, true);
+}
+
+// Opens the table's index, or builds it afresh from the rows when rebuild is set
+static RC openIndex(RM_TableData *rel, char *name, bool rebuild) {
+	TableManager *tm = (TableManager *)rel->mgmtData;
+	char fileName[TABLE_FILE_NAME_SIZE(name)];
+	char row[PAGE_SIZE];
+	Record record = { { 0, 0 }, row };
+	RM_ScanHandle scan;
+	RC rc;
+	
+	snprintf(fileName, sizeof(fileName), "%s.idx", name);
+	if (rebuild) {
+		if (tm->indexKind == RM_INDEX_HASH)
+			deleteHashIndex(fileName);
+		else
+			deleteBtree(fileName);
+		rc = createIndex(name, tm->schema, tm->indexKind);
+		if (rc != RC_OK) return rc;
+	}
+	if (tm->indexKind == RM_INDEX_HASH)
+		rc = openHashIndex(&tm->hash, fileName);
+	else
+		rc = openBtree(&tm->btree, fileName);
+	if (rc != RC_OK || !rebuild) return rc;
+	
+	rc = startScan(rel, &scan, NULL);
+	if (rc != RC_OK) return rc;
+	while ((rc = next(&scan, &record)) == RC_OK) {
+		rc = indexInsert(tm, row, record.id);
+		if (rc != RC_OK) break;
+	}
+	closeScan(&scan);
+	return rc == RC_RM_NO_MORE_TUPLES ? RC_OK : rc;
+}
+
+// Points key at the key attribute of row; buf holds a terminated copy of string keys
+static void rowKey(TableManager *tm, const char *row, Value *key, char *buf) {
+	ColumnInfo *column = &tm->columns[tm->keyAttr];
+	key->dt = tm->schema->dataTypes[tm->keyAttr];
+	switch (key->dt) {
+	case DT_INT: memcpy(&key->v.intV, row + column->rowOffset, sizeof(int)); break;
+	case DT_FLOAT: memcpy(&key->v.floatV, row + column->rowOffset, sizeof(float)); break;
+	case DT_BOOL: memcpy(&key->v.boolV, row + column->rowOffset, sizeof(bool)); break;
+	case DT_STRING:
+		memcpy(buf, row + column->rowOffset, column->size);
+		buf[column->size] = '\0';
+		key->v.stringV = buf;
+		break;
+	}
+}
+
+static RC indexInsert(TableManager *tm, const char *row, RID id) {
+	char buf[MAX_INDEXED_KEY_SIZE + 1];
+	Value key;
+	if (tm->indexKind == RM_INDEX_NONE) return RC_OK;
+	rowKey(tm, row, &key, buf);
+	if (tm->indexKind == RM_INDEX_HASH) return insertHashKey(tm->hash, &key, id);
+	return insertKey(tm->btree, &key, id);
+}
+
+static RC indexRemove(TableManager *tm, const char *row, RID id) {
+	char buf[MAX_INDEXED_KEY_SIZE + 1];
+	Value key;
+	if (tm->indexKind == RM_INDEX_NONE) return RC_OK;
+	rowKey(tm, row, &key, buf);
+	if (tm->indexKind == RM_INDEX_HASH) return deleteHashKey(tm->hash, &key, id);
+	return deleteKeyEntry(tm->btree, &key, id);
+}
+
+// Moves the row's entry only when its key bytes changed
+static RC indexUpdate(TableManager *tm, const char *oldRow, const char *newRow, RID id) {
+	ColumnInfo *column;
+	if (tm->indexKind == RM_INDEX_NONE) return RC_OK;
+	column = &tm->columns[tm->keyAttr];
+	if (memcmp(oldRow + column->rowOffset, newRow + column->rowOffset, column->size) == 0)
+		return RC_OK;
+	RC rc = indexRemove(tm, oldRow, id);
+	if (rc != RC_OK) return rc;
+	return indexInsert(tm, newRow, id);
+}
+
+// Returns the number of disjoint key ranges, in key order, that together
+// hold every row expr can match, or -1 if expr does not bound the key
+static int keyRanges(TableManager *tm, Expr *expr, KeyRange *ranges) {
+	KeyRange left[MAX_KEY_RANGES], right[MAX_KEY_RANGES];
+	int numLeft, numRight, n = 0;
+	
+	if (expr->type != EXPR_OP) return -1;
+	Operator *op = expr->expr.op;
+	switch (op->type) {
+	case OP_COMP_EQUAL:
+	case OP_COMP_SMALLER:
+		return comparisonRange(tm, op, false, ranges);
+	case OP_BOOL_NOT:
+		if (op->args[0]->type != EXPR_OP || op->args[0]->expr.op->type != OP_COMP_SMALLER) return -1;
+		return comparisonRange(tm, op->args[0]->expr.op, true, ranges);
+	case OP_BOOL_AND:
+		// either side alone already bounds the rows
+		numLeft = keyRanges(tm, op->args[0], left);
+		numRight = keyRanges(tm, op->args[1], right);
+		if (numLeft < 0 && numRight < 0) return -1;
+		if (numLeft < 0 || numRight < 0) {
+			n = numLeft < 0 ? numRight : numLeft;
+			memcpy(ranges, numLeft < 0 ? right : left, n * sizeof(KeyRange));
+			return n;
+		}
+		for (int i = 0; i < numLeft; i++) {
+			for (int j = 0; j < numRight; j++) {
+				if (n == MAX_KEY_RANGES) {
+					// too fragmented: the left side alone still covers the rows
+					memcpy(ranges, left, numLeft * sizeof(KeyRange));
+					return numLeft;
+				}
+				if (intersectRanges(&left[i], &right[j], &ranges[n])) n++;
+			}
+		}
+		return normalizeRanges(ranges, n);
+	case OP_BOOL_OR:
+		numLeft = keyRanges(tm, op->args[0], left);
+		numRight = keyRanges(tm, op->args[1], right);
+		if (numLeft < 0 || numRight < 0 || numLeft + numRight > MAX_KEY_RANGES) return -1;
+		memcpy(ranges, left, numLeft * sizeof(KeyRange));
+		memcpy(ranges + numLeft, right, numRight * sizeof(KeyRange));
+		return normalizeRanges(ranges, numLeft + numRight);
+	}
+	return -1;
+}
+
+// attr = c, attr < c or c < attr on the key attribute; negated turns the
+// comparison into attr >= c or attr <= c
+static int comparisonRange(TableManager *tm, Operator *op, bool negated, KeyRange *ranges) {
+	Expr *left = op->args[0], *right = op->args[1];
+	bool attrLeft = left->type == EXPR_ATTRREF && right->type == EXPR_CONST;
+	if (!attrLeft && !(right->type == EXPR_ATTRREF && left->type == EXPR_CONST)) return -1;
+	int attr = attrLeft ? left->expr.attrRef : right->expr.attrRef;
+	Value *cons = attrLeft ? right->expr.cons : left->expr.cons;
+	if (attr != tm->keyAttr || cons->dt != tm->schema->dataTypes[attr]) return -1;
+	
+	KeyRange *range = &ranges[0];
+	range->low = range->high = NULL;
+	range->lowInclusive = range->highInclusive = false;
+	if (op->type == OP_COMP_EQUAL) {
+		if (negated) return -1;
+		range->low = range->high = cons;
+		range->lowInclusive = range->highInclusive = true;
+	} else if (attrLeft) {
+		if (negated) range->low = cons;
+		else range->high = cons;
+		range->lowInclusive = negated;
+	} else {
+		if (negated) range->high = cons;
+		else range->low = cons;
+		range->highInclusive = negated;
+	}
+	return 1;
+}
+
+// Orders two key values the way the condition's comparisons do
+static int compareKeyValues(Value *a, Value *b) {
+	switch (a->dt) {
+	case DT_INT: return (a->v.intV > b->v.intV) - (a->v.intV < b->v.intV);
+	case DT_FLOAT: return (a->v.floatV > b->v.floatV) - (a->v.floatV < b->v.floatV);
+	case DT_BOOL: return (int)a->v.boolV - (int)b->v.boolV;
+	case DT_STRING: return strcmp(a->v.stringV, b->v.stringV);
+	}
+	return 0;
+}
+
+static int compareLowBounds(const void *a, const void *b) {
+	const KeyRange *x = (const KeyRange *)a, *y = (const KeyRange *)b;
+	if (!x->low || !y->low) return (x->low != NULL) - (y->low != NULL);
+	int cmp = compareKeyValues(x->low, y->low);
+	if (cmp != 0) return cmp;
+	return (int)y->lowInclusive - (int)x->lowInclusive;
+}
+
+static bool isEmptyRange(KeyRange *range) {
+	if (!range->low || !range->high) return false;
+	int cmp = compareKeyValues(range->low, range->high);
+	return cmp > 0 || (cmp == 0 && !(range->lowInclusive && range->highInclusive));
+}
+
+static bool intersectRanges(KeyRange *a, KeyRange *b, KeyRange *out) {
+	*out = *a;
+	if (b->low) {
+		int cmp = out->low ? compareKeyValues(b->low, out->low) : 1;
+		if (cmp > 0 || (cmp == 0 && !b->lowInclusive)) {
+			out->low = b->low;
+			out->lowInclusive = b->lowInclusive;
+		}
+	}
+	if (b->high) {
+		int cmp = out->high ? compareKeyValues(b->high, out->high) : -1;
+		if (cmp < 0 || (cmp == 0 && !b->highInclusive)) {
+			out->high = b->high;
+			out->highInclusive = b->highInclusive;
+		}
+	}
+	return !isEmptyRange(out);
+}
+
+// Drops empty ranges and merges overlapping or touching ones, so no row is
+// covered twice
+static int normalizeRanges(KeyRange *ranges, int numRanges) {
+	int n = 0, merged = 0;
+	for (int i = 0; i < numRanges; i++)
+		if (!isEmptyRange(&ranges[i])) ranges[n++] = ranges[i];
+	qsort(ranges, n, sizeof(KeyRange), compareLowBounds);
+	
+	for (int i = 0; i < n; i++) {
+		KeyRange *last = merged > 0 ? &ranges[merged - 1] : NULL;
+		KeyRange *range = &ranges[i];
+		bool overlaps = last && (!last->high || !range->low);
+		if (last && !overlaps) {
+			int cmp = compareKeyValues(range->low, last->high);
+			overlaps = cmp < 0 || (cmp == 0 && (last->highInclusive || range->lowInclusive));
+		}
+		if (!overlaps) {
+			ranges[merged++] = *range;
+			continue;
+		}
+		if (!last->high) continue;
+		if (!range->high) {
+			last->high = NULL;
+			continue;
+		}
+		int cmp = compareKeyValues(range->high, last->high);
+		if (cmp > 0) {
+			last->high = range->high;
+			last->highInclusive = range->highInclusive;
+		} else if (cmp == 0) {
+			last->highInclusive = last->highInclusive || range->highInclusive;
+		}
+	}
+	return merged;
+}
+
+// Hash indexes answer point ranges only; an unbounded range is better
+// served by the heap scan
+static bool indexServes(TableManager *tm, KeyRange *ranges, int numRanges) {
+	if (numRanges < 0) return false;
+	for (int i = 0; i < numRanges; i++) {
+		if (!ranges[i].low && !ranges[i].high) return false;
+		if (tm->indexKind == RM_INDEX_HASH
+				&& (!ranges[i].low || !ranges[i].high || compareKeyValues(ranges[i].low, ranges[i].high) != 0))
+			return false;
+	}
+	return true;
+}
+
+// Gathers the RIDs under every range and sorts them, so rows are fetched in
+// the order a heap scan returns them and each page is visited once
+static RC collectRids(TableManager *tm, KeyRange *ranges, int numRanges, ScanManager *sm) {
+	int capacity = 16;
+	RID rid;
+	RC rc = RC_OK;
+	
+	sm->rids = (RID *)malloc(capacity * sizeof(RID));
+	for (int i = 0; i < numRanges && rc == RC_OK; i++) {
+		BT_ScanHandle *treeScan = NULL;
+		HT_ScanHandle *hashScan = NULL;
+		// exclusive bounds are left to the condition
+		if (tm->indexKind == RM_INDEX_HASH)
+			rc = openHashScan(tm->hash, ranges[i].low, &hashScan);
+		else
+			rc = openTreeRangeScan(tm->btree, ranges[i].low, ranges[i].high, &treeScan);
+		if (rc != RC_OK) break;
+		while ((rc = hashScan ? nextHashEntry(hashScan, &rid) : nextEntry(treeScan, &rid)) == RC_OK) {
+			if (sm->numRids == capacity) {
+				capacity *= 2;
+				sm->rids = (RID *)realloc(sm->rids, capacity * sizeof(RID));
+			}
+			sm->rids[sm->numRids++] = rid;
+		}
+		if (hashScan) closeHashScan(hashScan);
+		else closeTreeScan(treeScan);
+		if (rc == RC_IM_NO_MORE_ENTRIES) rc = RC_OK;
+	}
+	if (rc == RC_OK) qsort(sm->rids, sm->numRids, sizeof(RID), compareRids);
+	return rc;
+}
+
+static int compareRids(const void *a, const void *b) {
+	const RID *x = (const RID *)a, *y = (const RID *)b;
+	if (x->page != y->page) return (x->page > y->page) - (x->page < y->page);
+	return (x->slot > y->slot) - (x->slot < y->slot);
+}
+
+// Rows deleted since the scan started are skipped; changed rows are checked
+// as they are now
+static RC nextIndexed(RM_ScanHandle *scan, Record *record) {
+	ScanManager *sm = (ScanManager *)scan->mgmtData;
+	TableManager *tm = (TableManager *)scan->rel->mgmtData;
+	char row[PAGE_SIZE];
+	Record view = { { 0, 0 }, row };
+	
+	while (sm->nextRid < sm->numRids) {
+		RID id = sm->rids[sm->nextRid++];
+		RC rc = getRecord(scan->rel, id, &view);
+		if (rc == RC_FILE_NOT_FOUND) continue;
+		if (rc != RC_OK) return rc;
+		
+		bool matches;
+		rc = evalCondition(sm->condition, sm->pred, &view, scan->rel->schema, &matches);
+		if (rc != RC_OK) return rc;
+		if (matches) {
+			record->id = id;
+			if (!record->data) record->data = (char *)malloc(sm->outSize);
+			emitRow(tm, sm, row, record->data);
+			return RC_OK;
+		}
+	}
+	
+	THROW(RC_RM_NO_MORE_TUPLES, "No more tuples");
+}
+
+static int zoneEntrySize(Schema *schema) {
+	return ZONE_HEADER_SIZE + schema->numAttr * ZONE_ATTR_SIZE;
+}
+
+// Opens <name>.zone, or rebuilds it from the rows when its entries may be
+// stale or the file is missing
+static RC openZones(RM_TableData *rel, char *name, bool rebuild) {
+	TableManager *tm = (TableManager *)rel->mgmtData;
+	char fileName[TABLE_FILE_NAME_SIZE(name)];
+	char row[PAGE_SIZE];
+	Record record = { { 0, 0 }, row };
+	RM_ScanHandle scan;
+	RC rc;
+	
+	snprintf(fileName, sizeof(fileName), "%s.zone", name);
+	tm->zones = (BM_BufferPool *)malloc(sizeof(BM_BufferPool));
+	if (!rebuild && initBufferPool(tm->zones, fileName, ZONE_POOL_SIZE, RS_LRU, NULL) == RC_OK)
+		return RC_OK;
+	
+	discardWorkingSet(fileName);
+	destroyPageFile(fileName);
+	rc = createPageFile(fileName);
+	if (rc == RC_OK) rc = initBufferPool(tm->zones, fileName, ZONE_POOL_SIZE, RS_LRU, NULL);
 	if (rc != RC_OK) {
-		free(ph);
+		free(tm->zones);
+		tm->zones = NULL;
 		return rc;
 	}
+	rc = startScan(rel, &scan, NULL);
+	if (rc != RC_OK) return rc;
+	while ((rc = next(&scan, &record)) == RC_OK) {
+		rc = widenZone(tm, record.id.page, row);
+		if (rc != RC_OK) break;
+	}
+	closeScan(&scan);
+	return rc == RC_RM_NO_MORE_TUPLES ? RC_OK : rc;
+}
+
+static void zoneValue(TableManager *tm, int attr, const char *row, char *value) {
+	ColumnInfo *column = &tm->columns[attr];
+	memset(value, 0, ZONE_VALUE_SIZE);
+	if (tm->schema->dataTypes[attr] == DT_STRING)
+		strncpy(value, row + column->rowOffset, column->size < ZONE_VALUE_SIZE ? column->size : ZONE_VALUE_SIZE);
+	else
+		memcpy(value, row + column->rowOffset, column->size);
+}
+
+static int compareZoneValues(DataType dt, const char *a, const char *b) {
+	switch (dt) {
+	case DT_INT: {
+		int x, y;
+		memcpy(&x, a, sizeof(int));
+		memcpy(&y, b, sizeof(int));
+		return (x > y) - (x < y);
+	}
+	case DT_FLOAT: {
+		float x, y;
+		memcpy(&x, a, sizeof(float));
+		memcpy(&y, b, sizeof(float));
+		return (x > y) - (x < y);
+	}
+	case DT_BOOL: return (int)*(const bool *)a - (int)*(const bool *)b;
+	case DT_STRING: return memcmp(a, b, ZONE_VALUE_SIZE);
+	}
+	return 0;
+}
+
+// Widens page's entry to cover row
+static RC widenZone(TableManager *tm, int page, const char *row) {
+	BM_PageHandle ph;
+	char value[ZONE_VALUE_SIZE];
+	bool changed = false;
+	if (!tm->zones) return RC_OK;
 	
-	int *header = (int *)ph->data;
-	char *tombstone = ph->data + PAGE_HEADER_SIZE + rid->slot * (recordSize + 1);
-	*tombstone = 0;
-	header[1]++;
+	RC rc = ensurePoolCapacity(tm->zones, page / tm->zonesPerPage + 1);
+	if (rc == RC_OK) rc = pinPage(tm->zones, &ph, page / tm->zonesPerPage);
+	if (rc != RC_OK) return rc;
+	char *entry = ph.data + (page % tm->zonesPerPage) * tm->zoneSize;
+	bool empty = *(int *)entry == 0;
+	for (int i = 0; i < tm->schema->numAttr; i++) {
+		char *min = entry + ZONE_HEADER_SIZE + i * ZONE_ATTR_SIZE;
+		char *max = min + ZONE_VALUE_SIZE;
+		DataType dt = tm->schema->dataTypes[i];
+		zoneValue(tm, i, row, value);
+		bool lower = empty || compareZoneValues(dt, value, min) < 0;
+		bool higher = empty || compareZoneValues(dt, value, max) > 0;
+		if ((lower || higher) && !changed) {
+			beginPageWrite(tm->zones, &ph);
+			changed = true;
+		}
+		if (lower) memcpy(min, value, ZONE_VALUE_SIZE);
+		if (higher) memcpy(max, value, ZONE_VALUE_SIZE);
+	}
+	if (changed) {
+		*(int *)entry = 1;
+		markDirty(tm->zones, &ph);
+	}
+	return unpinPage(tm->zones, &ph);
+}
+
+// False only if page's zone map proves no row there satisfies cond
+static bool pageMayMatch(TableManager *tm, Expr *cond, int page) {
+	BM_PageHandle ph;
+	if (!tm->zones) return true;
+	if (pinPage(tm->zones, &ph, page / tm->zonesPerPage) != RC_OK) return true;
+	bool mayMatch = entryMayMatch(tm, cond, ph.data + (page % tm->zonesPerPage) * tm->zoneSize);
+	unpinPage(tm->zones, &ph);
+	return mayMatch;
+}
+
+static bool entryMayMatch(TableManager *tm, Expr *cond, const char *entry) {
+	return *(int *)entry != 0 && zoneMayMatch(tm, cond, entry);
+}
+
+static bool zoneMayMatch(TableManager *tm, Expr *expr, const char *entry) {
+	if (expr->type != EXPR_OP) return true;
+	Operator *op = expr->expr.op;
+	switch (op->type) {
+	case OP_BOOL_AND:
+		return zoneMayMatch(tm, op->args[0], entry) && zoneMayMatch(tm, op->args[1], entry);
+	case OP_BOOL_OR:
+		return zoneMayMatch(tm, op->args[0], entry) || zoneMayMatch(tm, op->args[1], entry);
+	case OP_BOOL_NOT:
+		if (op->args[0]->type != EXPR_OP || op->args[0]->expr.op->type != OP_COMP_SMALLER) return true;
+		return comparisonMayMatch(tm, op->args[0]->expr.op, true, entry);
+	case OP_COMP_EQUAL:
+	case OP_COMP_SMALLER:
+		return comparisonMayMatch(tm, op, false, entry);
+	}
+	return true;
+}
+
+// attr = c, attr < c or c < attr; negated turns the comparison into
+// attr >= c or attr <= c
+static bool comparisonMayMatch(TableManager *tm, Operator *op, bool negated, const char *entry) {
+	Expr *left = op->args[0], *right = op->args[1];
+	bool attrLeft = left->type == EXPR_ATTRREF && right->type == EXPR_CONST;
+	if (!attrLeft && !(right->type == EXPR_ATTRREF && left->type == EXPR_CONST)) return true;
+	int attr = attrLeft ? left->expr.attrRef : right->expr.attrRef;
+	Value *cons = attrLeft ? right->expr.cons : left->expr.cons;
+	DataType dt = tm->schema->dataTypes[attr];
+	if (cons->dt != dt) return true;
+	
+	const char *min = entry + ZONE_HEADER_SIZE + attr * ZONE_ATTR_SIZE;
+	const char *max = min + ZONE_VALUE_SIZE;
+	if (op->type == OP_COMP_EQUAL)
+		return !zoneAbove(dt, min, cons, true) && !zoneBelow(dt, max, cons, true);
+	if (attrLeft)
+		return negated ? !zoneBelow(dt, max, cons, true) : !zoneAbove(dt, min, cons, false);
+	return negated ? !zoneAbove(dt, min, cons, true) : !zoneBelow(dt, max, cons, false);
+}
+
+// Whether every value at or above min is > cons (strict) or >= cons. A
+// string prefix sorts at or below the strings it starts.
+static bool zoneAbove(DataType dt, const char *min, Value *cons, bool strict) {
+	char value[ZONE_VALUE_SIZE + 1];
+	int cmp;
+	if (dt == DT_STRING) {
+		memcpy(value, min, ZONE_VALUE_SIZE);
+		value[ZONE_VALUE_SIZE] = '\0';
+		cmp = strcmp(value, cons->v.stringV);
+	} else {
+		memcpy(value, &cons->v, ZONE_VALUE_SIZE);
+		cmp = compareZoneValues(dt, min, value);
+	}
+	return strict ? cmp > 0 : cmp >= 0;
+}
+
+// Whether every value at or below max is < cons (strict) or <= cons. A full
+// prefix stands for every string that starts with it.
+static bool zoneBelow(DataType dt, const char *max, Value *cons, bool strict) {
+	char value[ZONE_VALUE_SIZE + 1];
+	int cmp;
+	if (dt == DT_STRING) {
+		memcpy(value, max, ZONE_VALUE_SIZE);
+		value[ZONE_VALUE_SIZE] = '\0';
+		if (strlen(value) == ZONE_VALUE_SIZE)
+			return strncmp(value, cons->v.stringV, ZONE_VALUE_SIZE) < 0;
+		cmp = strcmp(value, cons->v.stringV);
+	} else {
+		memcpy(value, &cons->v, ZONE_VALUE_SIZE);
+		cmp = compareZoneValues(dt, max, value);
+	}
+	return strict ? cmp < 0 : cmp <= 0;
+}
+
+// The scan's page, or the first page after it that zone maps do not rule out
+static int candidatePage(TableManager *tm, ScanManager *sm) {
+	int page = sm->currentPage;
+	if (!sm->condition || sm->currentSlot != 0) return page;
+	while (page >= 0 && !pageMayMatch(tm, sm->condition, page))
+		page = nextDataPage(tm, page);
+	return page;
+}
+
+// Lays out the projected records of a scan as rows of a derived schema with
+// attrs in the order given, the table's record layout and those of its key
+// attributes that are projected
+static void projectSchema(Schema *schema, TableManager *tm, int *attrs, int numAttrs, ScanManager *sm) {
+	char **names = (char **)malloc(numAttrs * sizeof(char *));
+	DataType *dataTypes = (DataType *)malloc(numAttrs * sizeof(DataType));
+	int *typeLength = (int *)malloc(numAttrs * sizeof(int));
+	int *keys = (int *)malloc(numAttrs * sizeof(int));
+	int keySize = 0;
+	
+	sm->projAttrs = (int *)malloc(numAttrs * sizeof(int));
+	sm->projOffsets = (int *)malloc(numAttrs * sizeof(int));
+	sm->numProjAttrs = numAttrs;
+	for (int i = 0; i < numAttrs; i++) {
+		names[i] = schema->attrNames[attrs[i]];
+		dataTypes[i] = schema->dataTypes[attrs[i]];
+		typeLength[i] = schema->typeLength[attrs[i]];
+		for (int k = 0; k < schema->keySize; k++)
+			if (schema->keyAttrs[k] == attrs[i]) keys[keySize++] = i;
+		sm->projAttrs[i] = attrs[i];
+	}
+	sm->projSchema = createSchemaWithLayout(numAttrs, names, dataTypes, typeLength, keySize, keys, schema->layout);
+	for (int i = 0; i < numAttrs; i++)
+		sm->projOffsets[i] = sm->projSchema->attrOffsets[i];
+	sm->outSize = sm->projSchema->recordSize;
+	sm->row = (char *)malloc(tm->recordSize);
+	free(names);
+	free(dataTypes);
+	free(typeLength);
+	free(keys);
+}
+
+// Copies a matching row out of row to the scan's output
+static void emitRow(TableManager *tm, ScanManager *sm, const char *row, char *out) {
+	if (!sm->projAttrs) {
+		memcpy(out, row, tm->recordSize);
+		return;
+	}
+	for (int i = 0; i < sm->numProjAttrs; i++) {
+		ColumnInfo *column = &tm->columns[sm->projAttrs[i]];
+		memcpy(out + sm->projOffsets[i], row + column->rowOffset, column->size);
+	}
+}
+
+// Gathers the projected attributes of a PAX row straight from their columns
+static void emitPaxRow(TableManager *tm, ScanManager *sm, char *page, int slot, char *out) {
+	for (int i = 0; i < sm->numProjAttrs; i++) {
+		ColumnInfo *column = &tm->columns[sm->projAttrs[i]];
+		memcpy(out + sm->projOffsets[i], page + column->pageOffset + slot * column->size, column->size);
+	}
+}
+
+// Finds the next matching row of a fixed-format table and returns it in
+// view, pointing into its page, which is left pinned in ph
+static RC nextFixed(RM_ScanHandle *scan, BM_PageHandle *ph, Record *view) {
+	ScanManager *sm = (ScanManager *)scan->mgmtData;
+	TableManager *tm = (TableManager *)scan->rel->mgmtData;
+	RC rc;
+	
+	while ((sm->currentPage = candidatePage(tm, sm)) >= 0) {
+		rc = pinPage(tm->bm, ph, sm->currentPage);
+		if (rc != RC_OK) return rc;
+		
+		int *header = (int *)ph->data;
+		int numSlots = header[0];
+		
+		while ((sm->currentSlot = nextUsedSlot(ph->data, sm->currentSlot, numSlots)) < numSlots) {
+			// the condition is evaluated on the row in place
+			view->id.page = sm->currentPage;
+			view->id.slot = sm->currentSlot;
+			view->data = getRecordDataPointer(tm, ph->data, sm->currentSlot);
+			
+			bool matches;
+			rc = evalCondition(sm->condition, sm->pred, view, scan->rel->schema, &matches);
+			if (rc != RC_OK) {
+				unpinPage(tm->bm, ph);
+				return rc;
+			}
+			
+			sm->currentSlot++;
+			if (matches) return RC_OK;
+		}
+		
+		sm->currentPage = nextDataPage(tm, sm->currentPage);
+		sm->currentSlot = 0;
+		unpinPage(tm->bm, ph);
+		if (tm->readAhead > 0 && sm->currentPage >= 0)
+			prefetchPages(tm->bm, sm->currentPage, tm->readAhead);
+	}
+	
+	THROW(RC_RM_NO_MORE_TUPLES, "No more tuples");
+}
+
+// Appends the page's matching rows from sm->currentSlot on to batch, leaving
+// currentSlot after the last row examined. Each candidate row is assembled
+// directly in its batch entry, which the next candidate reuses if it fails.
+static RC batchFromPage(RM_ScanHandle *scan, char *page, RecordBatch *batch, int max) {
+	ScanManager *sm = (ScanManager *)scan->mgmtData;
+	TableManager *tm = (TableManager *)scan->rel->mgmtData;
+	Schema *schema = scan->rel->schema;
+	BM_PageHandle rowPh;
+	Record record, view;
+	bool matches;
+	RC rc;
+	
+	if (tm->format == RM_PAGE_SLOTTED) {
+		char *data;
+		int length, flags;
+		for (; batch->numRecords < max && sm->currentSlot < spNumEntries(page); sm->currentSlot++) {
+			if (!spGet(page, sm->currentSlot, &data, &length, &flags) || (flags & SP_MOVED))
+				continue;
+			record.id.page = sm->currentPage;
+			record.id.slot = sm->currentSlot;
+			record.data = batch->data + batch->numRecords * tm->recordSize;
+			if (flags & SP_FORWARD) {
+				if ((rc = pinSlottedRow(tm, record.id, &rowPh, &data, &length)) != RC_OK) return rc;
+				decodeRecord(tm, data, record.data);
+				unpinPage(tm->bm, &rowPh);
+			} else
+				decodeRecord(tm, data, record.data);
+			if ((rc = evalCondition(sm->condition, sm->pred, &record, schema, &matches)) != RC_OK) return rc;
+			if (matches) batch->ids[batch->numRecords++] = record.id;
+		}
+		return RC_OK;
+	}
 	
-	markDirty(bm, ph);
-	unpinPage(bm, ph);
-	free(ph);
+	int numSlots = ((int *)page)[0];
+	uint64_t selected[MAX_SLOT_WORDS];
+	uint64_t *slots = slotBitmap(page);
+	bool vectorized = sm->pred != NULL;
+	if (vectorized) slots = selectRows(tm, sm->pred, page, sm->currentSlot, selected);
+	while (batch->numRecords < max && (sm->currentSlot = nextSetBit(slots, sm->currentSlot, numSlots)) < numSlots) {
+		int slot = sm->currentSlot++;
+		record.id.page = sm->currentPage;
+		record.id.slot = slot;
+		record.data = batch->data + batch->numRecords * tm->recordSize;
+		if (tm->format == RM_PAGE_PAX) {
+			if (sm->condition && !vectorized) {
+				readColumns(tm, page, slot, record.data, sm->condAttrs, sm->numCondAttrs);
+				if ((rc = evalCondition(sm->condition, sm->pred, &record, schema, &matches)) != RC_OK) return rc;
+				if (!matches) continue;
+			}
+			readRow(tm, page, slot, record.data);
+		} else {
+			view.id = record.id;
+			view.data = getRecordDataPointer(tm, page, slot);
+			if (!vectorized) {
+				if ((rc = evalCondition(sm->condition, sm->pred, &view, schema, &matches)) != RC_OK) return rc;
+				if (!matches) continue;
+			}
+			memcpy(record.data, view.data, tm->recordSize);
+		}
+		batch->ids[batch->numRecords++] = record.id;
+	}
 	return RC_OK;
 }
 
-static bool isSlotUsed(char *page, int slot, int recordSize) {
-	char *tombstone = page + PAGE_HEADER_SIZE + slot * (recordSize + 1);
-	return (*tombstone == 1);
+static void *scanWorker(void *arg) {
+	ScanWorker *w = (ScanWorker *)arg;
+	ParallelScan *ps = w->scan;
+	TableManager *tm = (TableManager *)ps->rel->mgmtData;
+	// the page, then the target page of a forwarded slotted row
+	char *copy = (char *)malloc(2 * PAGE_SIZE);
+	Record record;
+	record.data = (char *)malloc(tm->recordSize);
+	bool mayMatch;
+	RC rc = RC_OK;
+	
+	// predicates keep pass-rate statistics, so every worker compiles its own
+	Predicate *pred = NULL;
+	if (ps->cond) compilePredicate(ps->cond, ps->rel->schema, &pred);
+	
+	while (rc == RC_OK && !__atomic_load_n(&ps->stop, __ATOMIC_RELAXED)) {
+		int first = __atomic_fetch_add(&ps->nextMorsel, MORSEL_PAGES, __ATOMIC_RELAXED);
+		if (first >= tm->numPages) break;
+		for (int page = first; rc == RC_OK && page < first + MORSEL_PAGES && page < tm->numPages; page++) {
+			if (isMapPage(page)) continue;
+			rc = copyPage(ps, page, copy, &mayMatch);
+			if (rc == RC_OK && mayMatch)
+				rc = scanPageCopy(ps, pred, w->worker, page, copy, &record);
+		}
+	}
+	
+	if (rc != RC_OK) {
+		pthread_mutex_lock(&ps->poolLock);
+		if (ps->rc == RC_OK) ps->rc = rc;
+		__atomic_store_n(&ps->stop, 1, __ATOMIC_RELAXED);
+		pthread_mutex_unlock(&ps->poolLock);
+	}
+	freePredicate(pred);
+	free(record.data);
+	free(copy);
+	return NULL;
 }
 
-static char* getRecordDataPointer(char *page, int slot, int recordSize) {
-	return page + PAGE_HEADER_SIZE + slot * (recordSize + 1) + 1;
+// Copies a data page out of the pool, so no frame stays pinned while its
+// rows are evaluated; pages the zone maps rule out are not read
+static RC copyPage(ParallelScan *ps, int page, char *copy, bool *mayMatch) {
+	TableManager *tm = (TableManager *)ps->rel->mgmtData;
+	*mayMatch = true;
+	if (ps->cond && tm->zones) {
+		char entry[tm->zoneSize];
+		if (copyFromPool(ps, tm->zones, page / tm->zonesPerPage, (page % tm->zonesPerPage) * tm->zoneSize, tm->zoneSize, entry) == RC_OK)
+			*mayMatch = entryMayMatch(tm, ps->cond, entry);
+	}
+	return *mayMatch ? copyFromPool(ps, tm->bm, page, 0, PAGE_SIZE, copy) : RC_OK;
 }
 
-static int getNextFreePage(char *page) {
-	return ((int *)page)[2];
+// Copies a resident page range without poolLock. A miss pins the page under
+// the lock and copies it after dropping the lock; the pin keeps the frame in
+// place meanwhile.
+static RC copyFromPool(ParallelScan *ps, BM_BufferPool *bm, int page, int offset, int length, char *dest) {
+	BM_PageHandle ph;
+	RC rc = readPageIfResident(bm, page, offset, length, dest);
+	if (rc != RC_PAGE_NOT_RESIDENT) return rc;
+	pthread_mutex_lock(&ps->poolLock);
+	rc = pinPage(bm, &ph, page);
+	pthread_mutex_unlock(&ps->poolLock);
+	if (rc != RC_OK) return rc;
+	memcpy(dest, ph.data + offset, length);
+	pthread_mutex_lock(&ps->poolLock);
+	rc = unpinPage(bm, &ph);
+	pthread_mutex_unlock(&ps->poolLock);
+	return rc;
 }
 
-static void setNextFreePage(char *page, int nextPage) {
-	((int *)page)[2] = nextPage;
+static RC scanPageCopy(ParallelScan *ps, Predicate *pred, int worker, int page, char *copy, Record *record) {
+	TableManager *tm = (TableManager *)ps->rel->mgmtData;
+	Schema *schema = ps->rel->schema;
+	Record view;
+	bool matches;
+	RC rc;
+	
+	if (tm->format == RM_PAGE_SLOTTED) {
+		char *data, *moved = copy + PAGE_SIZE;
+		int length, flags, movedPage = -1;
+		RID target;
+		for (int slot = 0; slot < spNumEntries(copy); slot++) {
+			if (!spGet(copy, slot, &data, &length, &flags) || (flags & SP_MOVED))
+				continue;
+			record->id.page = page;
+			record->id.slot = slot;
+			if (flags & SP_FORWARD) {
+				// rows forwarded to the same page share one copy of it
+				memcpy(&target, data, sizeof(RID));
+				if (target.page != movedPage) {
+					if ((rc = copyFromPool(ps, tm->bm, target.page, 0, PAGE_SIZE, moved)) != RC_OK) return rc;
+					movedPage = target.page;
+				}
+				if (!spGet(moved, target.slot, &data, &length, &flags))
+					THROW(RC_FILE_NOT_FOUND, "Record not found");
+				decodeRecord(tm, data, record->data);
+			} else
+				decodeRecord(tm, data, record->data);
+			if ((rc = evalCondition(ps->cond, pred, record, schema, &matches)) != RC_OK) return rc;
+			if (matches && (rc = ps->callback(record, worker, ps->callbackData)) != RC_OK) return rc;
+		}
+		return RC_OK;
+	}
+	
+	int numSlots = ((int *)copy)[0];
+	uint64_t selected[MAX_SLOT_WORDS];
+	uint64_t *slots = slotBitmap(copy);
+	bool vectorized = pred != NULL;
+	if (vectorized) slots = selectRows(tm, pred, copy, 0, selected);
+	for (int slot = 0; (slot = nextSetBit(slots, slot, numSlots)) < numSlots; slot++) {
+		if (tm->format == RM_PAGE_PAX) {
+			if (ps->cond && !vectorized) {
+				readColumns(tm, copy, slot, record->data, ps->condAttrs, ps->numCondAttrs);
+				if ((rc = evalCondition(ps->cond, pred, record, schema, &matches)) != RC_OK) return rc;
+				if (!matches) continue;
+			}
+			readRow(tm, copy, slot, record->data);
+			view.data = record->data;
+		} else {
+			// fixed rows are evaluated and handed out in place in the copy
+			view.data = getRecordDataPointer(tm, copy, slot);
+			view.id.page = page;
+			view.id.slot = slot;
+			if (!vectorized) {
+				if ((rc = evalCondition(ps->cond, pred, &view, schema, &matches)) != RC_OK) return rc;
+				if (!matches) continue;
+			}
+		}
+		view.id.page = page;
+		view.id.slot = slot;
+		if ((rc = ps->callback(&view, worker, ps->callbackData)) != RC_OK) return rc;
+	}
+	return RC_OK;
 }
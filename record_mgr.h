@@ -4,6 +4,7 @@
 #include "dberror.h"
 #include "expr.h"
 #include "tables.h"
+#include "buffer_mgr.h"
 
 // Bookkeeping for scans
 typedef struct RM_ScanHandle
@@ -12,29 +13,142 @@ typedef struct RM_ScanHandle
 	void *mgmtData;
 } RM_ScanHandle;
 
+// Buffer pool settings for a table. Pass one to initRecordManager to set the
+// defaults for every table, or to openTableWithConfig to override them for
+// one table; NULL keeps the current defaults.
+typedef enum RM_WritePolicy {
+	RM_WRITE_BACK = 0,    // dirty pages are written on eviction and close
+	RM_WRITE_THROUGH = 1  // every modifying call flushes its pages
+} RM_WritePolicy;
+
+// Every RM_CHECKPOINT_WRITES modifying calls, and when it is closed, a table
+// checkpoints its buffer pool: dirty pages are flushed and the resident
+// pages are saved for warm restart
+#define RM_CHECKPOINT_WRITES 4096
+
+typedef struct RM_Config
+{
+	int numPages;
+	ReplacementStrategy strategy;
+	void *stratData;
+	int readAhead;        // pages prefetched ahead of a scan, 0 disables
+	RM_WritePolicy writePolicy;
+} RM_Config;
+
+// On-disk layout of a table's data pages, chosen at createTable time
+typedef enum RM_PageFormat {
+	RM_PAGE_FIXED = 0,    // fixed-size slots with an occupancy bitmap
+	RM_PAGE_SLOTTED = 1,  // slot directory with variable-length records; strings
+	                      // are stored at their actual length
+	RM_PAGE_PAX = 2       // fixed-size slots stored column by column within each
+	                      // page, so scans read only the columns they test
+} RM_PageFormat;
+
+// Index kept on a table's key attribute. Tables have none unless created with
+// createTableWithIndex; an index lives in <table>.idx and every insert, delete
+// and key change pays for updating it.
+typedef enum RM_IndexKind {
+	RM_INDEX_NONE = 0,
+	RM_INDEX_BTREE = 1,   // ordered; serves equality and range lookups
+	RM_INDEX_HASH = 2     // linear hashing; about one page per equality lookup
+} RM_IndexKind;
+
+// Caller-owned output of nextBatch: up to capacity rows of getRecordSize
+// bytes stored back to back in data, with their RIDs in ids
+typedef struct RecordBatch
+{
+	int capacity;
+	int numRecords;
+	RID *ids;
+	char *data;
+} RecordBatch;
+
+// Read-only access to a record without copying it out of the buffer pool.
+// For fixed-format tables record.data points into the row's page, which
+// stays pinned until releaseRecordView. Slotted and PAX rows are not stored
+// as contiguous rows and are assembled in a buffer owned by the view.
+// Every view that was filled must be released before it is reused.
+typedef struct RM_RecordView
+{
+	Record record;
+	RM_TableData *rel;
+	BM_PageHandle page;
+	bool pinned;
+	char *buffer;
+} RM_RecordView;
+
+// Callback for updateWhere. The setter changes record->data in place (e.g.
+// with setAttr); it must not replace or free record->data, which may point
+// into the pinned page.
+typedef RC (*RM_RecordSetter) (Record *record, Schema *schema, void *setterData);
+
 // table and manager
 extern RC initRecordManager (void *mgmtData);
 extern RC shutdownRecordManager ();
 extern RC createTable (char *name, Schema *schema);
+extern RC createTableWithFormat (char *name, Schema *schema, RM_PageFormat format);
+extern RC createTableWithIndex (char *name, Schema *schema, RM_PageFormat format, RM_IndexKind index);
 extern RC openTable (RM_TableData *rel, char *name);
+extern RC openTableWithConfig (RM_TableData *rel, char *name, RM_Config *config);
 extern RC closeTable (RM_TableData *rel);
 extern RC deleteTable (char *name);
 extern int getNumTuples (RM_TableData *rel);
+// The buffer pool holding an open table's pages, e.g. for getNumReadIO;
+// owned by the table
+extern BM_BufferPool *getTableBufferPool (RM_TableData *rel);
 
 // handling records in a table
 extern RC insertRecord (RM_TableData *rel, Record *record);
+// Inserts numRecords records, filling each target page in one pin. Sets every
+// record's id and, if rids is not NULL, rids[i]. On error the records before
+// the failing one are already inserted.
+extern RC insertRecords (RM_TableData *rel, Record **records, int numRecords, RID *rids);
 extern RC deleteRecord (RM_TableData *rel, RID id);
 extern RC updateRecord (RM_TableData *rel, Record *record);
 extern RC getRecord (RM_TableData *rel, RID id, Record *record);
+extern RC getRecordView (RM_TableData *rel, RID id, RM_RecordView *view);
+extern RC releaseRecordView (RM_RecordView *view);
+// Set-oriented variants: every data page is pinned and dirtied at most once,
+// and cond (NULL matches every row) is evaluated on the rows in place. On
+// slotted tables, rows forwarded to another page and updates that no longer
+// fit their page also pin the other pages involved.
+extern RC deleteWhere (RM_TableData *rel, Expr *cond);
+extern RC updateWhere (RM_TableData *rel, Expr *cond, RM_RecordSetter setter, void *setterData);
 
 // scans
 extern RC startScan (RM_TableData *rel, RM_ScanHandle *scan, Expr *cond);
 extern RC next (RM_ScanHandle *scan, Record *record);
 extern RC closeScan (RM_ScanHandle *scan);
+// Like startScan, but records returned by the scan hold only the numAttrs
+// attributes listed in attrs, in that order, laid out as records of
+// getScanSchema(scan). cond still refers to the table's attributes.
+extern RC startScanWithProjection (RM_TableData *rel, RM_ScanHandle *scan, Expr *cond, int *attrs, int numAttrs);
+// Schema of the records a scan returns; owned by the scan
+extern Schema *getScanSchema (RM_ScanHandle *scan);
+// Copies up to max (at most batch->capacity) of the next matching records
+// into batch, pinning each page once per call. Returns RC_RM_NO_MORE_TUPLES
+// once no record is left; next and nextBatch may be mixed on one scan.
+extern RC nextBatch (RM_ScanHandle *scan, RecordBatch *batch, int max);
+// Like next, but returns the record as a view
+extern RC nextView (RM_ScanHandle *scan, RM_RecordView *view);
+
+// Callback for parallelScan, called for each matching record by the worker
+// (0 .. numThreads-1) that found it. Calls from different workers run
+// concurrently; record and its data are only valid during the call. Any
+// result but RC_OK stops the scan and is returned by parallelScan.
+typedef RC (*RM_ScanCallback) (Record *record, int worker, void *callbackData);
+
+// Scans the table with numThreads workers that claim runs of pages from a
+// shared cursor. The table must not be modified until it returns.
+extern RC parallelScan (RM_TableData *rel, Expr *cond, int numThreads, RM_ScanCallback callback, void *callbackData);
 
 // dealing with schemas
 extern int getRecordSize (Schema *schema);
 extern Schema *createSchema (int numAttr, char **attrNames, DataType *dataTypes, int *typeLength, int keySize, int *keys);
+// LAYOUT_ALIGNED stores ints and floats first, then bools, then strings, and
+// pads the record to a multiple of 4, so each number is read with one
+// aligned load; attribute numbers keep their declaration order
+extern Schema *createSchemaWithLayout (int numAttr, char **attrNames, DataType *dataTypes, int *typeLength, int keySize, int *keys, RecordLayout layout);
 extern RC freeSchema (Schema *schema);
 
 // dealing with records and attribute values
@@ -42,5 +156,19 @@ extern RC createRecord (Record **record, Schema *schema);
 extern RC freeRecord (Record *record);
 extern RC getAttr (Record *record, Schema *schema, int attrNum, Value **value);
 extern RC setAttr (Record *record, Schema *schema, int attrNum, Value *value);
+// Typed access without allocation. Each getter reads its attribute straight
+// from record->data and fails with RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE
+// if the attribute has another type. getStringAttrRef points value at the
+// bytes in the record, which are not NUL-terminated when the string fills
+// its width, and sets length to the string's length.
+extern RC getIntAttr (Record *record, Schema *schema, int attrNum, int *value);
+extern RC getFloatAttr (Record *record, Schema *schema, int attrNum, float *value);
+extern RC getBoolAttr (Record *record, Schema *schema, int attrNum, bool *value);
+extern RC getStringAttrRef (Record *record, Schema *schema, int attrNum, const char **value, int *length);
+// Stores a raw value of the attribute's type: an int, float or bool, or for
+// strings length bytes, cut to the attribute's width and NUL-padded
+extern RC setAttrRaw (Record *record, Schema *schema, int attrNum, const void *value, int length);
+extern RC createRecordBatch (RecordBatch **batch, Schema *schema, int capacity);
+extern RC freeRecordBatch (RecordBatch *batch);
 
 #endif // RECORD_MGR_H
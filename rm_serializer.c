@@ -286,6 +286,11 @@ attrOffset (Schema *schema, int attrNum, int *result)
 	int offset = 0;
 	int attrPos = 0;
 
+	if (schema->attrOffsets)
+	{
+		*result = schema->attrOffsets[attrNum];
+		return RC_OK;
+	}
 	for(attrPos = 0; attrPos < attrNum; attrPos++)
 		switch (schema->dataTypes[attrPos])
 		{
@@ -0,0 +1,115 @@
+#include <string.h>
+#include "slotted_page.h"
+
+typedef struct SP_Entry {
+	uint16_t offset; // 0 marks a free entry
+	uint16_t length; // record length plus SP_FORWARD / SP_MOVED flags
+} SP_Entry;
+
+static int *spHeader(char *page) {
+	return (int *)page;
+}
+
+static SP_Entry *spEntries(char *page) {
+	return (SP_Entry *)(page + SP_HEADER_SIZE);
+}
+
+static int spFreeEntry(char *page) {
+	int *header = spHeader(page);
+	SP_Entry *entries = spEntries(page);
+	for (int i = 0; i < header[0]; i++)
+		if (entries[i].offset == 0) return i;
+	return -1;
+}
+
+// Closes the hole left by a slot's bytes by shifting everything below it up
+static void spRemoveBytes(char *page, int slot) {
+	int *header = spHeader(page);
+	SP_Entry *entries = spEntries(page);
+	int offset = entries[slot].offset;
+	int length = entries[slot].length & SP_LENGTH_MASK;
+
+	memmove(page + header[2] + length, page + header[2], offset - header[2]);
+	for (int i = 0; i < header[0]; i++)
+		if (entries[i].offset != 0 && entries[i].offset < offset)
+			entries[i].offset += length;
+	header[2] += length;
+	entries[slot].offset = 0;
+	entries[slot].length = 0;
+}
+
+static void spPlace(char *page, int slot, const char *data, int length, int flags) {
+	int *header = spHeader(page);
+	SP_Entry *entries = spEntries(page);
+	header[2] -= length;
+	memcpy(page + header[2], data, length);
+	entries[slot].offset = header[2];
+	entries[slot].length = length | flags;
+}
+
+void spInitPage(char *page) {
+	int *header = spHeader(page);
+	header[0] = 0;
+	header[1] = 0;
+	header[2] = PAGE_SIZE;
+	header[3] = 0;
+}
+
+int spNumEntries(char *page) {
+	return spHeader(page)[0];
+}
+
+int spNumOccupied(char *page) {
+	return spHeader(page)[1];
+}
+
+int spFreeBytes(char *page) {
+	int *header = spHeader(page);
+	return header[2] - SP_HEADER_SIZE - header[0] * SP_ENTRY_SIZE;
+}
+
+bool spFits(char *page, int length) {
+	int need = length + (spFreeEntry(page) == -1 ? SP_ENTRY_SIZE : 0);
+	return spFreeBytes(page) >= need;
+}
+
+bool spCanUpdate(char *page, int slot, int length) {
+	SP_Entry *entries = spEntries(page);
+	return spFreeBytes(page) + (entries[slot].length & SP_LENGTH_MASK) >= length;
+}
+
+int spInsert(char *page, const char *data, int length, int flags) {
+	int *header = spHeader(page);
+	int slot = spFreeEntry(page);
+	if (!spFits(page, length)) return -1;
+	if (slot == -1) slot = header[0]++;
+	spPlace(page, slot, data, length, flags);
+	header[1]++;
+	return slot;
+}
+
+bool spUpdate(char *page, int slot, const char *data, int length, int flags) {
+	if (!spCanUpdate(page, slot, length)) return false;
+	spRemoveBytes(page, slot);
+	spPlace(page, slot, data, length, flags);
+	return true;
+}
+
+bool spGet(char *page, int slot, char **data, int *length, int *flags) {
+	SP_Entry *entries = spEntries(page);
+	if (slot < 0 || slot >= spHeader(page)[0] || entries[slot].offset == 0) return false;
+	*data = page + entries[slot].offset;
+	*length = entries[slot].length & SP_LENGTH_MASK;
+	*flags = entries[slot].length & ~SP_LENGTH_MASK;
+	return true;
+}
+
+void spDelete(char *page, int slot) {
+	int *header = spHeader(page);
+	SP_Entry *entries = spEntries(page);
+	spRemoveBytes(page, slot);
+	header[1]--;
+	// trailing free entries hold no live RIDs and give their space back
+	while (header[0] > 0 && entries[header[0] - 1].offset == 0)
+		header[0]--;
+}
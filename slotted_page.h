@@ -0,0 +1,38 @@
+#ifndef SLOTTED_PAGE_H
+#define SLOTTED_PAGE_H
+
+#include <stdint.h>
+#include "dberror.h"
+#include "dt.h"
+
+// Slotted page for variable-length records: a header, a slot directory that
+// grows up from the header and record bytes that grow down from the end of
+// the page. Deletes and updates compact the record area right away, so the
+// free space between directory and records is always contiguous.
+//
+// header ints: [0] directory entries, [1] occupied entries,
+//              [2] start of the record area, [3] reserved
+
+#define SP_HEADER_SIZE (sizeof(int) * 4)
+#define SP_ENTRY_SIZE (sizeof(uint16_t) * 2)
+#define SP_USABLE_SIZE ((int)(PAGE_SIZE - SP_HEADER_SIZE))
+
+// flags kept in the top bits of an entry's length
+#define SP_FORWARD 0x8000   // the entry holds the RID its record moved to
+#define SP_MOVED 0x4000     // the record is reached through a forwarding entry
+#define SP_LENGTH_MASK 0x3FFF
+
+extern void spInitPage (char *page);
+extern int spNumEntries (char *page);
+extern int spNumOccupied (char *page);
+extern int spFreeBytes (char *page);
+extern bool spFits (char *page, int length);
+extern bool spCanUpdate (char *page, int slot, int length);
+
+// all return false / -1 without touching the page when the record doesn't fit
+extern int spInsert (char *page, const char *data, int length, int flags);
+extern bool spUpdate (char *page, int slot, const char *data, int length, int flags);
+extern bool spGet (char *page, int slot, char **data, int *length, int *flags);
+extern void spDelete (char *page, int slot);
+
+#endif // SLOTTED_PAGE_H
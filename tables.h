@@ -32,6 +32,13 @@ typedef struct Record
 	char *data;
 } Record;
 
+// How a schema places attributes in a record: packed in declaration order,
+// or ordered so every int and float is naturally aligned
+typedef enum RecordLayout {
+	LAYOUT_PACKED = 0,
+	LAYOUT_ALIGNED = 1
+} RecordLayout;
+
 // information of a table schema: its attributes, datatypes, 
 typedef struct Schema
 {
@@ -41,6 +48,14 @@ typedef struct Schema
 	int *typeLength;
 	int *keyAttrs;
 	int keySize;
+	// derived from the above when the schema is created or read: each
+	// attribute's offset and size in a record, and the record size. A
+	// Schema must come from createSchema or createSchemaWithLayout; the
+	// record manager does not fill these in for one built by hand
+	RecordLayout layout;
+	int *attrOffsets;
+	int *attrSizes;
+	int recordSize;
 } Schema;
 
 // TableData: Management Structure for a Record Manager to handle one relation
@@ -0,0 +1,479 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "dberror.h"
+#include "buffer_mgr.h"
+#include "storage_mgr.h"
+#include "btree_mgr.h"
+#include "record_mgr.h"
+#include "tables.h"
+#include "test_helper.h"
+
+// test methods
+static void testWarmRestart (void);
+static void testOptimisticReads (void);
+static void testReplacementModels (void);
+static void testFifoPinnedFrame (void);
+
+// helper methods
+static void createTestFile (char *name, int numPages);
+static bool fileExists (char *name);
+static bool isResident (BM_BufferPool *bm, PageNumber pageNum);
+static void checkAgainstModel (int numFrames, ReplacementStrategy strategy);
+static int modelVictim (ReplacementStrategy strategy, int numFrames, int *fixCounts, int *lastUsed, bool *refs, int *queue, int *hand);
+
+// frame-by-frame reference model of the pool used by testReplacementModels
+#define MODEL_MAX_FRAMES 130
+
+// test name
+char *testName;
+
+// main method
+int
+main (void)
+{
+	testName = "";
+
+	testWarmRestart();
+	testOptimisticReads();
+	testReplacementModels();
+	testFifoPinnedFrame();
+
+	return 0;
+}
+
+// ************************************************************
+void
+testWarmRestart (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	SM_FileHandle fh;
+	RM_TableData table;
+	Record *r;
+	Schema *schema;
+	BTreeHandle *tree;
+	FILE *file;
+	int i;
+	char *names[] = { "a" };
+	DataType dt[] = { DT_INT };
+	int sizes[] = { 0 };
+	int keys[] = { 0 };
+	int stale[] = { 1, 3, 7 };
+
+	testName = "test warm restart of the buffer pool";
+
+	createTestFile("testbuffer.bin", 5);
+	discardWorkingSet("testbuffer.bin");
+
+	// pins never write the snapshot, shutdown does
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+	for(i = 0; i < 2000; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, 2 + 2 * (i % 2)));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_TRUE(!fileExists("testbuffer.bin.warm"), "no snapshot while pinning");
+	TEST_CHECK(shutdownBufferPool(bm));
+	ASSERT_TRUE(fileExists("testbuffer.bin.warm"), "shutdown writes the snapshot");
+
+	// the next pool prefetches the saved pages into free frames
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+	ASSERT_EQUALS_INT(0, getNumReadIO(bm), "nothing read before the first pin");
+	TEST_CHECK(pinPage(bm, h, 0));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_TRUE(isResident(bm, 2) && isResident(bm, 4), "working set reloaded");
+	ASSERT_EQUALS_INT(3, getNumReadIO(bm), "pinned page plus two prefetched");
+	TEST_CHECK(checkpointPool(bm));
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	// a snapshot naming pages past the end of the file loads only the others
+	file = fopen("testbuffer.bin.warm", "wb");
+	ASSERT_TRUE(file != NULL, "snapshot opened");
+	i = 3;
+	fwrite(&i, sizeof(int), 1, file);
+	fwrite(stale, sizeof(int), 3, file);
+	fclose(file);
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+	TEST_CHECK(pinPage(bm, h, 0));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_TRUE(isResident(bm, 1) && isResident(bm, 3) && !isResident(bm, 7), "only existing pages prefetched");
+	ASSERT_EQUALS_INT(3, getNumReadIO(bm), "pages past the end are not read");
+	ASSERT_ERROR(pinPage(bm, h, 7), "pinning past the end fails");
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	ASSERT_EQUALS_INT(5, fh.totalNumPages, "file did not grow");
+	TEST_CHECK(closePageFile(&fh));
+
+	TEST_CHECK(discardWorkingSet("testbuffer.bin"));
+	ASSERT_TRUE(!fileExists("testbuffer.bin.warm"), "snapshot discarded");
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	// deleting a table or an index also removes its snapshot
+	schema = createSchema(1, names, dt, sizes, 1, keys);
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTable("test_warm", schema));
+	TEST_CHECK(discardWorkingSet("test_warm.table"));
+	// writes checkpoint the table's pool every RM_CHECKPOINT_WRITES calls
+	TEST_CHECK(openTable(&table, "test_warm"));
+	TEST_CHECK(createRecord(&r, schema));
+	for(i = 0; i < RM_CHECKPOINT_WRITES - 1; i++)
+		TEST_CHECK(insertRecord(&table, r));
+	ASSERT_TRUE(!fileExists("test_warm.table.warm"), "no snapshot before the interval");
+	TEST_CHECK(insertRecord(&table, r));
+	ASSERT_TRUE(fileExists("test_warm.table.warm"), "periodic checkpoint writes the snapshot");
+	freeRecord(r);
+	TEST_CHECK(discardWorkingSet("test_warm.table"));
+	TEST_CHECK(closeTable(&table));
+	ASSERT_TRUE(fileExists("test_warm.table.warm"), "closing a table writes its snapshot");
+	TEST_CHECK(deleteTable("test_warm"));
+	ASSERT_TRUE(!fileExists("test_warm.table.warm"), "deleteTable discards the snapshot");
+	TEST_CHECK(shutdownRecordManager());
+	freeSchema(schema);
+
+	TEST_CHECK(initIndexManager(NULL));
+	TEST_CHECK(createBtree("test_warm_idx", DT_INT, 2));
+	TEST_CHECK(openBtree(&tree, "test_warm_idx"));
+	TEST_CHECK(closeBtree(tree));
+	ASSERT_TRUE(fileExists("test_warm_idx.warm"), "closing an index writes its snapshot");
+	TEST_CHECK(deleteBtree("test_warm_idx"));
+	ASSERT_TRUE(!fileExists("test_warm_idx.warm"), "deleteBtree discards the snapshot");
+	TEST_CHECK(shutdownIndexManager());
+
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testOptimisticReads (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	char buf[8];
+	int i;
+
+	testName = "test optimistic page reads";
+
+	createTestFile("testbuffer.bin", 6);
+
+	// a resident page is read without I/O; a missing one falls back to pinPage
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+	TEST_CHECK(pinPage(bm, h, 1));
+	TEST_CHECK(beginPageWrite(bm, h));
+	strcpy(h->data, "page1");
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(readPageOptimistic(bm, 1, 0, 6, buf));
+	ASSERT_EQUALS_STRING("page1", buf, "resident page read");
+	ASSERT_EQUALS_INT(1, getNumReadIO(bm), "no I/O for a resident page");
+	TEST_CHECK(readPageOptimistic(bm, 2, 0, 1, buf));
+	ASSERT_EQUALS_INT(2, getNumReadIO(bm), "missing page loaded by pinPage");
+	ASSERT_TRUE(isResident(bm, 2), "fallback leaves the page resident");
+	ASSERT_ERROR(readPageOptimistic(bm, 9, 0, 1, buf), "page past the end");
+	ASSERT_EQUALS_INT(0, getNumOptimisticRetries(bm), "no retries so far");
+
+	// while a write is open the version is odd: retry, then fall back
+	TEST_CHECK(pinPage(bm, h, 1));
+	TEST_CHECK(beginPageWrite(bm, h));
+	strcpy(h->data, "PAGE1");
+	TEST_CHECK(readPageOptimistic(bm, 1, 0, 6, buf));
+	ASSERT_EQUALS_STRING("PAGE1", buf, "fallback reads the page");
+	ASSERT_EQUALS_INT(8, getNumOptimisticRetries(bm), "every attempt saw the write");
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(readPageOptimistic(bm, 1, 0, 6, buf));
+	ASSERT_EQUALS_STRING("PAGE1", buf, "new version read");
+	ASSERT_EQUALS_INT(8, getNumOptimisticRetries(bm), "closed write validates");
+
+	// a frame reloaded with another page is not read as the old one
+	TEST_CHECK(pinPage(bm, h, 3));
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(pinPage(bm, h, 4));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_TRUE(!isResident(bm, 2), "page 2 evicted");
+	i = getNumReadIO(bm);
+	TEST_CHECK(readPageOptimistic(bm, 2, 0, 1, buf));
+	ASSERT_EQUALS_INT(i + 1, getNumReadIO(bm), "evicted page read from disk");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	// LRU: a page only read optimistically is not the oldest
+	TEST_CHECK(discardWorkingSet("testbuffer.bin"));
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+	for(i = 0; i < 3; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	TEST_CHECK(readPageOptimistic(bm, 0, 0, 1, buf));
+	TEST_CHECK(pinPage(bm, h, 3));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_TRUE(isResident(bm, 0) && !isResident(bm, 1), "LRU evicts the older page");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	// CLOCK: an optimistic read sets the reference bit
+	TEST_CHECK(discardWorkingSet("testbuffer.bin"));
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_CLOCK, NULL));
+	for(i = 0; i < 4; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_TRUE(!isResident(bm, 0), "first sweep evicts page 0");
+	TEST_CHECK(readPageOptimistic(bm, 1, 0, 1, buf));
+	TEST_CHECK(pinPage(bm, h, 4));
+	TEST_CHECK(unpinPage(bm, h));
+	ASSERT_TRUE(isResident(bm, 1) && !isResident(bm, 2), "CLOCK passes over the read page");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(discardWorkingSet("testbuffer.bin"));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	free(bm);
+	free(h);
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testReplacementModels (void)
+{
+	int sizes[] = { 3, 63, 64, 65, 130 };
+	ReplacementStrategy strategies[] = { RS_FIFO, RS_LRU, RS_CLOCK };
+	int s, i;
+
+	testName = "test replacement strategies against reference models";
+
+	createTestFile("testbuffer.bin", 2 * MODEL_MAX_FRAMES);
+	srand(525);
+	for(s = 0; s < 3; s++)
+		for(i = 0; i < 5; i++)
+			checkAgainstModel(sizes[i], strategies[s]);
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testFifoPinnedFrame (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PageHandle *pinned = MAKE_PAGE_HANDLE();
+	int i;
+
+	testName = "test FIFO eviction around a pinned frame";
+
+	createTestFile("testbuffer.bin", 12);
+	TEST_CHECK(discardWorkingSet("testbuffer.bin"));
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+
+	// page 0 stays pinned while the other two frames cycle through pages 1..8
+	TEST_CHECK(pinPage(bm, pinned, 0));
+	for(i = 1; i <= 8; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		TEST_CHECK(unpinPage(bm, h));
+		ASSERT_TRUE(isResident(bm, 0) && isResident(bm, i), "pinned page and newest page resident");
+		if (i > 2)
+			ASSERT_TRUE(isResident(bm, i - 1) && !isResident(bm, i - 2), "oldest unpinned page evicted");
+	}
+
+	// once unpinned, page 0 is still queued and gets evicted in turn
+	TEST_CHECK(unpinPage(bm, pinned));
+	for(i = 9; i <= 11; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_TRUE(!isResident(bm, 0), "page 0 evicted after unpinning");
+	ASSERT_TRUE(isResident(bm, 9) && isResident(bm, 10) && isResident(bm, 11), "last three pages resident");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(discardWorkingSet("testbuffer.bin"));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	free(bm);
+	free(h);
+	free(pinned);
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+createTestFile (char *name, int numPages)
+{
+	SM_FileHandle fh;
+
+	TEST_CHECK(createPageFile(name));
+	TEST_CHECK(openPageFile(name, &fh));
+	TEST_CHECK(ensureCapacity(numPages, &fh));
+	TEST_CHECK(closePageFile(&fh));
+}
+
+bool
+fileExists (char *name)
+{
+	FILE *file = fopen(name, "rb");
+	if (file == NULL)
+		return false;
+	fclose(file);
+	return true;
+}
+
+bool
+isResident (BM_BufferPool *bm, PageNumber pageNum)
+{
+	PageNumber *contents = getFrameContents(bm);
+	bool found = false;
+	int i;
+
+	for(i = 0; i < bm->numPages; i++)
+		if (contents[i] == pageNum)
+			found = true;
+	free(contents);
+	return found;
+}
+
+// Runs random pins and unpins on a pool and on a plain model of the same
+// strategy, comparing frame contents and fix counts after every step
+void
+checkAgainstModel (int numFrames, ReplacementStrategy strategy)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	PageNumber pages[MODEL_MAX_FRAMES], *contents;
+	int fixCounts[MODEL_MAX_FRAMES], lastUsed[MODEL_MAX_FRAMES], queue[MODEL_MAX_FRAMES];
+	bool refs[MODEL_MAX_FRAMES];
+	int *realFixCounts;
+	int clock = 0, hand = 0, queued = 0, pinned = 0, refused = 0, step, frame, i;
+	bool same;
+
+	TEST_CHECK(discardWorkingSet("testbuffer.bin"));
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", numFrames, strategy, NULL));
+	for(i = 0; i < numFrames; i++)
+	{
+		pages[i] = NO_PAGE;
+		fixCounts[i] = 0;
+		refs[i] = false;
+	}
+
+	for(step = 0; step < 4000; step++)
+	{
+		// mostly pins, with phases where nearly every frame stays pinned
+		bool pin = pinned == 0 || rand() % 100 < (step % 1000 < 500 ? 55 : 80);
+		if (pin)
+		{
+			PageNumber pageNum = rand() % (2 * numFrames);
+			for(frame = 0; frame < numFrames && pages[frame] != pageNum; frame++)
+				;
+			if (frame == numFrames)
+			{
+				for(frame = 0; frame < numFrames && pages[frame] != NO_PAGE; frame++)
+					;
+				if (frame < numFrames)
+					queue[queued++] = frame;
+				else
+				{
+					frame = modelVictim(strategy, numFrames, fixCounts, lastUsed, refs, queue, &hand);
+					if (frame >= 0 && strategy == RS_FIFO)
+						queue[numFrames - 1] = frame;
+				}
+			}
+			if (frame < 0)
+			{
+				if (pinPage(bm, h, pageNum) == RC_OK)
+					ASSERT_TRUE(false, "no victim while every frame is pinned");
+				refused++;
+				continue;
+			}
+			TEST_CHECK(pinPage(bm, h, pageNum));
+			pages[frame] = pageNum;
+			fixCounts[frame]++;
+			lastUsed[frame] = ++clock;
+			refs[frame] = true;
+			pinned++;
+		}
+		else
+		{
+			int k = rand() % pinned;
+			for(frame = 0; k >= fixCounts[frame]; frame++)
+				k -= fixCounts[frame];
+			h->pageNum = pages[frame];
+			TEST_CHECK(unpinPage(bm, h));
+			fixCounts[frame]--;
+			pinned--;
+		}
+
+		contents = getFrameContents(bm);
+		realFixCounts = getFixCounts(bm);
+		same = true;
+		for(i = 0; i < numFrames; i++)
+			if (contents[i] != pages[i] || realFixCounts[i] != fixCounts[i])
+				same = false;
+		free(contents);
+		free(realFixCounts);
+		if (!same)
+		{
+			printf("pool of %i frames, strategy %i, step %i\n", numFrames, strategy, step);
+			ASSERT_TRUE(same, "pool matches the model");
+		}
+	}
+	ASSERT_TRUE(refused > 0, "pool matched the model, including pins refused while all frames were pinned");
+
+	// unpin everything so the pool can shut down
+	for(frame = 0; frame < numFrames; frame++)
+		for(; fixCounts[frame] > 0; fixCounts[frame]--)
+		{
+			h->pageNum = pages[frame];
+			TEST_CHECK(unpinPage(bm, h));
+		}
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(discardWorkingSet("testbuffer.bin"));
+	free(bm);
+	free(h);
+}
+
+// Picks the frame each strategy evicts, or -1 if all are pinned. For FIFO,
+// queue holds the frames oldest first and the victim leaves it.
+int
+modelVictim (ReplacementStrategy strategy, int numFrames, int *fixCounts, int *lastUsed, bool *refs, int *queue, int *hand)
+{
+	int i, frame, victim = -1;
+
+	switch (strategy)
+	{
+	case RS_FIFO:
+		for(i = 0; i < numFrames && fixCounts[queue[0]] > 0; i++)
+		{
+			// a pinned frame goes to the back of the queue
+			frame = queue[0];
+			memmove(queue, queue + 1, (numFrames - 1) * sizeof(int));
+			queue[numFrames - 1] = frame;
+		}
+		if (i == numFrames)
+			return -1;
+		victim = queue[0];
+		memmove(queue, queue + 1, (numFrames - 1) * sizeof(int));
+		return victim;
+	case RS_LRU:
+		for(i = 0; i < numFrames; i++)
+			if (fixCounts[i] == 0 && (victim == -1 || lastUsed[i] < lastUsed[victim]))
+				victim = i;
+		return victim;
+	case RS_CLOCK:
+		for(i = 0; i < 2 * numFrames; i++)
+		{
+			frame = (*hand + i) % numFrames;
+			if (fixCounts[frame] > 0)
+				continue;
+			if (!refs[frame])
+			{
+				*hand = (frame + 1) % numFrames;
+				return frame;
+			}
+			refs[frame] = false;
+		}
+		return -1;
+	default:
+		return -1;
+	}
+}
@@ -1,7 +1,9 @@
 #include <stdlib.h>
+#include <string.h>
 #include "dberror.h"
 #include "expr.h"
 #include "record_mgr.h"
+#include "storage_mgr.h"
 #include "tables.h"
 #include "test_helper.h"
 
@@ -55,6 +57,22 @@ static void testScans (void);
 static void testScansTwo (void);
 static void testInsertManyRecords(void);
 static void testMultipleScans(void);
+static void testTableConfig(void);
+static void testTableRecovery(void);
+static void testFreeSpaceReuse(void);
+static void testInsertRecords(void);
+static void testDeleteUpdateWhere(void);
+static void testSlottedTable(void);
+static void testPaxTable(void);
+static void testZoneMaps(void);
+static void testParallelScan(void);
+static void testBatchScan(void);
+static void testRecordViews(void);
+static void testProjectedScans(void);
+static void testAlignedLayout(void);
+static void testTypedAttrs(void);
+static void testInvalidRids(void);
+static void testLongTableName(void);
 
 // struct for test records
 typedef struct TestRecord {
@@ -67,6 +85,13 @@ typedef struct TestRecord {
 Record *testRecord(Schema *schema, int a, char *b, int c);
 Schema *testSchema (void);
 Record *fromTestRecord (Schema *schema, TestRecord in);
+Expr *compareAttr (int attr, OpType op, char *value, bool constFirst);
+int countMatches (RM_TableData *table, Expr *cond);
+RC countByWorker (Record *record, int worker, void *data);
+RC stopAfterTen (Record *record, int worker, void *data);
+bool pageOnDisk (BM_BufferPool *bm, char *fileName, int pageNum);
+bool fileExists (char *name);
+void fillTable (RM_TableData *table, char *name, Schema *schema, RM_PageFormat format, RM_IndexKind index, int n, RID *rids);
 
 // test name
 char *testName;
@@ -84,6 +109,22 @@ main (void)
 	testScans();
 	testScansTwo();
 	testMultipleScans();
+	testTableConfig();
+	testTableRecovery();
+	testFreeSpaceReuse();
+	testInsertRecords();
+	testDeleteUpdateWhere();
+	testSlottedTable();
+	testPaxTable();
+	testZoneMaps();
+	testParallelScan();
+	testBatchScan();
+	testRecordViews();
+	testProjectedScans();
+	testAlignedLayout();
+	testTypedAttrs();
+	testInvalidRids();
+	testLongTableName();
 
 	return 0;
 }
@@ -616,6 +657,1412 @@ void testScansTwo (void)
 }
 
 
+void
+testTableConfig (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_Config defaults = { 16, RS_LRU, NULL, 0, RM_WRITE_BACK };
+	RM_Config perTable = { 8, RS_CLOCK, NULL, 4, RM_WRITE_THROUGH };
+	int numInserts = 2000, i, found = 0;
+	Record *r;
+	RID *rids;
+	Schema *schema;
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	BM_BufferPool *bm;
+	Record *changed;
+	int rc, reads;
+
+	testName = "test per-table buffer pool configuration";
+	schema = testSchema();
+	rids = (RID *) malloc(sizeof(RID) * numInserts);
+
+	TEST_CHECK(initRecordManager(&defaults));
+	TEST_CHECK(createTable("test_table_c",schema));
+	TEST_CHECK(openTableWithConfig(table, "test_table_c", &perTable));
+	bm = getTableBufferPool(table);
+	ASSERT_EQUALS_INT(8, bm->numPages, "per-table pool size");
+	ASSERT_EQUALS_INT(RS_CLOCK, bm->strategy, "per-table strategy");
+
+	for(i = 0; i < numInserts; i++)
+	{
+		r = testRecord(schema, i, "cccc", i % 7);
+		TEST_CHECK(insertRecord(table,r));
+		rids[i] = r->id;
+		freeRecord(r);
+	}
+
+	// write-through: the last insert is on disk before the table is closed
+	ASSERT_TRUE(pageOnDisk(bm, "test_table_c.table", rids[numInserts - 1].page), "write-through page on disk");
+	TEST_CHECK(closeTable(table));
+
+	// a scan reads ahead readAhead pages when it starts (on a cold pool)
+	TEST_CHECK(discardWorkingSet("test_table_c.table"));
+	TEST_CHECK(openTableWithConfig(table, "test_table_c", &perTable));
+	bm = getTableBufferPool(table);
+	createRecord(&r, schema);
+	reads = getNumReadIO(bm);
+	TEST_CHECK(startScan(table, sc, NULL));
+	ASSERT_EQUALS_INT(reads + 4, getNumReadIO(bm), "startScan prefetched four pages");
+	while((rc = next(sc, r)) == RC_OK)
+		found++;
+	if (rc != RC_RM_NO_MORE_TUPLES)
+		TEST_CHECK(rc);
+	TEST_CHECK(closeScan(sc));
+	ASSERT_EQUALS_INT(numInserts, found, "scan sees every record");
+	TEST_CHECK(closeTable(table));
+
+	// reopen with the record manager defaults
+	TEST_CHECK(discardWorkingSet("test_table_c.table"));
+	TEST_CHECK(openTable(table, "test_table_c"));
+	bm = getTableBufferPool(table);
+	ASSERT_EQUALS_INT(16, bm->numPages, "default pool size");
+	ASSERT_EQUALS_INT(RS_LRU, bm->strategy, "default strategy");
+	ASSERT_EQUALS_INT(numInserts, getNumTuples(table), "tuple count after reopen");
+	reads = getNumReadIO(bm);
+	TEST_CHECK(startScan(table, sc, NULL));
+	ASSERT_EQUALS_INT(reads, getNumReadIO(bm), "no read-ahead by default");
+	TEST_CHECK(closeScan(sc));
+
+	// write-back: an update stays in the pool until it is flushed
+	changed = testRecord(schema, 0, "dddd", 0);
+	changed->id = rids[0];
+	TEST_CHECK(updateRecord(table, changed));
+	ASSERT_TRUE(!pageOnDisk(bm, "test_table_c.table", rids[0].page), "write-back page only in the pool");
+	freeRecord(changed);
+	changed = testRecord(schema, 0, "cccc", 0);
+	changed->id = rids[0];
+	TEST_CHECK(updateRecord(table, changed));
+	freeRecord(changed);
+	for(i = 0; i < numInserts; i += 97)
+	{
+		Record *expected = testRecord(schema, i, "cccc", i % 7);
+		TEST_CHECK(getRecord(table, rids[i], r));
+		ASSERT_EQUALS_RECORDS(expected, r, schema, "compare records");
+		freeRecord(expected);
+	}
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_c"));
+	TEST_CHECK(shutdownRecordManager());
+
+	freeRecord(r);
+	free(rids);
+	free(table);
+	free(sc);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testTableRecovery (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	int numInserts = 500, i;
+	Record *r;
+	RID *rids;
+	Schema *schema;
+	SM_FileHandle fh;
+	char page[PAGE_SIZE];
+	int *info = (int *) page;
+
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	int rc, found = 0;
+
+	testName = "test table metadata recovery";
+	schema = testSchema();
+	rids = (RID *) malloc(sizeof(RID) * numInserts);
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTable("test_table_m",schema));
+	TEST_CHECK(openTable(table, "test_table_m"));
+	for(i = 0; i < numInserts; i++)
+	{
+		r = testRecord(schema, i, "mmmm", i % 3);
+		TEST_CHECK(insertRecord(table,r));
+		rids[i] = r->id;
+		freeRecord(r);
+	}
+	for(i = 0; i < numInserts; i += 5)
+		TEST_CHECK(deleteRecord(table,rids[i]));
+	TEST_CHECK(closeTable(table));
+
+	// pretend the table was never closed, counts must be rebuilt from the pages
+	TEST_CHECK(openPageFile("test_table_m.table", &fh));
+	TEST_CHECK(readBlock(0, &fh, page));
+	ASSERT_EQUALS_INT(1, info[5], "clean shutdown recorded");
+	info[2] = 0;
+	info[5] = 0;
+	TEST_CHECK(writeBlock(0, &fh, page));
+	TEST_CHECK(closePageFile(&fh));
+
+	TEST_CHECK(openTable(table, "test_table_m"));
+	ASSERT_EQUALS_INT(numInserts - numInserts / 5, getNumTuples(table), "tuple count after recovery");
+	createRecord(&r, schema);
+	TEST_CHECK(startScan(table, sc, NULL));
+	while((rc = next(sc, r)) == RC_OK)
+	{
+		ASSERT_TRUE(r->id.slot % 5 != 0 || r->id.page != rids[0].page, "deleted slots are skipped");
+		found++;
+	}
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ends cleanly");
+	TEST_CHECK(closeScan(sc));
+	ASSERT_EQUALS_INT(numInserts - numInserts / 5, found, "scan count after recovery");
+	freeRecord(r);
+	r = testRecord(schema, -1, "mmmm", 0);
+	TEST_CHECK(insertRecord(table,r));
+	ASSERT_EQUALS_INT(rids[0].page, r->id.page, "free slot found after recovery");
+	freeRecord(r);
+	TEST_CHECK(closeTable(table));
+
+	// a page file that is not a table is rejected
+	TEST_CHECK(openPageFile("test_table_m.table", &fh));
+	TEST_CHECK(readBlock(0, &fh, page));
+	info[0] = 0;
+	TEST_CHECK(writeBlock(0, &fh, page));
+	TEST_CHECK(closePageFile(&fh));
+	ASSERT_ERROR(openTable(table, "test_table_m"), "open table with a bad header");
+
+	TEST_CHECK(deleteTable("test_table_m"));
+	TEST_CHECK(shutdownRecordManager());
+
+	free(rids);
+	free(table);
+	free(sc);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testFreeSpaceReuse (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	int numInserts = 1000, numDeleted = 0, i;
+	Record *r;
+	RID *rids;
+	Schema *schema;
+	int freedPage;
+
+	testName = "test free space reuse";
+	schema = testSchema();
+	rids = (RID *) malloc(sizeof(RID) * numInserts);
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTable("test_table_f",schema));
+	TEST_CHECK(openTable(table, "test_table_f"));
+	for(i = 0; i < numInserts; i++)
+	{
+		r = testRecord(schema, i, "ffff", i % 3);
+		TEST_CHECK(insertRecord(table,r));
+		rids[i] = r->id;
+		freeRecord(r);
+	}
+
+	// empty one page in the middle of the table
+	freedPage = rids[numInserts / 2].page;
+	for(i = 0; i < numInserts; i++)
+		if (rids[i].page == freedPage)
+		{
+			TEST_CHECK(deleteRecord(table,rids[i]));
+			numDeleted++;
+		}
+
+	// new records fill the freed page before anything is appended
+	for(i = 0; i < numDeleted; i++)
+	{
+		r = testRecord(schema, numInserts + i, "ffff", 0);
+		TEST_CHECK(insertRecord(table,r));
+		ASSERT_EQUALS_INT(freedPage, r->id.page, "insert reuses freed page");
+		freeRecord(r);
+	}
+	r = testRecord(schema, -1, "ffff", 0);
+	TEST_CHECK(insertRecord(table,r));
+	ASSERT_TRUE(r->id.page >= rids[numInserts - 1].page, "insert goes to the end once the freed page is full");
+	freeRecord(r);
+	ASSERT_EQUALS_INT(numInserts + 1, getNumTuples(table), "tuple count");
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_f"));
+	TEST_CHECK(shutdownRecordManager());
+
+	free(rids);
+	free(table);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testInsertRecords (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	int numInserts = 3000, i;
+	Record **recs, *r;
+	RID *rids;
+	Schema *schema;
+
+	testName = "test batch insert";
+	schema = testSchema();
+	rids = (RID *) malloc(sizeof(RID) * numInserts);
+	recs = (Record **) malloc(sizeof(Record *) * numInserts);
+	for(i = 0; i < numInserts; i++)
+		recs[i] = testRecord(schema, i, "bbbb", i % 11);
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTable("test_table_b",schema));
+	TEST_CHECK(openTable(table, "test_table_b"));
+
+	// a small batch first, then punch holes for the big one to fill
+	TEST_CHECK(insertRecords(table, recs, 100, rids));
+	for(i = 0; i < 100; i += 2)
+		TEST_CHECK(deleteRecord(table, rids[i]));
+	TEST_CHECK(insertRecords(table, recs + 100, numInserts - 100, rids + 100));
+	ASSERT_EQUALS_INT(numInserts - 50, getNumTuples(table), "tuple count");
+	ASSERT_EQUALS_INT(rids[0].page, rids[100].page, "holes are filled first");
+	ASSERT_EQUALS_INT(rids[0].slot, rids[100].slot, "lowest hole first");
+
+	createRecord(&r, schema);
+	for(i = 100; i < numInserts; i += 37)
+	{
+		ASSERT_EQUALS_INT(rids[i].page, recs[i]->id.page, "record id set");
+		TEST_CHECK(getRecord(table, rids[i], r));
+		ASSERT_EQUALS_RECORDS(recs[i], r, schema, "compare records");
+	}
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(openTable(table, "test_table_b"));
+	ASSERT_EQUALS_INT(numInserts - 50, getNumTuples(table), "tuple count after reopen");
+	TEST_CHECK(getRecord(table, rids[numInserts - 1], r));
+	ASSERT_EQUALS_RECORDS(recs[numInserts - 1], r, schema, "last record after reopen");
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_b"));
+	TEST_CHECK(shutdownRecordManager());
+
+	for(i = 0; i < numInserts; i++)
+		freeRecord(recs[i]);
+	freeRecord(r);
+	free(recs);
+	free(rids);
+	free(table);
+	TEST_DONE();
+}
+
+static RC
+setB (Record *record, Schema *schema, void *data)
+{
+	Value *v = stringToValue((char *) data);
+	RC rc = setAttr(record, schema, 1, v);
+	freeVal(v);
+	return rc;
+}
+
+// ************************************************************ 
+void
+testDeleteUpdateWhere (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	int numInserts = 1500, i, found = 0, updated = 0;
+	Record *r;
+	Schema *schema;
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	Expr *sel, *left, *right;
+	Value *a, *b;
+	int rc;
+
+	testName = "test deleteWhere and updateWhere";
+	schema = testSchema();
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTable("test_table_w",schema));
+	TEST_CHECK(openTable(table, "test_table_w"));
+	for(i = 0; i < numInserts; i++)
+	{
+		r = testRecord(schema, i, "wwww", i % 3);
+		TEST_CHECK(insertRecord(table,r));
+		freeRecord(r);
+	}
+
+	// delete every row with c = 0
+	MAKE_CONS(left, stringToValue("i0"));
+	MAKE_ATTRREF(right, 2);
+	MAKE_BINOP_EXPR(sel, left, right, OP_COMP_EQUAL);
+	TEST_CHECK(deleteWhere(table, sel));
+	freeExpr(sel);
+	ASSERT_EQUALS_INT(numInserts - numInserts / 3, getNumTuples(table), "tuple count after deleteWhere");
+
+	// set b for every row with a < 300
+	MAKE_CONS(right, stringToValue("i300"));
+	MAKE_ATTRREF(left, 0);
+	MAKE_BINOP_EXPR(sel, left, right, OP_COMP_SMALLER);
+	TEST_CHECK(updateWhere(table, sel, setB, "suuuu"));
+	freeExpr(sel);
+
+	createRecord(&r, schema);
+	TEST_CHECK(startScan(table, sc, NULL));
+	while((rc = next(sc, r)) == RC_OK)
+	{
+		getAttr(r, schema, 0, &a);
+		getAttr(r, schema, 1, &b);
+		ASSERT_TRUE(a->v.intV % 3 != 0, "deleted rows are gone");
+		ASSERT_EQUALS_STRING(a->v.intV < 300 ? "uuuu" : "wwww", b->v.stringV, "updated rows changed");
+		if (a->v.intV < 300) updated++;
+		found++;
+		freeVal(a);
+		freeVal(b);
+	}
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ends cleanly");
+	TEST_CHECK(closeScan(sc));
+	ASSERT_EQUALS_INT(numInserts - numInserts / 3, found, "scan count");
+	ASSERT_EQUALS_INT(200, updated, "updated count");
+
+	// freed slots are reused
+	TEST_CHECK(insertRecord(table, r));
+	ASSERT_EQUALS_INT(0, r->id.slot, "first freed slot reused");
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_w"));
+	TEST_CHECK(shutdownRecordManager());
+
+	freeRecord(r);
+	free(table);
+	free(sc);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testSlottedTable (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	int numInserts = 500, i, found = 0;
+	Record *r;
+	Schema *schema;
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	RID *rids = (RID *) malloc(sizeof(RID) * numInserts);
+	SM_FileHandle fh;
+	Expr *sel, *left, *right;
+	Value *v;
+	char longB[151], setValue[152];
+	int rc;
+	char *names[] = { "a", "b", "c" };
+	DataType dt[] = { DT_INT, DT_STRING, DT_INT };
+	int sizes[] = { 0, 150, 0 };
+	int keys[] = {0};
+	char **cpNames = (char **) malloc(sizeof(char*) * 3);
+	DataType *cpDt = (DataType *) malloc(sizeof(DataType) * 3);
+	int *cpSizes = (int *) malloc(sizeof(int) * 3);
+	int *cpKeys = (int *) malloc(sizeof(int));
+
+	testName = "test slotted pages with variable-length records";
+	for(i = 0; i < 3; i++)
+	{
+		cpNames[i] = (char *) malloc(2);
+		strcpy(cpNames[i], names[i]);
+	}
+	memcpy(cpDt, dt, sizeof(DataType) * 3);
+	memcpy(cpSizes, sizes, sizeof(int) * 3);
+	memcpy(cpKeys, keys, sizeof(int));
+	schema = createSchema(3, cpNames, cpDt, cpSizes, 1, cpKeys);
+	memset(longB, 'x', 150);
+	longB[150] = '\0';
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTableWithFormat("test_table_s", schema, RM_PAGE_SLOTTED));
+	TEST_CHECK(openTable(table, "test_table_s"));
+	for(i = 0; i < numInserts; i++)
+	{
+		r = testRecord(schema, i, "ss", i % 2);
+		TEST_CHECK(insertRecord(table,r));
+		rids[i] = r->id;
+		freeRecord(r);
+	}
+	TEST_CHECK(closeTable(table));
+
+	// short strings are stored at their length, not the declared 150 bytes
+	TEST_CHECK(openPageFile("test_table_s.table", &fh));
+	ASSERT_TRUE(fh.totalNumPages < 6, "slotted table is compact");
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(openTable(table, "test_table_s"));
+
+	// growing rows overflow their page and are forwarded, keeping their RID
+	for(i = 0; i < numInserts; i += 5)
+	{
+		r = testRecord(schema, i, longB, i % 2);
+		r->id = rids[i];
+		TEST_CHECK(updateRecord(table,r));
+		freeRecord(r);
+	}
+	createRecord(&r, schema);
+	for(i = 0; i < numInserts; i++)
+	{
+		TEST_CHECK(getRecord(table, rids[i], r));
+		getAttr(r, schema, 1, &v);
+		ASSERT_EQUALS_STRING(i % 5 == 0 ? longB : "ss", v->v.stringV, "forwarded rows readable");
+		freeVal(v);
+	}
+	freeRecord(r);
+
+	// shrinking half of them again moves them back home
+	for(i = 0; i < numInserts; i += 10)
+	{
+		r = testRecord(schema, i, "s", i % 2);
+		r->id = rids[i];
+		TEST_CHECK(updateRecord(table,r));
+		freeRecord(r);
+	}
+	for(i = 1; i < numInserts; i += 10)
+		TEST_CHECK(deleteRecord(table, rids[i]));
+	ASSERT_EQUALS_INT(numInserts - numInserts / 10, getNumTuples(table), "tuple count after deletes");
+
+	// updateWhere grows every row with c = 0: rows that still fit are
+	// rewritten in place, the others move and leave a forward behind
+	MAKE_CONS(left, stringToValue("i0"));
+	MAKE_ATTRREF(right, 2);
+	MAKE_BINOP_EXPR(sel, left, right, OP_COMP_EQUAL);
+	sprintf(setValue, "s%s", longB);
+	TEST_CHECK(updateWhere(table, sel, setB, setValue));
+	ASSERT_EQUALS_INT(numInserts - numInserts / 10, getNumTuples(table), "tuple count after updateWhere");
+	createRecord(&r, schema);
+	for(i = 0; i < numInserts; i++)
+	{
+		if (i % 10 == 1)
+			continue;
+		TEST_CHECK(getRecord(table, rids[i], r));
+		getAttr(r, schema, 1, &v);
+		ASSERT_EQUALS_STRING(i % 2 == 0 || i % 5 == 0 ? longB : "ss", v->v.stringV, "row after updateWhere");
+		freeVal(v);
+	}
+	freeRecord(r);
+
+	// then deletes them, forwarded or not
+	TEST_CHECK(deleteWhere(table, sel));
+	freeExpr(sel);
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(openTable(table, "test_table_s"));
+
+	// every surviving row is seen once, under its home RID
+	createRecord(&r, schema);
+	TEST_CHECK(startScan(table, sc, NULL));
+	while((rc = next(sc, r)) == RC_OK)
+	{
+		getAttr(r, schema, 0, &v);
+		i = v->v.intV;
+		freeVal(v);
+		ASSERT_TRUE(i % 2 == 1 && i % 10 != 1, "only surviving rows returned");
+		ASSERT_TRUE(r->id.page == rids[i].page && r->id.slot == rids[i].slot, "home RID returned");
+		getAttr(r, schema, 1, &v);
+		ASSERT_EQUALS_STRING(i % 5 == 0 ? longB : "ss", v->v.stringV, "row content after reopen");
+		freeVal(v);
+		found++;
+	}
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ends cleanly");
+	TEST_CHECK(closeScan(sc));
+	ASSERT_EQUALS_INT(numInserts / 2 - numInserts / 10, found, "scan count");
+	ASSERT_EQUALS_INT(found, getNumTuples(table), "tuple count after reopen");
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_s"));
+	TEST_CHECK(shutdownRecordManager());
+
+	freeRecord(r);
+	freeSchema(schema);
+	free(rids);
+	free(table);
+	free(sc);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testPaxTable (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	int numInserts = 2000, i, found = 0;
+	Record *r, *expected;
+	Schema *schema;
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	RID *rids = (RID *) malloc(sizeof(RID) * numInserts);
+	Expr *sel, *left, *right;
+	Value *a, *b, *c;
+	int rc;
+
+	testName = "test PAX page layout";
+	schema = testSchema();
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTableWithFormat("test_table_p", schema, RM_PAGE_PAX));
+	TEST_CHECK(openTable(table, "test_table_p"));
+	for(i = 0; i < numInserts; i++)
+	{
+		r = testRecord(schema, i, "pppp", i % 4);
+		TEST_CHECK(insertRecord(table,r));
+		rids[i] = r->id;
+		freeRecord(r);
+	}
+
+	// rows come back in row format
+	createRecord(&r, schema);
+	TEST_CHECK(getRecord(table, rids[1234], r));
+	expected = testRecord(schema, 1234, "pppp", 2);
+	ASSERT_EQUALS_RECORDS(expected, r, schema, "record read back from columns");
+	freeRecord(expected);
+	freeRecord(r);
+
+	for(i = 0; i < numInserts; i += 2)
+	{
+		r = testRecord(schema, i, "qqqq", i % 4);
+		r->id = rids[i];
+		TEST_CHECK(updateRecord(table,r));
+		freeRecord(r);
+	}
+	for(i = 0; i < numInserts; i += 4)
+		TEST_CHECK(deleteRecord(table, rids[i]));
+
+	// set b for every row with c = 1
+	MAKE_CONS(left, stringToValue("i1"));
+	MAKE_ATTRREF(right, 2);
+	MAKE_BINOP_EXPR(sel, left, right, OP_COMP_EQUAL);
+	TEST_CHECK(updateWhere(table, sel, setB, "srrrr"));
+	freeExpr(sel);
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(openTable(table, "test_table_p"));
+
+	// the scan condition reads only column c
+	MAKE_CONS(right, stringToValue("i3"));
+	MAKE_ATTRREF(left, 2);
+	MAKE_BINOP_EXPR(sel, left, right, OP_COMP_SMALLER);
+	createRecord(&r, schema);
+	TEST_CHECK(startScan(table, sc, sel));
+	while((rc = next(sc, r)) == RC_OK)
+	{
+		getAttr(r, schema, 0, &a);
+		getAttr(r, schema, 1, &b);
+		getAttr(r, schema, 2, &c);
+		ASSERT_EQUALS_INT(a->v.intV % 4, c->v.intV, "columns of one row stay together");
+		ASSERT_TRUE(r->id.page == rids[a->v.intV].page && r->id.slot == rids[a->v.intV].slot, "RID returned");
+		ASSERT_EQUALS_STRING(c->v.intV == 1 ? "rrrr" : "qqqq", b->v.stringV, "updated values");
+		ASSERT_TRUE(c->v.intV != 0, "deleted rows are gone");
+		freeVal(a);
+		freeVal(b);
+		freeVal(c);
+		found++;
+	}
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ends cleanly");
+	TEST_CHECK(closeScan(sc));
+	freeExpr(sel);
+	ASSERT_EQUALS_INT(numInserts / 2, found, "scan count");
+
+	// delete all rows with c = 2
+	MAKE_CONS(left, stringToValue("i2"));
+	MAKE_ATTRREF(right, 2);
+	MAKE_BINOP_EXPR(sel, left, right, OP_COMP_EQUAL);
+	TEST_CHECK(deleteWhere(table, sel));
+	freeExpr(sel);
+	ASSERT_EQUALS_INT(numInserts / 2, getNumTuples(table), "tuple count after deleteWhere");
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_p"));
+	TEST_CHECK(shutdownRecordManager());
+
+	freeRecord(r);
+	freeSchema(schema);
+	free(rids);
+	free(table);
+	free(sc);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testZoneMaps (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_PageFormat formats[] = { RM_PAGE_FIXED, RM_PAGE_SLOTTED, RM_PAGE_PAX };
+	int numInserts = 3000, numConds = 8, i, j, k;
+	int expected[] = { 100, 100, 9, 100, 100, 1, 50, 2 };
+	Expr *conds[8], *left, *right;
+	Schema *schema;
+	Record *r;
+	Value *v;
+	RID first;
+	char name[16];
+	char *names[] = { "k", "a", "b", "f" };
+	DataType dt[] = { DT_INT, DT_INT, DT_STRING, DT_FLOAT };
+	int sizes[] = { 0, 0, 12, 0 };
+	int keys[] = { 0 };
+	char **cpNames = (char **) malloc(sizeof(char*) * 4);
+	DataType *cpDt = (DataType *) malloc(sizeof(DataType) * 4);
+	int *cpSizes = (int *) malloc(sizeof(int) * 4);
+	int *cpKeys = (int *) malloc(sizeof(int));
+
+	testName = "test zone map page pruning";
+	for(i = 0; i < 4; i++)
+	{
+		cpNames[i] = (char *) malloc(2);
+		strcpy(cpNames[i], names[i]);
+	}
+	memcpy(cpDt, dt, sizeof(DataType) * 4);
+	memcpy(cpSizes, sizes, sizeof(int) * 4);
+	memcpy(cpKeys, keys, sizeof(int));
+	schema = createSchema(4, cpNames, cpDt, cpSizes, 1, cpKeys);
+
+	// a < 100
+	conds[0] = compareAttr(1, OP_COMP_SMALLER, "i100", false);
+	// not a < 2900
+	MAKE_UNOP_EXPR(conds[1], compareAttr(1, OP_COMP_SMALLER, "i2900", false), OP_BOOL_NOT);
+	// 1500 < a and a < 1510
+	MAKE_BINOP_EXPR(conds[2], compareAttr(1, OP_COMP_SMALLER, "i1500", true), compareAttr(1, OP_COMP_SMALLER, "i1510", false), OP_BOOL_AND);
+	// strings that differ only past the summarized prefix
+	conds[3] = compareAttr(2, OP_COMP_SMALLER, "sprefix__0100", false);
+	conds[4] = compareAttr(2, OP_COMP_SMALLER, "sprefix__2899", true);
+	conds[5] = compareAttr(2, OP_COMP_EQUAL, "sprefix__1234", false);
+	// f < 5.0
+	conds[6] = compareAttr(3, OP_COMP_SMALLER, "f5.0", false);
+	// a = 5 or a = 2995
+	MAKE_BINOP_EXPR(conds[7], compareAttr(1, OP_COMP_EQUAL, "i5", false), compareAttr(1, OP_COMP_EQUAL, "i2995", true), OP_BOOL_OR);
+
+	TEST_CHECK(initRecordManager(NULL));
+	for(k = 0; k < 3; k++)
+	{
+		TEST_CHECK(createTableWithFormat("test_table_z", schema, formats[k]));
+		TEST_CHECK(openTable(table, "test_table_z"));
+		TEST_CHECK(createRecord(&r, schema));
+		for(i = 0; i < numInserts; i++)
+		{
+			MAKE_VALUE(v, DT_INT, i);
+			TEST_CHECK(setAttr(r, schema, 0, v));
+			TEST_CHECK(setAttr(r, schema, 1, v));
+			freeVal(v);
+			sprintf(name, "sprefix__%04d", i);
+			v = stringToValue(name);
+			TEST_CHECK(setAttr(r, schema, 2, v));
+			freeVal(v);
+			v = stringToValue("f0");
+			v->v.floatV = i / 10.0f;
+			TEST_CHECK(setAttr(r, schema, 3, v));
+			freeVal(v);
+			TEST_CHECK(insertRecord(table, r));
+			if (i == 0)
+				first = r->id;
+		}
+
+		for(j = 0; j < numConds; j++)
+			ASSERT_EQUALS_INT(expected[j], countMatches(table, conds[j]), "rows matched");
+
+		// an update widens the zone of its page
+		TEST_CHECK(getRecord(table, first, r));
+		MAKE_VALUE(v, DT_INT, 5000);
+		TEST_CHECK(setAttr(r, schema, 1, v));
+		freeVal(v);
+		TEST_CHECK(updateRecord(table, r));
+		MAKE_UNOP_EXPR(left, compareAttr(1, OP_COMP_SMALLER, "i4000", false), OP_BOOL_NOT);
+		ASSERT_EQUALS_INT(1, countMatches(table, left), "updated row found");
+		ASSERT_EQUALS_INT(expected[0] - 1, countMatches(table, conds[0]), "old value gone");
+
+		// zones survive a reopen
+		TEST_CHECK(closeTable(table));
+		TEST_CHECK(openTable(table, "test_table_z"));
+		ASSERT_EQUALS_INT(1, countMatches(table, left), "updated row found after reopen");
+		right = compareAttr(1, OP_COMP_SMALLER, "i4000", false);
+		TEST_CHECK(deleteWhere(table, right));
+		ASSERT_EQUALS_INT(1, getNumTuples(table), "deleteWhere skips no page it needs");
+		freeExpr(left);
+		freeExpr(right);
+
+		freeRecord(r);
+		TEST_CHECK(closeTable(table));
+		TEST_CHECK(deleteTable("test_table_z"));
+	}
+	TEST_CHECK(shutdownRecordManager());
+
+	for(j = 0; j < numConds; j++)
+		freeExpr(conds[j]);
+	freeSchema(schema);
+	free(table);
+	TEST_DONE();
+}
+
+#define PARALLEL_WORKERS 4
+
+// per-worker results of a parallel scan
+typedef struct WorkerCounts {
+	Schema *schema;
+	int rows[PARALLEL_WORKERS];
+	long keySum[PARALLEL_WORKERS];
+	int stopped;
+} WorkerCounts;
+
+void
+testParallelScan (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_PageFormat formats[] = { RM_PAGE_FIXED, RM_PAGE_SLOTTED, RM_PAGE_PAX };
+	int numInserts = 5000, i, k, rows;
+	long keySum;
+	RID *rids = (RID *) malloc(sizeof(RID) * numInserts);
+	WorkerCounts counts;
+	Schema *schema;
+	Expr *cond;
+
+	testName = "test parallel scan";
+	schema = testSchema();
+	// c = 3, on a column the zone maps cannot prune
+	cond = compareAttr(2, OP_COMP_EQUAL, "i3", false);
+
+	TEST_CHECK(initRecordManager(NULL));
+	for(k = 0; k < 3; k++)
+	{
+		fillTable(table, "test_table_p", schema, formats[k], RM_INDEX_NONE, numInserts, rids);
+
+		memset(&counts, 0, sizeof(counts));
+		counts.schema = schema;
+		TEST_CHECK(parallelScan(table, cond, PARALLEL_WORKERS, countByWorker, &counts));
+		rows = 0;
+		keySum = 0;
+		for(i = 0; i < PARALLEL_WORKERS; i++)
+		{
+			rows += counts.rows[i];
+			keySum += counts.keySum[i];
+		}
+		ASSERT_EQUALS_INT(countMatches(table, cond), rows, "parallel scan finds the rows next finds");
+		ASSERT_EQUALS_INT(numInserts / 7, rows, "rows with c = 3");
+		// every matching key once: 3 + 10 + ... over a = 7j + 3
+		ASSERT_EQUALS_INT((int) ((long) rows * (rows - 1) / 2 * 7 + 3L * rows), (int) keySum, "each row seen once");
+
+		memset(&counts, 0, sizeof(counts));
+		counts.schema = schema;
+		TEST_CHECK(parallelScan(table, NULL, PARALLEL_WORKERS, countByWorker, &counts));
+		rows = 0;
+		for(i = 0; i < PARALLEL_WORKERS; i++)
+			rows += counts.rows[i];
+		ASSERT_EQUALS_INT(numInserts, rows, "scan without condition sees every row");
+
+		// a failing callback stops every worker and is reported
+		memset(&counts, 0, sizeof(counts));
+		counts.schema = schema;
+		ASSERT_EQUALS_INT(RC_WRITE_FAILED, parallelScan(table, NULL, PARALLEL_WORKERS, stopAfterTen, &counts), "callback error returned");
+		ASSERT_TRUE(counts.stopped > 0, "callback saw the stop");
+
+		TEST_CHECK(closeTable(table));
+		TEST_CHECK(deleteTable("test_table_p"));
+	}
+	TEST_CHECK(shutdownRecordManager());
+
+	freeExpr(cond);
+	freeSchema(schema);
+	free(rids);
+	free(table);
+	TEST_DONE();
+}
+
+void
+testBatchScan (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_PageFormat formats[] = { RM_PAGE_FIXED, RM_PAGE_SLOTTED, RM_PAGE_PAX };
+	int numInserts = 3000, numConds = 3, i, j, k, rows, rc;
+	RID *rids = (RID *) malloc(sizeof(RID) * numInserts);
+	RM_ScanHandle sc, sc2;
+	RecordBatch *batch;
+	Record *r, batchRecord;
+	BM_PageHandle pinned[8];
+	BM_BufferPool *bm;
+	Schema *schema;
+	Expr *conds[3];
+	int recordSize;
+
+	testName = "test batched scans";
+	schema = testSchema();
+	recordSize = getRecordSize(schema);
+	// every row, c = 3, and a < 1000, which the key index answers
+	conds[0] = NULL;
+	conds[1] = compareAttr(2, OP_COMP_EQUAL, "i3", false);
+	conds[2] = compareAttr(0, OP_COMP_SMALLER, "i1000", false);
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createRecordBatch(&batch, schema, 64));
+	for(k = 0; k < 3; k++)
+	{
+		fillTable(table, "test_table_b", schema, formats[k], RM_INDEX_BTREE, numInserts, rids);
+		TEST_CHECK(deleteRecord(table, rids[10]));
+
+		// batches (capped below capacity) return what next returns, in order
+		TEST_CHECK(createRecord(&r, schema));
+		for(j = 0; j < numConds; j++)
+		{
+			rows = 0;
+			TEST_CHECK(startScan(table, &sc, conds[j]));
+			TEST_CHECK(startScan(table, &sc2, conds[j]));
+			while((rc = nextBatch(&sc, batch, 50)) == RC_OK)
+			{
+				ASSERT_TRUE(batch->numRecords > 0 && batch->numRecords <= 50, "batch size");
+				for(i = 0; i < batch->numRecords; i++)
+				{
+					TEST_CHECK(next(&sc2, r));
+					batchRecord.id = batch->ids[i];
+					batchRecord.data = batch->data + i * recordSize;
+					ASSERT_TRUE(r->id.page == batchRecord.id.page && r->id.slot == batchRecord.id.slot, "same RID");
+					ASSERT_TRUE(memcmp(r->data, batchRecord.data, recordSize) == 0, "same row");
+				}
+				rows += batch->numRecords;
+			}
+			ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "batched scan ends");
+			ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, next(&sc2, r), "row scan ends too");
+			ASSERT_EQUALS_INT(countMatches(table, conds[j]), rows, "rows in batches");
+			TEST_CHECK(closeScan(&sc));
+			TEST_CHECK(closeScan(&sc2));
+		}
+
+		// next and nextBatch can be mixed on one scan
+		rows = 0;
+		TEST_CHECK(startScan(table, &sc, NULL));
+		while(next(&sc, r) == RC_OK && ++rows && nextBatch(&sc, batch, 7) == RC_OK)
+			rows += batch->numRecords;
+		TEST_CHECK(closeScan(&sc));
+		ASSERT_EQUALS_INT(numInserts - 1, rows, "mixed scan sees every row once");
+
+		// a page that cannot be pinned is an error, not the end of the scan
+		bm = getTableBufferPool(table);
+		for(i = 0; i < bm->numPages; i++)
+			TEST_CHECK(pinPage(bm, &pinned[i], rids[numInserts - 1].page - i));
+		TEST_CHECK(startScan(table, &sc, NULL));
+		ASSERT_EQUALS_INT(RC_WRITE_FAILED, nextBatch(&sc, batch, 50), "batch reports the pin failure");
+		ASSERT_EQUALS_INT(RC_WRITE_FAILED, next(&sc, r), "next reports the pin failure");
+		for(i = 0; i < bm->numPages; i++)
+			TEST_CHECK(unpinPage(bm, &pinned[i]));
+		rows = 0;
+		while(nextBatch(&sc, batch, 50) == RC_OK)
+			rows += batch->numRecords;
+		TEST_CHECK(closeScan(&sc));
+		ASSERT_EQUALS_INT(numInserts - 1, rows, "scan resumes after the failure");
+		freeRecord(r);
+
+		TEST_CHECK(closeTable(table));
+		TEST_CHECK(deleteTable("test_table_b"));
+	}
+	TEST_CHECK(freeRecordBatch(batch));
+	TEST_CHECK(shutdownRecordManager());
+
+	for(j = 1; j < numConds; j++)
+		freeExpr(conds[j]);
+	freeSchema(schema);
+	free(rids);
+	free(table);
+	TEST_DONE();
+}
+
+void
+testRecordViews (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_PageFormat formats[] = { RM_PAGE_FIXED, RM_PAGE_SLOTTED, RM_PAGE_PAX };
+	int numInserts = 2000, i, k, rows, rc;
+	RID *rids = (RID *) malloc(sizeof(RID) * numInserts);
+	RM_ScanHandle sc, sc2;
+	RM_RecordView view, views[2];
+	RID missing;
+	Record *r;
+	Schema *schema;
+	Expr *cond;
+	int recordSize;
+
+	testName = "test zero-copy record views";
+	schema = testSchema();
+	recordSize = getRecordSize(schema);
+	cond = compareAttr(2, OP_COMP_EQUAL, "i3", false);
+
+	TEST_CHECK(initRecordManager(NULL));
+	for(k = 0; k < 3; k++)
+	{
+		fillTable(table, "test_table_v", schema, formats[k], RM_INDEX_NONE, numInserts, rids);
+		TEST_CHECK(deleteRecord(table, rids[7]));
+
+		TEST_CHECK(createRecord(&r, schema));
+		for(i = 0; i < numInserts; i += 37)
+		{
+			if (i == 7)
+				continue;
+			TEST_CHECK(getRecordView(table, rids[i], &view));
+			TEST_CHECK(getRecord(table, rids[i], r));
+			ASSERT_TRUE(view.record.id.page == rids[i].page && view.record.id.slot == rids[i].slot, "view RID");
+			ASSERT_TRUE(memcmp(view.record.data, r->data, recordSize) == 0, "view matches getRecord");
+			TEST_CHECK(releaseRecordView(&view));
+		}
+		ASSERT_EQUALS_INT(RC_FILE_NOT_FOUND, getRecordView(table, rids[7], &view), "deleted record has no view");
+		missing.page = rids[numInserts - 1].page + 100;
+		missing.slot = 0;
+		ASSERT_EQUALS_INT(RC_FILE_NOT_FOUND, getRecordView(table, missing, &view), "no view past the last page");
+
+		// two views held at once, each released on its own
+		TEST_CHECK(getRecordView(table, rids[0], &views[0]));
+		TEST_CHECK(getRecordView(table, rids[numInserts - 1], &views[1]));
+		ASSERT_TRUE(*(int *) views[1].record.data == numInserts - 1, "second view");
+		ASSERT_TRUE(*(int *) views[0].record.data == 0, "first view still valid");
+		TEST_CHECK(releaseRecordView(&views[1]));
+		TEST_CHECK(releaseRecordView(&views[0]));
+
+		// nextView returns what next returns
+		rows = 0;
+		TEST_CHECK(startScan(table, &sc, cond));
+		TEST_CHECK(startScan(table, &sc2, cond));
+		while((rc = nextView(&sc, &view)) == RC_OK)
+		{
+			TEST_CHECK(next(&sc2, r));
+			ASSERT_TRUE(view.record.id.page == r->id.page && view.record.id.slot == r->id.slot, "same RID");
+			ASSERT_TRUE(memcmp(view.record.data, r->data, recordSize) == 0, "same row");
+			TEST_CHECK(releaseRecordView(&view));
+			rows++;
+		}
+		ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "view scan ends");
+		ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, next(&sc2, r), "row scan ends too");
+		ASSERT_EQUALS_INT(countMatches(table, cond), rows, "rows with c = 3");
+		TEST_CHECK(closeScan(&sc));
+		TEST_CHECK(closeScan(&sc2));
+		freeRecord(r);
+
+		TEST_CHECK(closeTable(table));
+		TEST_CHECK(deleteTable("test_table_v"));
+	}
+	TEST_CHECK(shutdownRecordManager());
+
+	freeExpr(cond);
+	freeSchema(schema);
+	free(rids);
+	free(table);
+	TEST_DONE();
+}
+
+void
+testProjectedScans (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_PageFormat formats[] = { RM_PAGE_FIXED, RM_PAGE_SLOTTED, RM_PAGE_PAX };
+	int numInserts = 2000, numConds = 3, i, j, k, rows, rc;
+	int attrs[] = { 2, 0 };
+	RID *rids = (RID *) malloc(sizeof(RID) * numInserts);
+	RM_ScanHandle sc, sc2;
+	RecordBatch *batch;
+	Record *r, *full, projected;
+	Schema *schema, *projSchema;
+	Expr *conds[3];
+	Value *v, *w;
+
+	testName = "test scans with projection";
+	schema = testSchema();
+	// every row, c = 3 on the heap, and a < 500 through the key index
+	conds[0] = NULL;
+	conds[1] = compareAttr(2, OP_COMP_EQUAL, "i3", false);
+	conds[2] = compareAttr(0, OP_COMP_SMALLER, "i500", false);
+
+	TEST_CHECK(initRecordManager(NULL));
+	for(k = 0; k < 3; k++)
+	{
+		fillTable(table, "test_table_j", schema, formats[k], RM_INDEX_BTREE, numInserts, rids);
+
+		TEST_CHECK(createRecord(&full, schema));
+		for(j = 0; j < numConds; j++)
+		{
+			rows = 0;
+			TEST_CHECK(startScanWithProjection(table, &sc, conds[j], attrs, 2));
+			TEST_CHECK(startScan(table, &sc2, conds[j]));
+			projSchema = getScanSchema(&sc);
+			ASSERT_EQUALS_INT(2, projSchema->numAttr, "projected attributes");
+			ASSERT_EQUALS_STRING("c", projSchema->attrNames[0], "first projected attribute");
+			ASSERT_EQUALS_INT(1, projSchema->keySize, "key kept");
+			ASSERT_EQUALS_INT(1, projSchema->keyAttrs[0], "key renumbered");
+			ASSERT_EQUALS_INT((int) (2 * sizeof(int)), getRecordSize(projSchema), "projected record size");
+			TEST_CHECK(createRecord(&r, projSchema));
+			while((rc = next(&sc, r)) == RC_OK)
+			{
+				TEST_CHECK(next(&sc2, full));
+				ASSERT_TRUE(r->id.page == full->id.page && r->id.slot == full->id.slot, "same RID");
+				getAttr(r, projSchema, 0, &v);
+				getAttr(full, schema, 2, &w);
+				ASSERT_TRUE(v->v.intV == w->v.intV, "projected c");
+				freeVal(v);
+				freeVal(w);
+				getAttr(r, projSchema, 1, &v);
+				getAttr(full, schema, 0, &w);
+				ASSERT_TRUE(v->v.intV == w->v.intV, "projected a");
+				freeVal(v);
+				freeVal(w);
+				rows++;
+			}
+			ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "projected scan ends");
+			ASSERT_EQUALS_INT(countMatches(table, conds[j]), rows, "projected rows");
+			freeRecord(r);
+			TEST_CHECK(closeScan(&sc));
+			TEST_CHECK(closeScan(&sc2));
+
+			// batches hold projected records too
+			rows = 0;
+			TEST_CHECK(startScanWithProjection(table, &sc, conds[j], attrs, 2));
+			TEST_CHECK(createRecordBatch(&batch, getScanSchema(&sc), 100));
+			while(nextBatch(&sc, batch, 100) == RC_OK)
+				for(i = 0; i < batch->numRecords; i++)
+				{
+					projected.data = batch->data + i * 2 * sizeof(int);
+					getAttr(&projected, getScanSchema(&sc), 1, &v);
+					ASSERT_TRUE(v->v.intV % 7 == *(int *) projected.data, "batched projection");
+					freeVal(v);
+					rows++;
+				}
+			ASSERT_EQUALS_INT(countMatches(table, conds[j]), rows, "projected rows in batches");
+			TEST_CHECK(freeRecordBatch(batch));
+			TEST_CHECK(closeScan(&sc));
+		}
+		freeRecord(full);
+		ASSERT_EQUALS_INT(RC_FILE_HANDLE_NOT_INIT, startScanWithProjection(table, &sc, NULL, attrs, 0), "empty projection");
+		attrs[1] = 3;
+		ASSERT_EQUALS_INT(RC_FILE_HANDLE_NOT_INIT, startScanWithProjection(table, &sc, NULL, attrs, 2), "unknown attribute");
+		attrs[1] = 0;
+
+		TEST_CHECK(closeTable(table));
+		TEST_CHECK(deleteTable("test_table_j"));
+	}
+	TEST_CHECK(shutdownRecordManager());
+
+	for(j = 1; j < numConds; j++)
+		freeExpr(conds[j]);
+	freeSchema(schema);
+	free(rids);
+	free(table);
+	TEST_DONE();
+}
+
+void
+testAlignedLayout (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_PageFormat formats[] = { RM_PAGE_FIXED, RM_PAGE_SLOTTED, RM_PAGE_PAX };
+	int numInserts = 1000, i, k, rows;
+	int attrs[] = { 4, 1 };
+	RID *rids = (RID *) malloc(sizeof(RID) * numInserts);
+	char *names[] = { "flag", "a", "name", "f", "c" };
+	DataType dt[] = { DT_BOOL, DT_INT, DT_STRING, DT_FLOAT, DT_INT };
+	int sizes[] = { 0, 0, 5, 0, 0 };
+	int keys[] = { 1 };
+	int packedOffsets[] = { 0, 2, 6, 11, 15 };
+	int alignedOffsets[] = { 12, 0, 14, 4, 8 };
+	char name[8];
+	RM_ScanHandle sc;
+	Schema *schema, *packed;
+	Record *r;
+	Value *v;
+	Expr *cond;
+
+	testName = "test record layouts";
+	packed = createSchema(5, names, dt, sizes, 1, keys);
+	schema = createSchemaWithLayout(5, names, dt, sizes, 1, keys, LAYOUT_ALIGNED);
+	ASSERT_EQUALS_INT(19, getRecordSize(packed), "packed record size");
+	ASSERT_EQUALS_INT(20, getRecordSize(schema), "aligned record padded");
+	for(i = 0; i < 5; i++)
+	{
+		ASSERT_EQUALS_INT(packedOffsets[i], packed->attrOffsets[i], "packed offset");
+		ASSERT_EQUALS_INT(alignedOffsets[i], schema->attrOffsets[i], "aligned offset");
+	}
+
+	// c < 300 and f < 50.0, checked against the row values below
+	MAKE_BINOP_EXPR(cond, compareAttr(4, OP_COMP_SMALLER, "i300", false), compareAttr(3, OP_COMP_SMALLER, "f50.0", false), OP_BOOL_AND);
+
+	TEST_CHECK(initRecordManager(NULL));
+	for(k = 0; k < 3; k++)
+	{
+		TEST_CHECK(createTableWithFormat("test_table_l", schema, formats[k]));
+		TEST_CHECK(openTable(table, "test_table_l"));
+		TEST_CHECK(createRecord(&r, schema));
+		for(i = 0; i < numInserts; i++)
+		{
+			MAKE_VALUE(v, DT_BOOL, i % 2);
+			TEST_CHECK(setAttr(r, schema, 0, v));
+			freeVal(v);
+			MAKE_VALUE(v, DT_INT, i);
+			TEST_CHECK(setAttr(r, schema, 1, v));
+			freeVal(v);
+			sprintf(name, "n%d", i % 1000);
+			MAKE_STRING_VALUE(v, name);
+			TEST_CHECK(setAttr(r, schema, 2, v));
+			freeVal(v);
+			MAKE_VALUE(v, DT_FLOAT, i / 10.0f);
+			TEST_CHECK(setAttr(r, schema, 3, v));
+			freeVal(v);
+			MAKE_VALUE(v, DT_INT, numInserts - i);
+			TEST_CHECK(setAttr(r, schema, 4, v));
+			freeVal(v);
+			ASSERT_EQUALS_INT(i, *(int *) r->data, "int at offset 0");
+			TEST_CHECK(insertRecord(table, r));
+			rids[i] = r->id;
+		}
+
+		// the layout is stored with the table
+		TEST_CHECK(closeTable(table));
+		TEST_CHECK(openTable(table, "test_table_l"));
+		ASSERT_EQUALS_INT(LAYOUT_ALIGNED, table->schema->layout, "layout read back");
+		ASSERT_EQUALS_INT(20, getRecordSize(table->schema), "record size read back");
+		for(i = 0; i < numInserts; i += 97)
+		{
+			TEST_CHECK(getRecord(table, rids[i], r));
+			getAttr(r, table->schema, 2, &v);
+			sprintf(name, "n%d", i % 1000);
+			ASSERT_EQUALS_STRING(name, v->v.stringV, "string attribute");
+			freeVal(v);
+			getAttr(r, table->schema, 0, &v);
+			ASSERT_TRUE(v->v.boolV == i % 2, "bool attribute");
+			freeVal(v);
+			ASSERT_TRUE(*(float *) (r->data + 4) == i / 10.0f, "float at offset 4");
+		}
+		// f < 50 holds for a < 500, c < 300 for a > 700
+		ASSERT_EQUALS_INT(0, countMatches(table, cond), "conditions on aligned attributes");
+		freeExpr(cond->expr.op->args[1]);
+		cond->expr.op->args[1] = compareAttr(3, OP_COMP_SMALLER, "f80.0", false);
+		ASSERT_EQUALS_INT(99, countMatches(table, cond), "rows with 700 < a < 800");
+		freeExpr(cond->expr.op->args[1]);
+		cond->expr.op->args[1] = compareAttr(3, OP_COMP_SMALLER, "f50.0", false);
+
+		// projected records keep the layout
+		rows = 0;
+		TEST_CHECK(startScanWithProjection(table, &sc, NULL, attrs, 2));
+		ASSERT_EQUALS_INT(LAYOUT_ALIGNED, getScanSchema(&sc)->layout, "projected layout");
+		ASSERT_EQUALS_INT(8, getRecordSize(getScanSchema(&sc)), "projected size");
+		while(next(&sc, r) == RC_OK)
+		{
+			ASSERT_EQUALS_INT(numInserts, ((int *) r->data)[0] + ((int *) r->data)[1], "projected ints");
+			rows++;
+		}
+		TEST_CHECK(closeScan(&sc));
+		ASSERT_EQUALS_INT(numInserts, rows, "projected rows");
+
+		freeRecord(r);
+		TEST_CHECK(closeTable(table));
+		TEST_CHECK(deleteTable("test_table_l"));
+	}
+	TEST_CHECK(shutdownRecordManager());
+
+	freeExpr(cond);
+	freeSchema(schema);
+	freeSchema(packed);
+	free(rids);
+	free(table);
+	TEST_DONE();
+}
+
+void
+testTypedAttrs (void)
+{
+	char *names[] = { "a", "s", "f", "b" };
+	DataType dt[] = { DT_INT, DT_STRING, DT_FLOAT, DT_BOOL };
+	int sizes[] = { 0, 4, 0, 0 };
+	int keys[] = { 0 };
+	RecordLayout layouts[] = { LAYOUT_PACKED, LAYOUT_ALIGNED };
+	Schema *schema;
+	Record *r;
+	Value *v;
+	Expr *cond;
+	const char *str;
+	int k, i, len;
+	float f;
+	bool b;
+
+	testName = "test typed attribute accessors";
+	for(k = 0; k < 2; k++)
+	{
+		schema = createSchemaWithLayout(4, names, dt, sizes, 1, keys, layouts[k]);
+		TEST_CHECK(createRecord(&r, schema));
+
+		i = -42;
+		TEST_CHECK(setAttrRaw(r, schema, 0, &i, 0));
+		TEST_CHECK(setAttrRaw(r, schema, 1, "abcdef", 6));
+		f = 2.5f;
+		TEST_CHECK(setAttrRaw(r, schema, 2, &f, 0));
+		b = TRUE;
+		TEST_CHECK(setAttrRaw(r, schema, 3, &b, 0));
+
+		i = 0; f = 0; b = FALSE;
+		TEST_CHECK(getIntAttr(r, schema, 0, &i));
+		ASSERT_EQUALS_INT(-42, i, "int attribute");
+		TEST_CHECK(getFloatAttr(r, schema, 2, &f));
+		ASSERT_TRUE(f == 2.5f, "float attribute");
+		TEST_CHECK(getBoolAttr(r, schema, 3, &b));
+		ASSERT_TRUE(b == TRUE, "bool attribute");
+
+		// a string filling its width is not terminated in the record
+		TEST_CHECK(getStringAttrRef(r, schema, 1, &str, &len));
+		ASSERT_EQUALS_INT(4, len, "string cut to its width");
+		ASSERT_TRUE(memcmp(str, "abcd", 4) == 0, "string bytes");
+		ASSERT_TRUE(str >= r->data && str < r->data + getRecordSize(schema), "string points into record");
+		TEST_CHECK(setAttrRaw(r, schema, 1, "xy", 2));
+		TEST_CHECK(getStringAttrRef(r, schema, 1, &str, &len));
+		ASSERT_EQUALS_INT(2, len, "short string length");
+		getAttr(r, schema, 1, &v);
+		ASSERT_EQUALS_STRING("xy", v->v.stringV, "short string padded");
+		freeVal(v);
+
+		// typed and Value accessors see the same bytes
+		MAKE_VALUE(v, DT_INT, 7);
+		TEST_CHECK(setAttr(r, schema, 0, v));
+		freeVal(v);
+		TEST_CHECK(getIntAttr(r, schema, 0, &i));
+		ASSERT_EQUALS_INT(7, i, "int set through setAttr");
+
+		ASSERT_TRUE(getIntAttr(r, schema, 2, &i) == RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE, "int getter on float");
+		ASSERT_TRUE(getStringAttrRef(r, schema, 0, &str, &len) == RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE, "string getter on int");
+		ASSERT_TRUE(getFloatAttr(r, schema, 4, &f) == RC_FILE_HANDLE_NOT_INIT, "attribute out of range");
+		ASSERT_TRUE(setAttrRaw(r, schema, 1, NULL, 0) == RC_FILE_HANDLE_NOT_INIT, "missing value");
+
+		// conditions read numeric attributes through the typed getters
+		MAKE_BINOP_EXPR(cond, compareAttr(0, OP_COMP_SMALLER, "i8", false), compareAttr(2, OP_COMP_SMALLER, "f3.0", false), OP_BOOL_AND);
+		TEST_CHECK(evalExpr(r, schema, cond, &v));
+		ASSERT_TRUE(v->v.boolV, "condition on typed attributes");
+		freeVal(v);
+		freeExpr(cond);
+
+		freeRecord(r);
+		freeSchema(schema);
+	}
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testInvalidRids (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_PageFormat formats[] = { RM_PAGE_FIXED, RM_PAGE_SLOTTED, RM_PAGE_PAX };
+	RID bad[] = { {0, 0}, {1, 0}, {5000, 0}, {2, -1}, {2, 100000} };
+	SM_FileHandle fh;
+	Schema *schema;
+	Record *r;
+	int f, i, numPages;
+
+	testName = "test RIDs outside the table's data pages";
+	schema = testSchema();
+	TEST_CHECK(initRecordManager(NULL));
+	for(f = 0; f < 3; f++)
+	{
+		TEST_CHECK(createTableWithFormat("test_table_v", schema, formats[f]));
+		TEST_CHECK(openTable(table, "test_table_v"));
+		r = testRecord(schema, 1, "aaaa", 1);
+		TEST_CHECK(insertRecord(table, r));
+		TEST_CHECK(openPageFile("test_table_v.table", &fh));
+		numPages = fh.totalNumPages;
+		TEST_CHECK(closePageFile(&fh));
+
+		// the schema page, a map page, a page past the end and bad slots
+		for(i = 0; i < 5; i++)
+		{
+			r->id = bad[i];
+			ASSERT_EQUALS_INT(RC_FILE_NOT_FOUND, getRecord(table, bad[i], r), "getRecord rejects the RID");
+			ASSERT_EQUALS_INT(RC_FILE_NOT_FOUND, updateRecord(table, r), "updateRecord rejects the RID");
+			ASSERT_EQUALS_INT(RC_FILE_NOT_FOUND, deleteRecord(table, bad[i]), "deleteRecord rejects the RID");
+		}
+		ASSERT_EQUALS_INT(1, getNumTuples(table), "table unchanged");
+		TEST_CHECK(openPageFile("test_table_v.table", &fh));
+		ASSERT_EQUALS_INT(numPages, fh.totalNumPages, "file did not grow");
+		TEST_CHECK(closePageFile(&fh));
+
+		freeRecord(r);
+		TEST_CHECK(closeTable(table));
+		TEST_CHECK(deleteTable("test_table_v"));
+	}
+	TEST_CHECK(shutdownRecordManager());
+	freeSchema(schema);
+	free(table);
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testLongTableName (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	char name[400];
+	Schema *schema;
+	Record *r;
+	int i;
+
+	testName = "test table names longer than 256 characters";
+	// "./" prefixes keep every path component short enough for the file system
+	for(i = 0; i < 150; i++)
+		memcpy(name + 2 * i, "./", 2);
+	strcpy(name + 300, "test_table_l");
+	schema = testSchema();
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTableWithIndex(name, schema, RM_PAGE_FIXED, RM_INDEX_HASH));
+	TEST_CHECK(openTable(table, name));
+	r = testRecord(schema, 1, "aaaa", 1);
+	TEST_CHECK(insertRecord(table, r));
+	TEST_CHECK(closeTable(table));
+	ASSERT_TRUE(fileExists("test_table_l.table.warm"), "snapshot written under the full name");
+	TEST_CHECK(openTable(table, name));
+	ASSERT_EQUALS_INT(1, getNumTuples(table), "table reopened");
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable(name));
+	ASSERT_TRUE(!fileExists("test_table_l.table"), "table file removed");
+	ASSERT_TRUE(!fileExists("test_table_l.idx"), "index file removed");
+	ASSERT_TRUE(!fileExists("test_table_l.zone"), "zone file removed");
+	ASSERT_TRUE(!fileExists("test_table_l.table.warm"), "snapshot removed");
+
+	freeRecord(r);
+	TEST_CHECK(shutdownRecordManager());
+	freeSchema(schema);
+	free(table);
+	TEST_DONE();
+}
+
+RC
+countByWorker (Record *record, int worker, void *data)
+{
+	WorkerCounts *counts = (WorkerCounts *) data;
+	Value *v;
+
+	getAttr(record, counts->schema, 0, &v);
+	counts->rows[worker]++;
+	counts->keySum[worker] += v->v.intV;
+	freeVal(v);
+	return RC_OK;
+}
+
+RC
+stopAfterTen (Record *record, int worker, void *data)
+{
+	WorkerCounts *counts = (WorkerCounts *) data;
+
+	(void) record;
+	if (++counts->rows[worker] < 10)
+		return RC_OK;
+	__atomic_add_fetch(&counts->stopped, 1, __ATOMIC_RELAXED);
+	return RC_WRITE_FAILED;
+}
+
+// attr op value, or value op attr when constFirst is set
+Expr *
+compareAttr (int attr, OpType op, char *value, bool constFirst)
+{
+	Expr *ref, *cons, *result;
+
+	MAKE_ATTRREF(ref, attr);
+	MAKE_CONS(cons, stringToValue(value));
+	if (constFirst)
+		MAKE_BINOP_EXPR(result, cons, ref, op);
+	else
+		MAKE_BINOP_EXPR(result, ref, cons, op);
+	return result;
+}
+
+int
+countMatches (RM_TableData *table, Expr *cond)
+{
+	RM_ScanHandle sc;
+	Record *r;
+	int count = 0;
+
+	createRecord(&r, table->schema);
+	startScan(table, &sc, cond);
+	while(next(&sc, r) == RC_OK)
+		count++;
+	closeScan(&sc);
+	freeRecord(r);
+	return count;
+}
+
 Schema *
 testSchema (void)
 {
@@ -672,3 +2119,59 @@ testRecord(Schema *schema, int a, char *b, int c)
 
 	return result;
 }
+
+// Creates and opens a table of n rows a = i, b = "a", c = i % 7, then grows b
+// to "abcd" on every third row, which moves some slotted rows off their home
+// page. The RIDs of the rows end up in rids.
+void
+fillTable (RM_TableData *table, char *name, Schema *schema, RM_PageFormat format, RM_IndexKind index, int n, RID *rids)
+{
+	Record *r;
+	int i;
+
+	TEST_CHECK(createTableWithIndex(name, schema, format, index));
+	TEST_CHECK(openTable(table, name));
+	for(i = 0; i < n; i++)
+	{
+		r = testRecord(schema, i, "a", i % 7);
+		TEST_CHECK(insertRecord(table, r));
+		rids[i] = r->id;
+		freeRecord(r);
+	}
+	for(i = 0; i < n; i += 3)
+	{
+		r = testRecord(schema, i, "abcd", i % 7);
+		r->id = rids[i];
+		TEST_CHECK(updateRecord(table, r));
+		freeRecord(r);
+	}
+}
+
+// True if the pool's copy of a page matches the page in the file
+bool
+pageOnDisk (BM_BufferPool *bm, char *fileName, int pageNum)
+{
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	SM_FileHandle fh;
+	char page[PAGE_SIZE];
+	bool same;
+
+	TEST_CHECK(pinPage(bm, h, pageNum));
+	TEST_CHECK(openPageFile(fileName, &fh));
+	TEST_CHECK(readBlock(pageNum, &fh, page));
+	TEST_CHECK(closePageFile(&fh));
+	same = memcmp(page, h->data, PAGE_SIZE) == 0;
+	TEST_CHECK(unpinPage(bm, h));
+	free(h);
+	return same;
+}
+
+bool
+fileExists (char *name)
+{
+	FILE *file = fopen(name, "rb");
+	if (file == NULL)
+		return false;
+	fclose(file);
+	return true;
+}
@@ -0,0 +1,876 @@
+#include <stdlib.h>
+#include "dberror.h"
+#include "btree_mgr.h"
+#include "hash_mgr.h"
+#include "expr.h"
+#include "record_mgr.h"
+#include "tables.h"
+#include "test_helper.h"
+
+// test methods
+static void testInsertAndFind (void);
+static void testDelete (void);
+static void testRangeScan (void);
+static void testKeyTypes (void);
+static void testDuplicateKeys (void);
+static void testTableIndex (void);
+static void testHashIndex (void);
+static void testTableHashIndex (void);
+static void testIndexScans (void);
+
+// helper methods
+static int *permutation (int n);
+static RID ridOf (int key);
+static Expr *keyBetween (int low, int high);
+static Expr *compareConst (int attr, OpType op, int value, bool constFirst);
+static int scanCount (RM_TableData *table, Expr *cond, int *sum);
+
+// test name
+char *testName;
+
+// main method
+int
+main (void)
+{
+	testName = "";
+
+	testInsertAndFind();
+	testDelete();
+	testRangeScan();
+	testKeyTypes();
+	testDuplicateKeys();
+	testTableIndex();
+	testHashIndex();
+	testTableHashIndex();
+	testIndexScans();
+
+	return 0;
+}
+
+// ************************************************************
+void
+testInsertAndFind (void)
+{
+	BTreeHandle *tree;
+	Value key;
+	RID rid;
+	int numKeys = 5000, i, n;
+	int *keys = permutation(numKeys);
+	char *printed;
+
+	testName = "test b-tree inserting and finding keys";
+
+	TEST_CHECK(initIndexManager(NULL));
+
+	// small tree: check the shape
+	TEST_CHECK(createBtree("testidx", DT_INT, 2));
+	TEST_CHECK(openBtree(&tree, "testidx"));
+	key.dt = DT_INT;
+	for(i = 1; i <= 4; i++)
+	{
+		key.v.intV = i;
+		TEST_CHECK(insertKey(tree, &key, ridOf(i)));
+	}
+	printed = printTree(tree);
+	ASSERT_EQUALS_STRING("(0)[1,3,2]\n(1)[1.2,1,1.3,2,2]\n(2)[1.4,3,1.5,4]\n", printed, "tree after one split");
+	free(printed);
+	TEST_CHECK(getNumNodes(tree, &n));
+	ASSERT_EQUALS_INT(3, n, "number of nodes");
+	key.v.intV = 3;
+	ASSERT_EQUALS_INT(RC_IM_KEY_ALREADY_EXISTS, insertKey(tree, &key, ridOf(9)), "duplicate key rejected");
+	TEST_CHECK(closeBtree(tree));
+	TEST_CHECK(deleteBtree("testidx"));
+
+	// many keys in random order, across a reopen
+	TEST_CHECK(createBtree("testidx", DT_INT, 4));
+	TEST_CHECK(openBtree(&tree, "testidx"));
+	for(i = 0; i < numKeys; i++)
+	{
+		key.v.intV = keys[i];
+		TEST_CHECK(insertKey(tree, &key, ridOf(keys[i])));
+	}
+	TEST_CHECK(closeBtree(tree));
+	TEST_CHECK(openBtree(&tree, "testidx"));
+
+	TEST_CHECK(getNumEntries(tree, &n));
+	ASSERT_EQUALS_INT(numKeys, n, "number of entries");
+	for(i = 0; i < numKeys; i++)
+	{
+		key.v.intV = i;
+		TEST_CHECK(findKey(tree, &key, &rid));
+		ASSERT_TRUE(rid.page == ridOf(i).page && rid.slot == ridOf(i).slot, "found the inserted RID");
+	}
+	key.v.intV = numKeys;
+	ASSERT_EQUALS_INT(RC_IM_KEY_NOT_FOUND, findKey(tree, &key, &rid), "missing key not found");
+
+	TEST_CHECK(closeBtree(tree));
+	TEST_CHECK(deleteBtree("testidx"));
+	TEST_CHECK(shutdownIndexManager());
+
+	free(keys);
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testDelete (void)
+{
+	BTreeHandle *tree;
+	Value key;
+	RID rid;
+	int numKeys = 3000, i, n;
+	int *keys = permutation(numKeys);
+	int *deletes = permutation(numKeys);
+
+	testName = "test b-tree deleting keys";
+
+	TEST_CHECK(initIndexManager(NULL));
+	TEST_CHECK(createBtree("testidx", DT_INT, 3));
+	TEST_CHECK(openBtree(&tree, "testidx"));
+	key.dt = DT_INT;
+	for(i = 0; i < numKeys; i++)
+	{
+		key.v.intV = keys[i];
+		TEST_CHECK(insertKey(tree, &key, ridOf(keys[i])));
+	}
+
+	// delete every key with an odd position in a second random order
+	for(i = 1; i < numKeys; i += 2)
+	{
+		key.v.intV = deletes[i];
+		TEST_CHECK(deleteKey(tree, &key));
+	}
+	key.v.intV = deletes[1];
+	ASSERT_EQUALS_INT(RC_IM_KEY_NOT_FOUND, deleteKey(tree, &key), "deleting twice fails");
+	TEST_CHECK(getNumEntries(tree, &n));
+	ASSERT_EQUALS_INT(numKeys / 2, n, "entries after deletes");
+	for(i = 0; i < numKeys; i++)
+	{
+		key.v.intV = deletes[i];
+		if (i % 2)
+			ASSERT_EQUALS_INT(RC_IM_KEY_NOT_FOUND, findKey(tree, &key, &rid), "deleted key gone");
+		else
+			TEST_CHECK(findKey(tree, &key, &rid));
+	}
+
+	// emptying the tree collapses it to a single leaf
+	for(i = 0; i < numKeys; i += 2)
+	{
+		key.v.intV = deletes[i];
+		TEST_CHECK(deleteKey(tree, &key));
+	}
+	TEST_CHECK(getNumNodes(tree, &n));
+	ASSERT_EQUALS_INT(1, n, "empty tree is one node");
+	TEST_CHECK(getNumEntries(tree, &n));
+	ASSERT_EQUALS_INT(0, n, "empty tree has no entries");
+
+	// freed nodes are reused
+	for(i = 0; i < numKeys; i++)
+	{
+		key.v.intV = keys[i];
+		TEST_CHECK(insertKey(tree, &key, ridOf(keys[i])));
+	}
+	TEST_CHECK(getNumEntries(tree, &n));
+	ASSERT_EQUALS_INT(numKeys, n, "entries after reinserting");
+
+	TEST_CHECK(closeBtree(tree));
+	TEST_CHECK(deleteBtree("testidx"));
+	TEST_CHECK(shutdownIndexManager());
+
+	free(keys);
+	free(deletes);
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testRangeScan (void)
+{
+	BTreeHandle *tree;
+	BT_ScanHandle *sc;
+	Value key, low, high;
+	RID rid;
+	int numKeys = 2000, i, found;
+	int *keys = permutation(numKeys);
+	int rc;
+
+	testName = "test b-tree ordered and range scans";
+
+	TEST_CHECK(initIndexManager(NULL));
+	TEST_CHECK(createBtree("testidx", DT_INT, 0));
+	TEST_CHECK(openBtree(&tree, "testidx"));
+	key.dt = DT_INT;
+	for(i = 0; i < numKeys; i++)
+	{
+		key.v.intV = keys[i] * 2;
+		TEST_CHECK(insertKey(tree, &key, ridOf(keys[i])));
+	}
+
+	// full scan returns every entry in key order
+	found = 0;
+	TEST_CHECK(openTreeScan(tree, &sc));
+	while((rc = nextEntry(sc, &rid)) == RC_OK)
+	{
+		ASSERT_TRUE(rid.page == ridOf(found).page && rid.slot == ridOf(found).slot, "entries in key order");
+		found++;
+	}
+	ASSERT_EQUALS_INT(RC_IM_NO_MORE_ENTRIES, rc, "scan ends cleanly");
+	TEST_CHECK(closeTreeScan(sc));
+	ASSERT_EQUALS_INT(numKeys, found, "full scan count");
+
+	// bounds are inclusive and need not be keys themselves
+	low.dt = high.dt = DT_INT;
+	low.v.intV = 101;
+	high.v.intV = 300;
+	found = 0;
+	TEST_CHECK(openTreeRangeScan(tree, &low, &high, &sc));
+	while((rc = nextEntry(sc, &rid)) == RC_OK)
+	{
+		ASSERT_TRUE(rid.page == ridOf(51 + found).page && rid.slot == ridOf(51 + found).slot, "range entries in order");
+		found++;
+	}
+	TEST_CHECK(closeTreeScan(sc));
+	ASSERT_EQUALS_INT(100, found, "range scan count");
+
+	found = 0;
+	TEST_CHECK(openTreeRangeScan(tree, &low, NULL, &sc));
+	while(nextEntry(sc, &rid) == RC_OK)
+		found++;
+	TEST_CHECK(closeTreeScan(sc));
+	ASSERT_EQUALS_INT(numKeys - 51, found, "open-ended range scan count");
+
+	TEST_CHECK(closeBtree(tree));
+	TEST_CHECK(deleteBtree("testidx"));
+	TEST_CHECK(shutdownIndexManager());
+
+	free(keys);
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testKeyTypes (void)
+{
+	BTreeHandle *tree;
+	BT_ScanHandle *sc;
+	Value key, *v;
+	RID rid;
+	char name[16];
+	int numKeys = 500, i, found;
+	int *keys = permutation(numKeys);
+	DataType dt;
+
+	testName = "test b-tree float and string keys";
+
+	TEST_CHECK(initIndexManager(NULL));
+
+	TEST_CHECK(createBtree("testidx", DT_FLOAT, 3));
+	TEST_CHECK(openBtree(&tree, "testidx"));
+	TEST_CHECK(getKeyType(tree, &dt));
+	ASSERT_EQUALS_INT(DT_FLOAT, dt, "key type");
+	key.dt = DT_FLOAT;
+	for(i = 0; i < numKeys; i++)
+	{
+		key.v.floatV = keys[i] - 250.5f;
+		TEST_CHECK(insertKey(tree, &key, ridOf(keys[i])));
+	}
+	key.v.floatV = -0.5f;
+	TEST_CHECK(findKey(tree, &key, &rid));
+	ASSERT_TRUE(rid.page == ridOf(250).page && rid.slot == ridOf(250).slot, "float key found");
+	v = stringToValue("i1");
+	ASSERT_EQUALS_INT(RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE, findKey(tree, v, &rid), "wrong key type rejected");
+	freeVal(v);
+	TEST_CHECK(closeBtree(tree));
+	TEST_CHECK(deleteBtree("testidx"));
+
+	// fixed-width strings compare like strcmp
+	ASSERT_ERROR(createBtree("testidx", DT_STRING, 3), "string keys need a length");
+	TEST_CHECK(createBtreeWithOptions("testidx", DT_STRING, 8, 3, false));
+	TEST_CHECK(openBtree(&tree, "testidx"));
+	key.dt = DT_STRING;
+	key.v.stringV = name;
+	for(i = 0; i < numKeys; i++)
+	{
+		sprintf(name, "k%d", keys[i]);
+		TEST_CHECK(insertKey(tree, &key, ridOf(keys[i])));
+	}
+	sprintf(name, "k%d", 123);
+	TEST_CHECK(findKey(tree, &key, &rid));
+	ASSERT_TRUE(rid.page == ridOf(123).page && rid.slot == ridOf(123).slot, "string key found");
+
+	found = 0;
+	TEST_CHECK(openTreeScan(tree, &sc));
+	while(nextEntry(sc, &rid) == RC_OK)
+	{
+		// "k0" < "k1" < "k10" < "k100" < ...
+		if (found == 2) ASSERT_TRUE(rid.page == ridOf(10).page && rid.slot == ridOf(10).slot, "string order");
+		found++;
+	}
+	TEST_CHECK(closeTreeScan(sc));
+	ASSERT_EQUALS_INT(numKeys, found, "string scan count");
+
+	TEST_CHECK(closeBtree(tree));
+	TEST_CHECK(deleteBtree("testidx"));
+	TEST_CHECK(shutdownIndexManager());
+
+	free(keys);
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testDuplicateKeys (void)
+{
+	BTreeHandle *tree;
+	BT_ScanHandle *sc;
+	Value key;
+	RID rid;
+	int numKeys = 1000, i, found;
+
+	testName = "test b-tree with duplicate keys";
+
+	TEST_CHECK(initIndexManager(NULL));
+	TEST_CHECK(createBtreeWithOptions("testidx", DT_INT, 0, 4, true));
+	TEST_CHECK(openBtree(&tree, "testidx"));
+	key.dt = DT_INT;
+
+	// ten keys, each mapped to a hundred RIDs
+	for(i = numKeys - 1; i >= 0; i--)
+	{
+		key.v.intV = i % 10;
+		TEST_CHECK(insertKey(tree, &key, ridOf(i)));
+	}
+	key.v.intV = 7;
+	ASSERT_EQUALS_INT(RC_IM_KEY_ALREADY_EXISTS, insertKey(tree, &key, ridOf(17)), "same key and RID rejected");
+	TEST_CHECK(findKey(tree, &key, &rid));
+	ASSERT_TRUE(rid.page == ridOf(7).page && rid.slot == ridOf(7).slot, "lowest RID found first");
+
+	found = 0;
+	TEST_CHECK(openTreeRangeScan(tree, &key, &key, &sc));
+	while(nextEntry(sc, &rid) == RC_OK)
+	{
+		ASSERT_TRUE(rid.page == ridOf(7 + found * 10).page && rid.slot == ridOf(7 + found * 10).slot, "duplicates in RID order");
+		found++;
+	}
+	TEST_CHECK(closeTreeScan(sc));
+	ASSERT_EQUALS_INT(100, found, "all duplicates scanned");
+
+	TEST_CHECK(deleteKeyEntry(tree, &key, ridOf(507)));
+	ASSERT_EQUALS_INT(RC_IM_KEY_NOT_FOUND, deleteKeyEntry(tree, &key, ridOf(507)), "entry deleted once");
+	ASSERT_EQUALS_INT(RC_IM_KEY_NOT_FOUND, deleteKeyEntry(tree, &key, ridOf(508)), "RID under another key");
+	TEST_CHECK(getNumEntries(tree, &found));
+	ASSERT_EQUALS_INT(numKeys - 1, found, "entries after delete");
+
+	TEST_CHECK(closeBtree(tree));
+	TEST_CHECK(deleteBtree("testidx"));
+	TEST_CHECK(shutdownIndexManager());
+	TEST_DONE();
+}
+
+static RC
+setKey (Record *record, Schema *schema, void *data)
+{
+	Value v;
+	v.dt = DT_INT;
+	memcpy(&v.v.intV, record->data, sizeof(int));
+	v.v.intV += *(int *) data;
+	return setAttr(record, schema, 0, &v);
+}
+
+// ************************************************************
+void
+testTableIndex (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	BTreeHandle *tree;
+	Schema *schema;
+	Record *r;
+	Value *v;
+	Expr *sel;
+	RID *rids;
+	RID rid;
+	RM_PageFormat formats[] = { RM_PAGE_FIXED, RM_PAGE_SLOTTED, RM_PAGE_PAX };
+	int numInserts = 1000, offset = 10000, i, k, n;
+	char *names[] = { "a", "b" };
+	DataType dt[] = { DT_INT, DT_STRING };
+	int sizes[] = { 0, 8 };
+	int keys[] = { 0 };
+	char **cpNames = (char **) malloc(sizeof(char*) * 2);
+	DataType *cpDt = (DataType *) malloc(sizeof(DataType) * 2);
+	int *cpSizes = (int *) malloc(sizeof(int) * 2);
+	int *cpKeys = (int *) malloc(sizeof(int));
+
+	testName = "test table key index kept in sync";
+	for(i = 0; i < 2; i++)
+	{
+		cpNames[i] = (char *) malloc(2);
+		strcpy(cpNames[i], names[i]);
+	}
+	memcpy(cpDt, dt, sizeof(DataType) * 2);
+	memcpy(cpSizes, sizes, sizeof(int) * 2);
+	memcpy(cpKeys, keys, sizeof(int));
+	schema = createSchema(2, cpNames, cpDt, cpSizes, 1, cpKeys);
+	rids = (RID *) malloc(sizeof(RID) * numInserts);
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createRecord(&r, schema));
+	v = stringToValue("sindexed");
+	TEST_CHECK(setAttr(r, schema, 1, v));
+	freeVal(v);
+	// each page format reads the old key out of its own layout
+	for(k = 0; k < 3; k++)
+	{
+		TEST_CHECK(createTableWithIndex("test_table_i", schema, formats[k], RM_INDEX_BTREE));
+		TEST_CHECK(openTable(table, "test_table_i"));
+		for(i = 0; i < numInserts; i++)
+		{
+			memcpy(r->data, &i, sizeof(int));
+			TEST_CHECK(insertRecord(table, r));
+			rids[i] = r->id;
+		}
+
+		// change the key of the first 100 rows, delete the next 100
+		for(i = 0; i < 100; i++)
+		{
+			n = i + offset;
+			memcpy(r->data, &n, sizeof(int));
+			r->id = rids[i];
+			TEST_CHECK(updateRecord(table, r));
+			TEST_CHECK(deleteRecord(table, rids[100 + i]));
+		}
+		// shift keys 900..999, then delete keys 800..899
+		sel = keyBetween(900, numInserts);
+		TEST_CHECK(updateWhere(table, sel, setKey, &offset));
+		freeExpr(sel);
+		sel = keyBetween(800, 900);
+		TEST_CHECK(deleteWhere(table, sel));
+		freeExpr(sel);
+		TEST_CHECK(closeTable(table));
+
+		// the index file mirrors the table
+		TEST_CHECK(openBtree(&tree, "test_table_i.idx"));
+		TEST_CHECK(getNumEntries(tree, &n));
+		ASSERT_EQUALS_INT(numInserts - 200, n, "one entry per row");
+		v = stringToValue("i0");
+		for(i = 0; i < numInserts; i++)
+		{
+			v->v.intV = i;
+			if (i < 200 || (i >= 800 && i < 900))
+				ASSERT_EQUALS_INT(RC_IM_KEY_NOT_FOUND, findKey(tree, v, &rid), "old or deleted key gone");
+			else if (i < 800)
+				TEST_CHECK(findKey(tree, v, &rid));
+			v->v.intV = i + offset;
+			if (i < 100 || i >= 900)
+			{
+				TEST_CHECK(findKey(tree, v, &rid));
+				ASSERT_TRUE(rid.page == rids[i].page && rid.slot == rids[i].slot, "changed key points at its row");
+			}
+		}
+		freeVal(v);
+		TEST_CHECK(closeBtree(tree));
+
+		TEST_CHECK(deleteTable("test_table_i"));
+	}
+	TEST_CHECK(shutdownRecordManager());
+
+	freeRecord(r);
+	freeSchema(schema);
+	free(rids);
+	free(table);
+	TEST_DONE();
+}
+
+// 0 .. n - 1 in a fixed pseudo-random order
+int *
+permutation (int n)
+{
+	int *result = (int *) malloc(sizeof(int) * n);
+	int i, j, tmp;
+
+	for(i = 0; i < n; i++)
+		result[i] = i;
+	srand(n);
+	for(i = n - 1; i > 0; i--)
+	{
+		j = rand() % (i + 1);
+		tmp = result[i];
+		result[i] = result[j];
+		result[j] = tmp;
+	}
+	return result;
+}
+
+// ************************************************************
+void
+testHashIndex (void)
+{
+	HashHandle *index;
+	HT_ScanHandle *sc;
+	Value key;
+	RID rid;
+	int numKeys = 20000, i, n, found;
+	int *keys = permutation(numKeys);
+
+	testName = "test linear hash index";
+
+	TEST_CHECK(createHashIndex("testidx", DT_INT, 0));
+	TEST_CHECK(openHashIndex(&index, "testidx"));
+	key.dt = DT_INT;
+	for(i = 0; i < numKeys; i++)
+	{
+		key.v.intV = keys[i];
+		TEST_CHECK(insertHashKey(index, &key, ridOf(keys[i])));
+	}
+	key.v.intV = 5;
+	ASSERT_EQUALS_INT(RC_IM_KEY_ALREADY_EXISTS, insertHashKey(index, &key, ridOf(5)), "same key and RID rejected");
+	TEST_CHECK(insertHashKey(index, &key, ridOf(6)));
+	TEST_CHECK(getNumBuckets(index, &n));
+	ASSERT_TRUE(n > 64, "buckets split as the index grew");
+	TEST_CHECK(closeHashIndex(index));
+
+	// every key is found after a reopen
+	TEST_CHECK(openHashIndex(&index, "testidx"));
+	TEST_CHECK(getNumHashEntries(index, &n));
+	ASSERT_EQUALS_INT(numKeys + 1, n, "number of entries");
+	for(i = 0; i < numKeys; i++)
+	{
+		key.v.intV = i;
+		TEST_CHECK(findHashKey(index, &key, &rid));
+		if (i != 5)
+			ASSERT_TRUE(rid.page == ridOf(i).page && rid.slot == ridOf(i).slot, "found the inserted RID");
+	}
+	key.v.intV = numKeys;
+	ASSERT_EQUALS_INT(RC_IM_KEY_NOT_FOUND, findHashKey(index, &key, &rid), "missing key not found");
+
+	key.v.intV = 5;
+	found = 0;
+	TEST_CHECK(openHashScan(index, &key, &sc));
+	while(nextHashEntry(sc, &rid) == RC_OK)
+		found++;
+	TEST_CHECK(closeHashScan(sc));
+	ASSERT_EQUALS_INT(2, found, "both RIDs of a duplicate key");
+
+	// delete the even keys
+	for(i = 0; i < numKeys; i += 2)
+	{
+		key.v.intV = i;
+		TEST_CHECK(deleteHashKey(index, &key, ridOf(i)));
+	}
+	key.v.intV = 0;
+	ASSERT_EQUALS_INT(RC_IM_KEY_NOT_FOUND, deleteHashKey(index, &key, ridOf(0)), "entry deleted once");
+	for(i = 0; i < numKeys; i++)
+	{
+		key.v.intV = i;
+		if (i % 2 == 0)
+			ASSERT_EQUALS_INT(RC_IM_KEY_NOT_FOUND, findHashKey(index, &key, &rid), "deleted key gone");
+		else
+			TEST_CHECK(findHashKey(index, &key, &rid));
+	}
+	TEST_CHECK(getNumHashEntries(index, &n));
+	ASSERT_EQUALS_INT(numKeys / 2 + 1, n, "entries after delete");
+
+	TEST_CHECK(closeHashIndex(index));
+	TEST_CHECK(deleteHashIndex("testidx"));
+
+	// string keys compare by their characters only
+	TEST_CHECK(createHashIndex("testidx", DT_STRING, 8));
+	TEST_CHECK(openHashIndex(&index, "testidx"));
+	key.dt = DT_STRING;
+	key.v.stringV = "abc";
+	TEST_CHECK(insertHashKey(index, &key, ridOf(1)));
+	key.v.stringV = "abcd";
+	ASSERT_EQUALS_INT(RC_IM_KEY_NOT_FOUND, findHashKey(index, &key, &rid), "longer key differs");
+	key.v.stringV = "abc";
+	TEST_CHECK(findHashKey(index, &key, &rid));
+	key.dt = DT_INT;
+	ASSERT_EQUALS_INT(RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE, findHashKey(index, &key, &rid), "key type checked");
+	TEST_CHECK(closeHashIndex(index));
+	TEST_CHECK(deleteHashIndex("testidx"));
+
+	free(keys);
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testTableHashIndex (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	HashHandle *index;
+	Schema *schema;
+	Record *r;
+	Value key;
+	RID *rids;
+	RID rid;
+	int numInserts = 2000, offset = 10000, i, n;
+	char *names[] = { "a", "b" };
+	DataType dt[] = { DT_INT, DT_INT };
+	int sizes[] = { 0, 0 };
+	int keys[] = { 0 };
+	char **cpNames = (char **) malloc(sizeof(char*) * 2);
+	DataType *cpDt = (DataType *) malloc(sizeof(DataType) * 2);
+	int *cpSizes = (int *) malloc(sizeof(int) * 2);
+	int *cpKeys = (int *) malloc(sizeof(int));
+
+	testName = "test table hash index kept in sync";
+	for(i = 0; i < 2; i++)
+	{
+		cpNames[i] = (char *) malloc(2);
+		strcpy(cpNames[i], names[i]);
+	}
+	memcpy(cpDt, dt, sizeof(DataType) * 2);
+	memcpy(cpSizes, sizes, sizeof(int) * 2);
+	memcpy(cpKeys, keys, sizeof(int));
+	schema = createSchema(2, cpNames, cpDt, cpSizes, 1, cpKeys);
+	rids = (RID *) malloc(sizeof(RID) * numInserts);
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTableWithIndex("test_table_h", schema, RM_PAGE_FIXED, RM_INDEX_HASH));
+	TEST_CHECK(openTable(table, "test_table_h"));
+	TEST_CHECK(createRecord(&r, schema));
+	for(i = 0; i < numInserts; i++)
+	{
+		memcpy(r->data, &i, sizeof(int));
+		memcpy(r->data + sizeof(int), &i, sizeof(int));
+		TEST_CHECK(insertRecord(table, r));
+		rids[i] = r->id;
+	}
+	// move the keys of the first 100 rows, delete the next 100
+	for(i = 0; i < 100; i++)
+	{
+		n = i + offset;
+		memcpy(r->data, &n, sizeof(int));
+		memcpy(r->data + sizeof(int), &i, sizeof(int));
+		r->id = rids[i];
+		TEST_CHECK(updateRecord(table, r));
+		TEST_CHECK(deleteRecord(table, rids[100 + i]));
+	}
+	TEST_CHECK(closeTable(table));
+
+	// the table reopens with its index
+	TEST_CHECK(openTable(table, "test_table_h"));
+	memcpy(r->data, &numInserts, sizeof(int));
+	TEST_CHECK(insertRecord(table, r));
+	TEST_CHECK(closeTable(table));
+
+	TEST_CHECK(openHashIndex(&index, "test_table_h.idx"));
+	TEST_CHECK(getNumHashEntries(index, &n));
+	ASSERT_EQUALS_INT(numInserts - 100 + 1, n, "one entry per row");
+	key.dt = DT_INT;
+	for(i = 0; i < numInserts; i++)
+	{
+		key.v.intV = i;
+		if (i < 200)
+			ASSERT_EQUALS_INT(RC_IM_KEY_NOT_FOUND, findHashKey(index, &key, &rid), "old or deleted key gone");
+		else
+		{
+			TEST_CHECK(findHashKey(index, &key, &rid));
+			ASSERT_TRUE(rid.page == rids[i].page && rid.slot == rids[i].slot, "key points at its row");
+		}
+		key.v.intV = i + offset;
+		if (i < 100)
+		{
+			TEST_CHECK(findHashKey(index, &key, &rid));
+			ASSERT_TRUE(rid.page == rids[i].page && rid.slot == rids[i].slot, "changed key points at its row");
+		}
+	}
+	key.v.intV = numInserts;
+	TEST_CHECK(findHashKey(index, &key, &rid));
+	TEST_CHECK(closeHashIndex(index));
+	TEST_CHECK(deleteTable("test_table_h"));
+
+	// only a single key attribute can be indexed
+	schema->keySize = 0;
+	ASSERT_EQUALS_INT(RC_IM_UNSUPPORTED_INDEX_FORMAT,
+			createTableWithIndex("test_table_h", schema, RM_PAGE_FIXED, RM_INDEX_HASH), "unkeyed schema not indexed");
+	schema->keySize = 1;
+	TEST_CHECK(shutdownRecordManager());
+
+	freeRecord(r);
+	freeSchema(schema);
+	free(rids);
+	free(table);
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testIndexScans (void)
+{
+	RM_TableData *tables[3];
+	RM_IndexKind kinds[] = { RM_INDEX_NONE, RM_INDEX_BTREE, RM_INDEX_HASH };
+	char *tableNames[] = { "test_table_s0", "test_table_s1", "test_table_s2" };
+	Schema *schema;
+	Record *r;
+	Expr *conds[9], *left, *right;
+	int expected[] = { 2, 20, 20, 10, 20, 0, 2, 1000, 1 };
+	RID *rids[3];
+	int numInserts = 1000, numConds = 9, i, j, k, n, sum, firstSum;
+	char *names[] = { "a", "b" };
+	DataType dt[] = { DT_INT, DT_INT };
+	int sizes[] = { 0, 0 };
+	int keys[] = { 0 };
+	char **cpNames = (char **) malloc(sizeof(char*) * 2);
+	DataType *cpDt = (DataType *) malloc(sizeof(DataType) * 2);
+	int *cpSizes = (int *) malloc(sizeof(int) * 2);
+	int *cpKeys = (int *) malloc(sizeof(int));
+
+	testName = "test scans answered from an index";
+	for(i = 0; i < 2; i++)
+	{
+		cpNames[i] = (char *) malloc(2);
+		strcpy(cpNames[i], names[i]);
+	}
+	memcpy(cpDt, dt, sizeof(DataType) * 2);
+	memcpy(cpSizes, sizes, sizeof(int) * 2);
+	memcpy(cpKeys, keys, sizeof(int));
+	schema = createSchema(2, cpNames, cpDt, cpSizes, 1, cpKeys);
+
+	// a = i % 500, so every key appears twice; b = i
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createRecord(&r, schema));
+	for(k = 0; k < 3; k++)
+	{
+		tables[k] = (RM_TableData *) malloc(sizeof(RM_TableData));
+		rids[k] = (RID *) malloc(sizeof(RID) * numInserts);
+		TEST_CHECK(createTableWithIndex(tableNames[k], schema, RM_PAGE_FIXED, kinds[k]));
+		TEST_CHECK(openTable(tables[k], tableNames[k]));
+		for(i = 0; i < numInserts; i++)
+		{
+			n = i % 500;
+			memcpy(r->data, &n, sizeof(int));
+			memcpy(r->data + sizeof(int), &i, sizeof(int));
+			TEST_CHECK(insertRecord(tables[k], r));
+			rids[k][i] = r->id;
+		}
+	}
+
+	// a = 7
+	conds[0] = compareConst(0, OP_COMP_EQUAL, 7, false);
+	// a < 10
+	conds[1] = compareConst(0, OP_COMP_SMALLER, 10, false);
+	// 489 < a
+	conds[2] = compareConst(0, OP_COMP_SMALLER, 489, true);
+	// a = 3 or a = 300 or 7 = a or a < 2, with a repeated key
+	MAKE_BINOP_EXPR(left, compareConst(0, OP_COMP_EQUAL, 3, false), compareConst(0, OP_COMP_EQUAL, 300, false), OP_BOOL_OR);
+	MAKE_BINOP_EXPR(right, compareConst(0, OP_COMP_EQUAL, 7, true), compareConst(0, OP_COMP_SMALLER, 2, false), OP_BOOL_OR);
+	MAKE_BINOP_EXPR(conds[3], left, right, OP_BOOL_OR);
+	// 40 <= a < 50 with overlapping bounds
+	MAKE_BINOP_EXPR(left, keyBetween(40, 50), compareConst(0, OP_COMP_SMALLER, 60, false), OP_BOOL_AND);
+	conds[4] = left;
+	// a < 5 and 10 < a
+	MAKE_BINOP_EXPR(conds[5], compareConst(0, OP_COMP_SMALLER, 5, false), compareConst(0, OP_COMP_SMALLER, 10, true), OP_BOOL_AND);
+	// a = 20 or a = 20
+	MAKE_BINOP_EXPR(conds[6], compareConst(0, OP_COMP_EQUAL, 20, false), compareConst(0, OP_COMP_EQUAL, 20, false), OP_BOOL_OR);
+	// b < 2000 bounds nothing on the key
+	conds[7] = compareConst(1, OP_COMP_SMALLER, 2000, false);
+	// a = 42 and b < 500, with a residual on b
+	MAKE_BINOP_EXPR(conds[8], compareConst(0, OP_COMP_EQUAL, 42, false), compareConst(1, OP_COMP_SMALLER, 500, false), OP_BOOL_AND);
+
+	for(j = 0; j < numConds; j++)
+	{
+		firstSum = 0;
+		for(k = 0; k < 3; k++)
+		{
+			ASSERT_EQUALS_INT(expected[j], scanCount(tables[k], conds[j], &sum), "rows matched");
+			if (k == 0)
+				firstSum = sum;
+			ASSERT_EQUALS_INT(firstSum, sum, "same rows as the heap scan");
+		}
+	}
+
+	// a row deleted while the scan is open is skipped
+	for(k = 0; k < 3; k++)
+	{
+		RM_ScanHandle sc;
+		n = 0;
+		TEST_CHECK(startScan(tables[k], &sc, conds[1]));
+		while(next(&sc, r) == RC_OK)
+		{
+			if (n++ == 0)
+				TEST_CHECK(deleteRecord(tables[k], rids[k][505]));
+		}
+		TEST_CHECK(closeScan(&sc));
+		ASSERT_EQUALS_INT(19, n, "deleted row skipped");
+	}
+
+	for(j = 0; j < numConds; j++)
+		freeExpr(conds[j]);
+	for(k = 0; k < 3; k++)
+	{
+		TEST_CHECK(closeTable(tables[k]));
+		TEST_CHECK(deleteTable(tableNames[k]));
+		free(tables[k]);
+		free(rids[k]);
+	}
+	TEST_CHECK(shutdownRecordManager());
+	freeRecord(r);
+	freeSchema(schema);
+	TEST_DONE();
+}
+
+// low <= a < high
+Expr *
+keyBetween (int low, int high)
+{
+	Expr *attr, *bound, *below, *above, *notBelow;
+	char cons[16];
+
+	MAKE_ATTRREF(attr, 0);
+	sprintf(cons, "i%d", low);
+	MAKE_CONS(bound, stringToValue(cons));
+	MAKE_BINOP_EXPR(below, attr, bound, OP_COMP_SMALLER);
+	MAKE_UNOP_EXPR(notBelow, below, OP_BOOL_NOT);
+	MAKE_ATTRREF(attr, 0);
+	sprintf(cons, "i%d", high);
+	MAKE_CONS(bound, stringToValue(cons));
+	MAKE_BINOP_EXPR(above, attr, bound, OP_COMP_SMALLER);
+	MAKE_BINOP_EXPR(below, notBelow, above, OP_BOOL_AND);
+	return below;
+}
+
+// attr op value, or value op attr when constFirst is set
+Expr *
+compareConst (int attr, OpType op, int value, bool constFirst)
+{
+	Expr *ref, *cons, *result;
+	char text[16];
+
+	MAKE_ATTRREF(ref, attr);
+	sprintf(text, "i%d", value);
+	MAKE_CONS(cons, stringToValue(text));
+	if (constFirst)
+		MAKE_BINOP_EXPR(result, cons, ref, op);
+	else
+		MAKE_BINOP_EXPR(result, ref, cons, op);
+	return result;
+}
+
+// Counts the rows matching cond and sums their b
+int
+scanCount (RM_TableData *table, Expr *cond, int *sum)
+{
+	RM_ScanHandle sc;
+	Record *r;
+	int count = 0, b;
+
+	createRecord(&r, table->schema);
+	*sum = 0;
+	startScan(table, &sc, cond);
+	while(next(&sc, r) == RC_OK)
+	{
+		memcpy(&b, r->data + sizeof(int), sizeof(int));
+		*sum += b;
+		count++;
+	}
+	closeScan(&sc);
+	freeRecord(r);
+	return count;
+}
+
+RID
+ridOf (int key)
+{
+	RID rid = { key / 10 + 1, key % 10 + 1 };
+	return rid;
+}
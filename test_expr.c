@@ -29,6 +29,11 @@
 static void testValueSerialize (void);
 static void testOperators (void);
 static void testExpressions (void);
+static void testPredicates (void);
+static void testPredicateBatches (void);
+static void testShortCircuit (void);
+static void testAdaptiveChains (void);
+static Expr *attrCompare (int attr, OpType op, char *value);
 
 char *testName;
 
@@ -41,6 +46,10 @@ main (void)
 	testValueSerialize();
 	testOperators();
 	testExpressions();
+	testPredicates();
+	testPredicateBatches();
+	testShortCircuit();
+	testAdaptiveChains();
 
 	return 0;
 }
@@ -123,3 +132,304 @@ testExpressions (void)
 
 	TEST_DONE();
 }
+
+// ************************************************************
+void
+testPredicates (void)
+{
+	char *names[] = { "a", "s", "f", "b" };
+	DataType dt[] = { DT_INT, DT_STRING, DT_FLOAT, DT_BOOL };
+	int sizes[] = { 0, 4, 0, 0 };
+	int keys[] = { 0 };
+	char *strings[] = { "", "a", "ab", "abc", "abcd", "abce", "b", "abcd", "ab", "zzzz" };
+	RecordLayout layouts[] = { LAYOUT_PACKED, LAYOUT_ALIGNED };
+	Expr *conds[9], *l, *r;
+	Predicate *pred;
+	Schema *schema;
+	Record *rec;
+	Value *res;
+	int i, j, k;
+	float f;
+	bool b;
+	testName = "test compiled predicates";
+
+	conds[0] = attrCompare(0, OP_COMP_SMALLER, "i5");
+	conds[1] = attrCompare(1, OP_COMP_EQUAL, "sab");
+	// strings filling the attribute's width against shorter and longer constants
+	MAKE_BINOP_EXPR(conds[2], attrCompare(1, OP_COMP_SMALLER, "sabcd"), attrCompare(1, OP_COMP_EQUAL, "sabcd"), OP_BOOL_OR);
+	conds[3] = attrCompare(1, OP_COMP_SMALLER, "sabcde");
+	MAKE_UNOP_EXPR(l, attrCompare(2, OP_COMP_SMALLER, "f2.5"), OP_BOOL_NOT);
+	MAKE_BINOP_EXPR(conds[4], l, attrCompare(3, OP_COMP_EQUAL, "btrue"), OP_BOOL_AND);
+	// comparing the results of two comparisons
+	MAKE_BINOP_EXPR(conds[5], attrCompare(0, OP_COMP_SMALLER, "i3"), attrCompare(2, OP_COMP_SMALLER, "f1.0"), OP_COMP_EQUAL);
+	MAKE_ATTRREF(conds[6], 3);
+	MAKE_CONS(l, stringToValue("i3"));
+	MAKE_ATTRREF(r, 0);
+	MAKE_BINOP_EXPR(conds[7], l, r, OP_COMP_SMALLER);
+	MAKE_BINOP_EXPR(conds[8], attrCompare(2, OP_COMP_EQUAL, "f4.0"), attrCompare(1, OP_COMP_SMALLER, "sab"), OP_BOOL_OR);
+
+	for(k = 0; k < 2; k++)
+	{
+		schema = createSchemaWithLayout(4, names, dt, sizes, 1, keys, layouts[k]);
+		TEST_CHECK(createRecord(&rec, schema));
+		for(j = 0; j < 9; j++)
+		{
+			TEST_CHECK(compilePredicate(conds[j], schema, &pred));
+			for(i = 0; i < 10; i++)
+			{
+				f = i * 0.5f;
+				b = i % 2;
+				TEST_CHECK(setAttrRaw(rec, schema, 0, &i, 0));
+				TEST_CHECK(setAttrRaw(rec, schema, 1, strings[i], strlen(strings[i])));
+				TEST_CHECK(setAttrRaw(rec, schema, 2, &f, 0));
+				TEST_CHECK(setAttrRaw(rec, schema, 3, &b, 0));
+				TEST_CHECK(evalExpr(rec, schema, conds[j], &res));
+				ASSERT_TRUE(!res->v.boolV == !evalPredicate(pred, rec), "compiled predicate agrees with evalExpr");
+				freeVal(res);
+			}
+			freePredicate(pred);
+		}
+
+		// bools compare false < true
+		l = attrCompare(3, OP_COMP_SMALLER, "btrue");
+		TEST_CHECK(compilePredicate(l, schema, &pred));
+		for(i = 0; i < 2; i++)
+		{
+			b = i;
+			TEST_CHECK(setAttrRaw(rec, schema, 3, &b, 0));
+			ASSERT_TRUE(evalPredicate(pred, rec) == (i == 0), "bool smaller");
+		}
+		freePredicate(pred);
+		freeExpr(l);
+
+		// conditions that are not well-typed booleans are not compiled
+		l = attrCompare(0, OP_COMP_EQUAL, "sx");
+		ASSERT_TRUE(compilePredicate(l, schema, &pred) == RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE, "operand types differ");
+		ASSERT_TRUE(pred == NULL, "no predicate on error");
+		freeExpr(l);
+		MAKE_ATTRREF(l, 0);
+		ASSERT_TRUE(compilePredicate(l, schema, &pred) == RC_RM_EXPR_RESULT_IS_NOT_BOOLEAN, "int condition");
+		MAKE_UNOP_EXPR(r, l, OP_BOOL_NOT);
+		ASSERT_TRUE(compilePredicate(r, schema, &pred) == RC_RM_BOOLEAN_EXPR_ARG_IS_NOT_BOOLEAN, "NOT of an int");
+		freeExpr(r);
+
+		freeRecord(rec);
+		freeSchema(schema);
+	}
+	for(j = 0; j < 9; j++)
+		freeExpr(conds[j]);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testPredicateBatches (void)
+{
+	char *names[] = { "a", "s", "f", "b" };
+	DataType dt[] = { DT_INT, DT_STRING, DT_FLOAT, DT_BOOL };
+	int sizes[] = { 0, 4, 0, 0 };
+	int keys[] = { 0 };
+	int numRows = 300, size, i, j, a;
+	uint64_t selection[5], columnSelection[5];
+	const char *columns[4];
+	int widths[4];
+	char *cols[4];
+	Expr *conds[6], *l, *r;
+	Predicate *pred;
+	Schema *schema;
+	Record rec;
+	char *rows, str[5];
+	float f;
+	bool b;
+	testName = "test predicates on batches of rows";
+
+	conds[0] = attrCompare(0, OP_COMP_SMALLER, "i-17");
+	conds[1] = attrCompare(2, OP_COMP_EQUAL, "f3.0");
+	MAKE_UNOP_EXPR(l, attrCompare(0, OP_COMP_EQUAL, "i4"), OP_BOOL_NOT);
+	MAKE_BINOP_EXPR(conds[2], l, attrCompare(2, OP_COMP_SMALLER, "f1.5"), OP_BOOL_AND);
+	MAKE_BINOP_EXPR(l, attrCompare(1, OP_COMP_SMALLER, "s5"), attrCompare(3, OP_COMP_EQUAL, "btrue"), OP_BOOL_OR);
+	MAKE_BINOP_EXPR(conds[3], l, attrCompare(0, OP_COMP_SMALLER, "i0"), OP_BOOL_AND);
+	MAKE_CONS(l, stringToValue("f0.5"));
+	MAKE_ATTRREF(r, 2);
+	MAKE_BINOP_EXPR(conds[4], l, r, OP_COMP_SMALLER);
+	MAKE_BINOP_EXPR(conds[5], attrCompare(0, OP_COMP_SMALLER, "i0"), attrCompare(2, OP_COMP_SMALLER, "f0.0"), OP_COMP_EQUAL);
+
+	schema = createSchemaWithLayout(4, names, dt, sizes, 1, keys, LAYOUT_PACKED);
+	size = getRecordSize(schema);
+	rows = (char *) calloc(numRows, size);
+	for(i = 0; i < numRows; i++)
+	{
+		rec.data = rows + i * size;
+		a = (i * 37) % 101 - 50;
+		f = (i % 13) * 0.5f - 2.0f;
+		b = i % 3 == 0;
+		sprintf(str, "%d", i % 10);
+		TEST_CHECK(setAttrRaw(&rec, schema, 0, &a, 0));
+		TEST_CHECK(setAttrRaw(&rec, schema, 1, str, strlen(str)));
+		TEST_CHECK(setAttrRaw(&rec, schema, 2, &f, 0));
+		TEST_CHECK(setAttrRaw(&rec, schema, 3, &b, 0));
+	}
+	// the same rows stored column by column, as on a PAX page
+	for(j = 0; j < 4; j++)
+	{
+		widths[j] = schema->attrSizes[j];
+		cols[j] = (char *) malloc(numRows * widths[j]);
+		for(i = 0; i < numRows; i++)
+			memcpy(cols[j] + i * widths[j], rows + i * size + schema->attrOffsets[j], widths[j]);
+		columns[j] = cols[j] + widths[j];
+	}
+
+	for(j = 0; j < 6; j++)
+	{
+		TEST_CHECK(compilePredicate(conds[j], schema, &pred));
+		// a batch that does not start at the first row and ends mid-word
+		memset(selection, 0xff, sizeof(selection));
+		evalPredicateBatch(pred, rows + size, size, numRows - 1, selection);
+		for(i = 1; i < numRows; i++)
+		{
+			rec.data = rows + i * size;
+			b = (selection[(i - 1) / 64] >> ((i - 1) % 64)) & 1;
+			ASSERT_TRUE(b == !!evalPredicate(pred, &rec), "batch agrees with row at a time");
+		}
+		ASSERT_TRUE((selection[4] >> ((numRows - 1) % 64)) == 0, "bits past the batch cleared");
+		memset(columnSelection, 0xff, sizeof(columnSelection));
+		evalPredicateColumns(pred, columns, widths, numRows - 1, columnSelection);
+		ASSERT_TRUE(memcmp(selection, columnSelection, sizeof(selection)) == 0, "columns agree with rows");
+		freePredicate(pred);
+		freeExpr(conds[j]);
+	}
+
+	for(j = 0; j < 4; j++)
+		free(cols[j]);
+	free(rows);
+	freeSchema(schema);
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testShortCircuit (void)
+{
+	Expr *op, *l, *r;
+	Value *res;
+	testName = "test short-circuit evaluation";
+
+	// the right sides compare an int with a string and would fail
+	MAKE_CONS(l, stringToValue("bf"));
+	MAKE_BINOP_EXPR(op, l, attrCompare(0, OP_COMP_EQUAL, "sx"), OP_BOOL_AND);
+	TEST_CHECK(evalExpr(NULL, NULL, op, &res));
+	OP_TRUE(stringToValue("bf"), res, valueEquals, "false AND ... is false");
+	freeVal(res);
+	freeExpr(op);
+
+	MAKE_CONS(l, stringToValue("i1"));
+	MAKE_BINOP_EXPR(r, l, attrCompare(0, OP_COMP_EQUAL, "sx"), OP_COMP_SMALLER);
+	MAKE_CONS(l, stringToValue("bt"));
+	MAKE_BINOP_EXPR(op, l, r, OP_BOOL_OR);
+	TEST_CHECK(evalExpr(NULL, NULL, op, &res));
+	OP_TRUE(stringToValue("bt"), res, valueEquals, "true OR ... is true");
+	freeVal(res);
+	freeExpr(op);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testAdaptiveChains (void)
+{
+	char *names[] = { "a", "s", "f", "b" };
+	DataType dt[] = { DT_INT, DT_STRING, DT_FLOAT, DT_BOOL };
+	int sizes[] = { 0, 4, 0, 0 };
+	int keys[] = { 0 };
+	int numRows = 6000, size, i, j, a, batch;
+	uint64_t selection[PAGE_SIZE / 64];
+	Expr *conds[3], *l, *r, *t, *u;
+	Predicate *pred, *batched;
+	Schema *schema;
+	Record rec;
+	Value *res;
+	char *rows, str[5];
+	float f;
+	bool b, expected;
+	testName = "test reordered AND and OR chains";
+
+	// a < 100 AND s = "xx" AND (f < 0.0 OR b) AND NOT (a = 7)
+	MAKE_BINOP_EXPR(l, attrCompare(0, OP_COMP_SMALLER, "i100"), attrCompare(1, OP_COMP_EQUAL, "sxx"), OP_BOOL_AND);
+	MAKE_ATTRREF(t, 3);
+	MAKE_BINOP_EXPR(r, attrCompare(2, OP_COMP_SMALLER, "f0.0"), t, OP_BOOL_OR);
+	MAKE_BINOP_EXPR(u, l, r, OP_BOOL_AND);
+	MAKE_UNOP_EXPR(r, attrCompare(0, OP_COMP_EQUAL, "i7"), OP_BOOL_NOT);
+	MAKE_BINOP_EXPR(conds[0], u, r, OP_BOOL_AND);
+	// s < "m" OR a = 3 OR (f = 1.0 AND b) OR a < -40
+	MAKE_BINOP_EXPR(l, attrCompare(1, OP_COMP_SMALLER, "sm"), attrCompare(0, OP_COMP_EQUAL, "i3"), OP_BOOL_OR);
+	MAKE_ATTRREF(t, 3);
+	MAKE_BINOP_EXPR(r, attrCompare(2, OP_COMP_EQUAL, "f1.0"), t, OP_BOOL_AND);
+	MAKE_BINOP_EXPR(u, l, r, OP_BOOL_OR);
+	MAKE_BINOP_EXPR(conds[1], u, attrCompare(0, OP_COMP_SMALLER, "i-40"), OP_BOOL_OR);
+	// chains compared as values: (a < 0 AND b) = (s = "xx" OR f < 1.0)
+	MAKE_BINOP_EXPR(l, attrCompare(0, OP_COMP_SMALLER, "i0"), attrCompare(3, OP_COMP_EQUAL, "btrue"), OP_BOOL_AND);
+	MAKE_BINOP_EXPR(r, attrCompare(1, OP_COMP_EQUAL, "sxx"), attrCompare(2, OP_COMP_SMALLER, "f1.0"), OP_BOOL_OR);
+	MAKE_BINOP_EXPR(conds[2], l, r, OP_COMP_EQUAL);
+
+	// the pass rates of the terms change halfway through the rows
+	schema = createSchemaWithLayout(4, names, dt, sizes, 1, keys, LAYOUT_ALIGNED);
+	size = getRecordSize(schema);
+	rows = (char *) calloc(numRows, size);
+	for(i = 0; i < numRows; i++)
+	{
+		rec.data = rows + i * size;
+		a = i < numRows / 2 ? (i * 7) % 50 - 45 : (i * 13) % 400;
+		f = i < numRows / 2 ? (i % 5) - 1.0f : (i % 17) * 0.5f;
+		b = i < numRows / 2 ? i % 4 == 0 : i % 4 != 0;
+		if (i < numRows / 2)
+			sprintf(str, "%s", i % 3 ? "xx" : "ab");
+		else
+			sprintf(str, "%c%c", 'a' + i % 26, 'a' + i % 7);
+		TEST_CHECK(setAttrRaw(&rec, schema, 0, &a, 0));
+		TEST_CHECK(setAttrRaw(&rec, schema, 1, str, strlen(str)));
+		TEST_CHECK(setAttrRaw(&rec, schema, 2, &f, 0));
+		TEST_CHECK(setAttrRaw(&rec, schema, 3, &b, 0));
+	}
+
+	for(j = 0; j < 3; j++)
+	{
+		TEST_CHECK(compilePredicate(conds[j], schema, &pred));
+		TEST_CHECK(compilePredicate(conds[j], schema, &batched));
+		// batches of varying size, so chunks start and end mid-word
+		for(i = 0; i < numRows; i += batch)
+		{
+			batch = 1 + (i * 31) % 700;
+			if (batch > numRows - i)
+				batch = numRows - i;
+			evalPredicateBatch(batched, rows + i * size, size, batch, selection);
+			for(a = 0; a < batch; a++)
+			{
+				rec.data = rows + (i + a) * size;
+				TEST_CHECK(evalExpr(&rec, schema, conds[j], &res));
+				expected = res->v.boolV;
+				freeVal(res);
+				ASSERT_TRUE(expected == !!evalPredicate(pred, &rec), "row at a time agrees with evalExpr");
+				ASSERT_TRUE(expected == (int) ((selection[a / 64] >> (a % 64)) & 1), "batch agrees with evalExpr");
+			}
+		}
+		freePredicate(pred);
+		freePredicate(batched);
+		freeExpr(conds[j]);
+	}
+
+	free(rows);
+	freeSchema(schema);
+	TEST_DONE();
+}
+
+Expr *
+attrCompare (int attr, OpType op, char *value)
+{
+	Expr *l, *r, *result;
+	MAKE_ATTRREF(l, attr);
+	MAKE_CONS(r, stringToValue(value));
+	MAKE_BINOP_EXPR(result, l, r, op);
+	return result;
+}